@@ -0,0 +1,61 @@
+#include "clickhouse_connector.h"
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <clickhouse/block.h>
+#include <clickhouse/columns/date.h>
+#include <clickhouse/columns/lowcardinality.h>
+#include <clickhouse/columns/nullable.h>
+#include <clickhouse/columns/numeric.h>
+#include <clickhouse/columns/string.h>
+#include <string>
+
+using namespace clickhouse;
+
+// Блок как из ответа сервера: id UInt64, amount Nullable(Float64), name String,
+// status LowCardinality(String), created_at DateTime
+static Block make_block(size_t rows) {
+    auto id = std::make_shared<ColumnUInt64>();
+    auto amount = std::make_shared<ColumnFloat64>();
+    auto amount_nulls = std::make_shared<ColumnUInt8>();
+    auto name = std::make_shared<ColumnString>();
+    auto status = std::make_shared<ColumnLowCardinalityT<ColumnString>>();
+    auto created_at = std::make_shared<ColumnDateTime>();
+
+    const char* statuses[] = {"new", "paid", "shipped", "cancelled"};
+    for (size_t i = 0; i < rows; ++i) {
+        id->Append(i);
+        amount->Append(static_cast<double>(i) * 0.25);
+        amount_nulls->Append(i % 10 == 0 ? 1 : 0);
+        name->Append("user_" + std::to_string(i));
+        status->Append(statuses[i % 4]);
+        created_at->Append(static_cast<std::time_t>(1700000000 + i));
+    }
+
+    Block block;
+    block.AppendColumn("id", id);
+    block.AppendColumn("amount", std::make_shared<ColumnNullable>(amount, amount_nulls));
+    block.AppendColumn("name", name);
+    block.AppendColumn("status", status);
+    block.AppendColumn("created_at", created_at);
+    return block;
+}
+
+TEST_CASE("ClickHouse block conversion", "[clickhouse][decode]") {
+    const Block block = make_block(65536);
+    ClickHouseConnector connector;
+
+    QueryResult check;
+    connector.append_block(check, block);
+    REQUIRE(check.row_count() == 65536);
+
+    BENCHMARK("append_block 64k rows x 5") {
+        QueryResult result;
+        connector.append_block(result, block);
+        return result;
+    };
+    BENCHMARK("append_block 16 x 64k rows x 5") {
+        QueryResult result;
+        for (int k = 0; k < 16; ++k) connector.append_block(result, block);
+        return result;
+    };
+}
@@ -0,0 +1,47 @@
+#include "clickhouse_connector.h"
+#include "postgres_connector.h"
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <string>
+
+// Запрос и разбор результата целиком на локальных серверах (те же, что у тестов).
+// Без сервера замеры пропускаются; исключить их из прогона: sql_executor_bench "~[e2e]"
+
+TEST_CASE("Postgres end-to-end", "[postgres][e2e]") {
+    PostgresConnector conn;
+    std::string conninfo = "host=127.0.0.1 port=15432 dbname=postgres user=postgres password=postgres";
+    if (!conn.connect(conninfo)) {
+        WARN("Cannot connect to Postgres, skipping benchmark");
+        return;
+    }
+    conn.set_count_mode(CountMode::None);
+
+    const std::string query =
+        "SELECT g AS id, g * 0.25 AS amount, 'user_' || g AS name, g % 2 = 0 AS active, "
+        "now()::timestamp AS created_at FROM generate_series(1, 100000) g";
+
+    BENCHMARK("postgres execute 100k rows text") { return conn.execute(query); };
+    conn.set_binary_results(true);
+    BENCHMARK("postgres execute 100k rows binary") { return conn.execute(query); };
+    BENCHMARK("postgres execute_to_json 100k rows") { return conn.execute_to_json(query); };
+    BENCHMARK("postgres execute 1 row") { return conn.execute("SELECT 1 AS one"); };
+    conn.disconnect();
+}
+
+TEST_CASE("ClickHouse end-to-end", "[clickhouse][e2e]") {
+    ClickHouseConnector conn;
+    if (!conn.connect("127.0.0.1", 19000, "default", "default", "")) {
+        WARN("Cannot connect to ClickHouse, skipping benchmark");
+        return;
+    }
+
+    const std::string query =
+        "SELECT number AS id, number * 0.25 AS amount, concat('user_', toString(number)) AS name, "
+        "toLowCardinality(['new', 'paid', 'shipped'][number % 3 + 1]) AS status "
+        "FROM system.numbers LIMIT 1000000";
+
+    BENCHMARK("clickhouse execute 1M rows") { return conn.execute(query); };
+    BENCHMARK("clickhouse execute_to_json 1M rows") { return conn.execute_to_json(query); };
+    BENCHMARK("clickhouse execute 1 row") { return conn.execute("SELECT 1 AS one"); };
+    conn.disconnect();
+}
@@ -0,0 +1,87 @@
+#include "json_writer.h"
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <string>
+
+// Синтетический результат: num_ints целых, num_floats дробных и num_strings строковых
+// колонок; в строках длины string_len каждая 8-я строка содержит символы для экранирования
+static QueryResult synthetic_result(size_t rows, size_t num_ints, size_t num_floats, size_t num_strings,
+                                    size_t string_len) {
+    QueryResult result;
+    for (size_t j = 0; j < num_ints; ++j) result.add_column("int_" + std::to_string(j), "int8", ValueKind::Int64);
+    for (size_t j = 0; j < num_floats; ++j) result.add_column("float_" + std::to_string(j), "float8", ValueKind::Float64);
+    for (size_t j = 0; j < num_strings; ++j) result.add_column("text_" + std::to_string(j), "text", ValueKind::String);
+
+    std::string text(string_len, 'x');
+    for (size_t i = 0; i < rows; ++i) {
+        size_t j = 0;
+        for (; j < num_ints; ++j) result.data[j].append_int(static_cast<int64_t>(i * 7919 + j));
+        for (; j < num_ints + num_floats; ++j) {
+            if (i % 10 == 0) result.data[j].append_null();
+            else result.data[j].append_double(static_cast<double>(i) * 0.37 + static_cast<double>(j));
+        }
+        for (; j < result.data.size(); ++j) {
+            for (size_t k = 0; k < text.size(); ++k) text[k] = static_cast<char>('a' + (i + k) % 26);
+            if (i % 8 == 0 && !text.empty()) text[text.size() / 2] = '"';
+            result.data[j].append_string(text);
+        }
+    }
+    result.count = rows;
+    return result;
+}
+
+TEST_CASE("to_json by result shape", "[json]") {
+    const QueryResult narrow = synthetic_result(100000, 2, 1, 0, 0);
+    const QueryResult mixed = synthetic_result(100000, 2, 2, 2, 16);
+    const QueryResult wide = synthetic_result(5000, 20, 20, 10, 16);
+    const QueryResult long_strings = synthetic_result(20000, 1, 0, 2, 512);
+
+    BENCHMARK("to_json narrow 100k rows x 3 numeric") { return narrow.to_json(); };
+    BENCHMARK("to_json mixed 100k rows x 6") { return mixed.to_json(); };
+    BENCHMARK("to_json wide 5k rows x 50") { return wide.to_json(); };
+    BENCHMARK("to_json long strings 20k rows x 512 B") { return long_strings.to_json(); };
+}
+
+TEST_CASE("to_json interned strings", "[json]") {
+    QueryResult result;
+    ColumnData& status = result.add_column("status", "text");
+    status.intern_strings();
+    const char* statuses[] = {"new", "paid", "shipped", "cancelled"};
+    for (size_t i = 0; i < 200000; ++i) status.append_string(statuses[i % 4]);
+    result.count = 200000;
+
+    BENCHMARK("to_json interned 200k rows") { return result.to_json(); };
+}
+
+TEST_CASE("to_json parallel", "[json]") {
+    const QueryResult result = synthetic_result(500000, 2, 2, 2, 16);
+    JsonParallelOptions options;
+    options.min_rows = 0;
+
+    BENCHMARK("to_json serial 500k rows x 6") { return result.to_json(); };
+    BENCHMARK("to_json_parallel 500k rows x 6") { return to_json_parallel(result, options); };
+}
+
+TEST_CASE("JSON escaping throughput", "[escaping]") {
+    const size_t size = 1 << 20;
+    std::string clean(size, 'a');
+    for (size_t i = 0; i < size; ++i) clean[i] = static_cast<char>('a' + i % 26);
+    std::string sparse = clean;
+    for (size_t i = 0; i < size; i += 256) sparse[i] = '"';
+    std::string dense = clean;
+    for (size_t i = 0; i < size; i += 4) dense[i] = '\n';
+
+    auto escape = [](const std::string& text) {
+        FastStringBuilder b(text.size() * 2);
+        append_escaped_unquoted(b, text);
+        return b.str().size();
+    };
+    BENCHMARK("escape 1 MiB without specials") { return escape(clean); };
+    BENCHMARK("escape 1 MiB, special every 256 B") { return escape(sparse); };
+    BENCHMARK("escape 1 MiB, special every 4 B") { return escape(dense); };
+
+    const char* begin = clean.data();
+    const char* end = begin + clean.size();
+    BENCHMARK("scan 1 MiB scalar") { return find_json_escape_scalar(begin, end); };
+    BENCHMARK("scan 1 MiB dispatched") { return find_json_escape(begin, end); };
+}
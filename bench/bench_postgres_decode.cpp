@@ -0,0 +1,98 @@
+#include "postgres_connector.h"
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// PGresult, собранный в памяти так же, как его собирает libpq из ответа сервера:
+// колонки id int8, amount float8, name text, active bool, status text, created_at timestamp
+namespace {
+
+constexpr Oid INT8OID = 20;
+constexpr Oid FLOAT8OID = 701;
+constexpr Oid TEXTOID = 25;
+constexpr Oid BOOLOID = 16;
+constexpr Oid TIMESTAMPOID = 1114;
+
+constexpr int64_t PG_EPOCH_OFFSET_US = 946684800LL * 1000000;   // 2000-01-01 от 1970-01-01
+
+struct ResultDeleter {
+    void operator()(PGresult* res) const { PQclear(res); }
+};
+using ResultPtr = std::unique_ptr<PGresult, ResultDeleter>;
+
+std::string be64(uint64_t v) {
+    std::string out(8, '\0');
+    for (int k = 7; k >= 0; --k, v >>= 8) out[k] = static_cast<char>(v & 0xFF);
+    return out;
+}
+
+ResultPtr make_fixture(size_t rows, bool binary) {
+    ResultPtr res(PQmakeEmptyPGresult(nullptr, PGRES_TUPLES_OK));
+    if (!res) throw std::runtime_error("PQmakeEmptyPGresult failed");
+
+    const int format = binary ? 1 : 0;
+    char id[] = "id", amount[] = "amount", name[] = "name", active[] = "active", status[] = "status",
+         created_at[] = "created_at";
+    PGresAttDesc attrs[] = {
+        {id, 0, 0, format, INT8OID, 8, -1},
+        {amount, 0, 0, format, FLOAT8OID, 8, -1},
+        {name, 0, 0, format, TEXTOID, -1, -1},
+        {active, 0, 0, format, BOOLOID, 1, -1},
+        {status, 0, 0, format, TEXTOID, -1, -1},
+        {created_at, 0, 0, format, TIMESTAMPOID, 8, -1},
+    };
+    if (!PQsetResultAttrs(res.get(), 6, attrs)) throw std::runtime_error("PQsetResultAttrs failed");
+
+    const char* statuses[] = {"new", "paid", "shipped", "cancelled"};
+    for (size_t i = 0; i < rows; ++i) {
+        const int row = static_cast<int>(i);
+        const double amount_value = static_cast<double>(i) * 0.25;
+        const int64_t created_us = 1700000000LL * 1000000 + static_cast<int64_t>(i) * 1000000;
+        std::vector<std::string> cells;
+        if (binary) {
+            uint64_t amount_bits;
+            std::memcpy(&amount_bits, &amount_value, sizeof(amount_bits));
+            cells = {be64(i), be64(amount_bits), "user_" + std::to_string(i), std::string(1, i % 2 ? 1 : 0),
+                     statuses[i % 4], be64(static_cast<uint64_t>(created_us - PG_EPOCH_OFFSET_US))};
+        } else {
+            FastStringBuilder ts;
+            append_temporal_text(ts, ValueKind::Timestamp, created_us);
+            FastStringBuilder num;
+            num.append_number(amount_value);
+            cells = {std::to_string(i), num.str(), "user_" + std::to_string(i), i % 2 ? "t" : "f",
+                     statuses[i % 4], ts.str()};
+        }
+        for (int j = 0; j < 6; ++j) {
+            // amount каждой 10-й строки — NULL
+            if (j == 1 && i % 10 == 0) {
+                PQsetvalue(res.get(), row, j, nullptr, -1);
+                continue;
+            }
+            PQsetvalue(res.get(), row, j, cells[j].data(), static_cast<int>(cells[j].size()));
+        }
+    }
+    return res;
+}
+
+} // namespace
+
+TEST_CASE("Postgres result decoding", "[postgres][decode]") {
+    const size_t rows = 100000;
+    ResultPtr text = make_fixture(rows, false);
+    ResultPtr binary = make_fixture(rows, true);
+
+    PostgresConnector connector;
+    // Оба формата фикстуры описывают одни и те же значения
+    REQUIRE(connector.decode_result(text.get()).row_count() == rows);
+    REQUIRE(connector.decode_result(text.get()).to_json() == connector.decode_result(binary.get()).to_json());
+
+    BENCHMARK("decode text 100k rows x 6") { return connector.decode_result(text.get()); };
+    BENCHMARK("decode binary 100k rows x 6") { return connector.decode_result(binary.get()); };
+
+    connector.set_intern_strings(true);
+    BENCHMARK("decode binary 100k rows x 6, interned strings") { return connector.decode_result(binary.get()); };
+}
@@ -0,0 +1,83 @@
+#ifndef ARROW_EXPORT_H
+#define ARROW_EXPORT_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "common.h"
+
+// -----------------------------------------------------------------------------
+// Apache Arrow C Data / C Stream Interface
+// Определения структур взяты из спецификации ABI Arrow, чтобы не тянуть
+// зависимость от libarrow: любой потребитель (pyarrow, polars, DuckDB)
+// импортирует их напрямую
+// -----------------------------------------------------------------------------
+extern "C" {
+
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+    const char* format;
+    const char* name;
+    const char* metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema** children;
+    struct ArrowSchema* dictionary;
+    void (*release)(struct ArrowSchema*);
+    void* private_data;
+};
+
+struct ArrowArray {
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void** buffers;
+    struct ArrowArray** children;
+    struct ArrowArray* dictionary;
+    void (*release)(struct ArrowArray*);
+    void* private_data;
+};
+
+#endif // ARROW_C_DATA_INTERFACE
+
+#ifndef ARROW_C_STREAM_INTERFACE
+#define ARROW_C_STREAM_INTERFACE
+
+struct ArrowArrayStream {
+    int (*get_schema)(struct ArrowArrayStream*, struct ArrowSchema* out);
+    int (*get_next)(struct ArrowArrayStream*, struct ArrowArray* out);
+    const char* (*get_last_error)(struct ArrowArrayStream*);
+    void (*release)(struct ArrowArrayStream*);
+    void* private_data;
+};
+
+#endif // ARROW_C_STREAM_INTERFACE
+
+} // extern "C"
+
+// Источник батчей для потока: заполняет batch и возвращает true,
+// либо возвращает false, когда батчей больше нет
+using BatchSource = std::function<bool(QueryResult& batch)>;
+
+// Строка формата Arrow для колонки. Тип выбирается по имени типа СУБД
+// (oid_to_type_name для PostgreSQL, normalize_type_name для ClickHouse),
+// а если имя неизвестно — по физическому типу хранения
+std::string arrow_format_for(const ColumnInfo& column, ValueKind kind);
+
+// Экспорт результатов в ArrowArrayStream: каждый батч становится record batch
+// (struct-массивом колонок). Буферы колонок, совпадающие по представлению с
+// Arrow (int64, float64, large_utf8, маски валидности), передаются без копирования.
+// Схема определяется по первому батчу
+void export_arrow_stream(BatchSource source, ArrowArrayStream* out);
+void export_arrow_stream(QueryResult result, ArrowArrayStream* out);
+
+#endif // ARROW_EXPORT_H
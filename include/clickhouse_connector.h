@@ -1,21 +1,168 @@
 #ifndef CLICKHOUSE_CONNECTOR_H
 #define CLICKHOUSE_CONNECTOR_H
 
+#include <chrono>
 #include <string>
 #include <vector>
 #include <memory>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
 #include "common.h"
+#include "json_writer.h"
+#include "output_sink.h"
+#include "result_cache.h"
 
 namespace clickhouse {
     class Client;
     class ClientOptions;
+    class Block;
+    class Column;
     class ColumnNullable; 
     class ColumnUUID;     
 }
 
+struct ArrowArrayStream;
+
+class ClickHouseConnector;
+
+// Потоковое чтение результата ClickHouse пачками строк.
+// Блоки читает фоновый поток (SelectCancelable) и складывает в ограниченную очередь:
+// когда очередь заполнена, чтение из сокета приостанавливается (backpressure).
+// Пока поток открыт, соединение занято; коннектор должен жить дольше потока
+class ClickHouseStream {
+public:
+    ~ClickHouseStream();
+    ClickHouseStream(const ClickHouseStream&) = delete;
+    ClickHouseStream& operator=(const ClickHouseStream&) = delete;
+
+    // Следующая пачка (не меньше batch_rows строк, кроме последней); false — строк больше нет
+    bool next_batch(QueryResult& batch);
+    const std::vector<ColumnInfo>& columns();
+    bool is_open() const;
+    // Досрочное закрытие: отменяет запрос и освобождает соединение, не дожидаясь сервера.
+    // Клиент, занятый чтением ответа, отдаётся фоновому потоку (тот закроет его,
+    // когда сервер пришлёт следующий пакет), а коннектор открывает новое соединение
+    // с теми же параметрами; если переподключиться не удалось, is_connected() — false
+    void close();
+
+private:
+    friend class ClickHouseConnector;
+    ClickHouseStream(ClickHouseConnector* connector, size_t batch_rows, size_t queue_depth);
+
+    // Состояние, общее с фоновым потоком: после close() поток может пережить ClickHouseStream
+    struct Shared {
+        std::mutex mutex;
+        std::condition_variable ready;       // появилась пачка / колонки / конец
+        std::condition_variable space;       // освободилось место в очереди / поток вышел из колбэка
+        std::deque<QueryResult> queue;
+        std::vector<ColumnInfo> columns;
+        bool columns_ready = false;
+        bool producer_done = false;
+        bool cancelled = false;
+        bool in_callback = false;            // поток разбирает блок и обращается к коннектору
+        std::exception_ptr error;
+        std::unique_ptr<clickhouse::Client> orphan;   // клиент, отданный потоку при close()
+    };
+
+    void start(const std::string& query);
+    static void produce(std::shared_ptr<Shared> shared, ClickHouseConnector* connector,
+                        clickhouse::Client* client, const std::string& query,
+                        size_t batch_rows, size_t queue_depth);
+    // false — поток закрыт потребителем
+    static bool push_batch(Shared& shared, QueryResult& batch, size_t queue_depth);
+    // reconnect — заменить клиент, если фоновый поток ещё читает ответ сервера
+    void stop(bool reconnect);
+    void finish();
+
+    ClickHouseConnector* connector_;
+    size_t batch_rows_;
+    size_t queue_depth_;
+    std::thread worker_;
+    std::shared_ptr<Shared> shared_;
+    bool finished_;
+};
+
+struct ClickHouseInsertOptions {
+    size_t block_rows = 1048576;         // блок отправляется, набрав столько строк
+    size_t block_bytes = 64 << 20;       // ... или примерно столько байт данных
+    bool background = false;             // блоки отправляет фоновый поток
+    size_t queue_depth = 2;              // готовых блоков в очереди фонового потока
+};
+
+// Вставка нативными блоками (Client::Insert): значения сразу раскладываются
+// в типизированные колонки clickhouse-cpp по типам таблицы, сервер не разбирает SQL-текст.
+// Строки копятся в блок до block_rows / block_bytes; в фоновом режиме готовые блоки
+// уходят через ограниченную очередь, и write не ждёт сети.
+// Пока вставка открыта, соединение занято; коннектор должен жить дольше вставки
+class ClickHouseInserter {
+public:
+    ~ClickHouseInserter();   // неотправленные строки отбрасываются
+    ClickHouseInserter(const ClickHouseInserter&) = delete;
+    ClickHouseInserter& operator=(const ClickHouseInserter&) = delete;
+
+    // Колонки пачки сопоставляются колонкам вставки по порядку.
+    // Ошибка фоновой отправки выбрасывается из следующего write / flush / close
+    void write(const QueryResult& rows);
+    // Отправляет накопленные строки и дожидается отправки всех блоков
+    void flush();
+    // flush и освобождение соединения; возвращает число вставленных строк
+    uint64_t close();
+    // Отбрасывает неотправленные строки и освобождает соединение
+    void abort();
+    bool is_open() const;
+    const std::vector<ColumnInfo>& columns() const;
+
+private:
+    friend class ClickHouseConnector;
+    using ColumnRef = std::shared_ptr<clickhouse::Column>;
+
+    ClickHouseInserter(ClickHouseConnector* connector, std::string table, std::vector<ColumnInfo> columns,
+                       std::vector<ColumnRef> templates, ClickHouseInsertOptions options);
+
+    void seal_block();
+    void send_block(const clickhouse::Block& block);
+    void send_loop();
+    void check_error();
+    void finish();
+
+    ClickHouseConnector* connector_;
+    std::string table_;
+    std::vector<ColumnInfo> columns_;     // колонки таблицы с типами ClickHouse
+    std::vector<ColumnRef> templates_;    // пустые колонки нужных типов
+    std::vector<ColumnRef> current_;      // заполняемый блок
+    size_t current_rows_;
+    size_t current_bytes_;
+    ClickHouseInsertOptions options_;
+    uint64_t rows_sent_;
+    bool finished_;
+
+    std::thread worker_;
+    std::mutex mutex_;
+    std::condition_variable ready_;      // появился блок / остановка
+    std::condition_variable space_;      // блок отправлен
+    std::deque<std::unique_ptr<clickhouse::Block>> queue_;
+    bool sending_;                       // фоновый поток отправляет блок
+    bool stopping_;
+    std::exception_ptr error_;
+};
+
 class ClickHouseConnector {
 private:
+    friend class ClickHouseStream;
+    friend class ClickHouseInserter;
+
     std::unique_ptr<clickhouse::Client> client_;
+    std::unique_ptr<clickhouse::ClientOptions> options_;   // для переподключения после ClickHouseStream::close
+    ClickHouseStream* active_stream_;   // открытый поток, занимающий соединение
+    ClickHouseInserter* active_inserter_;   // открытая вставка
+    mutable std::mutex call_mutex_;
+
+    std::shared_ptr<ResultCache> result_cache_;   // кэш результатов execute; nullptr — выключен
+    std::chrono::milliseconds result_cache_ttl_;
+    std::string cache_target_;                    // сервер, база и пользователь соединения
 
 public:
     ClickHouseConnector();
@@ -26,11 +173,55 @@ public:
                  const std::string& password);
     void disconnect();
     bool is_connected() const;
+    // Проверка соединения пакетом Ping (без выполнения запроса)
+    bool ping();
+    // Подготовка к повторному использованию (пул): закрывает открытый поток.
+    // false — соединение непригодно
+    bool reset_session();
+    // Коннектор не потокобезопасен: обёртки, вызывающие его из разных потоков
+    // (Python без GIL), сериализуют вызовы этим мьютексом
+    std::mutex& call_mutex() const;
     QueryResult execute(const std::string& query);
-    std::string execute_to_json(const std::string& query);
+    // Большие результаты сериализуются параллельно (to_json_parallel)
+    std::string execute_to_json(const std::string& query, const JsonParallelOptions& json_options = {});
+    void execute_arrow(const std::string& query, ArrowArrayStream* out);
+
+    // Потоковое чтение без буферизации всего результата.
+    // batch_rows — минимальный размер пачки (0 — пачка на каждый блок сервера),
+    // queue_depth — сколько готовых пачек может ждать потребителя
+    std::unique_ptr<ClickHouseStream> stream(const std::string& query, size_t batch_rows = 65536,
+                                             size_t queue_depth = 4);
+    void stream_arrow(const std::string& query, size_t batch_rows, ArrowArrayStream* out);
+
+    // Кэш результатов execute (запросы SELECT / WITH); ttl 0 — TTL кэша по умолчанию,
+    // nullptr выключает кэш
+    void set_result_cache(std::shared_ptr<ResultCache> cache,
+                          std::chrono::milliseconds ttl = std::chrono::milliseconds(0));
+    std::shared_ptr<ResultCache> result_cache() const;
+
+    // Нативная вставка; пустой columns — все колонки таблицы (кроме MATERIALIZED / ALIAS).
+    // table подставляется в запрос как есть (можно с базой), имена колонок экранируются
+    std::unique_ptr<ClickHouseInserter> inserter(const std::string& table, const std::vector<std::string>& columns,
+                                                 ClickHouseInsertOptions options = {});
+    uint64_t insert(const std::string& table, const std::vector<std::string>& columns, const QueryResult& rows,
+                    ClickHouseInsertOptions options = {});
+
+    // Выгрузка результата в out блок за блоком: Csv / Tsv — FORMAT CSV / TabSeparated
+    // (строки форматирует сервер через formatRow, query подставляется подзапросом),
+    // Binary — FORMAT Native. header — строка с именами колонок (Csv / Tsv).
+    // Возвращает число выгруженных строк
+    uint64_t copy_out(const std::string& query, OutputSink& out, ExportFormat format = ExportFormat::Csv,
+                      bool header = false);
+
+    // Дописывает строки блока в колоночные буферы результата (колонки — по первому блоку);
+    // соединение не нужно
+    void append_block(QueryResult& result, const clickhouse::Block& block) const;
 
 private:
     std::string normalize_type_name(const std::string& type_name) const;
+    QueryResult run_query(const std::string& query);
+    size_t count_without_limit(const std::string& query, size_t rows);
+    void ensure_idle() const;
 };
 
 #endif // CLICKHOUSE_CONNECTOR_H
\ No newline at end of file
@@ -0,0 +1,106 @@
+#ifndef CLICKHOUSE_POOL_H
+#define CLICKHOUSE_POOL_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include "clickhouse_connector.h"
+#include "thread_pool.h"
+
+struct ClickHouseEndpoint {
+    std::string host = "localhost";
+    int port = 9000;
+    std::string database = "default";
+    std::string user = "default";
+    std::string password;
+};
+
+struct ClickHousePoolOptions {
+    size_t size = 4;                                          // максимум соединений
+    std::chrono::milliseconds acquire_timeout{5000};          // ожидание свободного соединения
+    // Соединение, простоявшее дольше, проверяется Ping'ом при выдаче
+    std::chrono::milliseconds health_check_after{30000};
+    // Соединения, простоявшие дольше, закрываются и открываются заново по требованию
+    std::chrono::milliseconds idle_timeout{300000};
+    // Общий кэш результатов execute для всех соединений пула (nullptr — без кэша)
+    std::shared_ptr<ResultCache> result_cache;
+    std::chrono::milliseconds result_cache_ttl{0};                // 0 — TTL кэша по умолчанию
+};
+
+// Потокобезопасный пул клиентов ClickHouse.
+// Аренда (Lease) возвращает соединение в пул в деструкторе; execute_many
+// выполняет независимые запросы параллельно на нескольких соединениях.
+// Пул должен жить дольше выданных из него аренд
+class ClickHousePool {
+public:
+    class Lease {
+    public:
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&& other) noexcept;
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease();
+
+        ClickHouseConnector& operator*() const;
+        ClickHouseConnector* operator->() const;
+        ClickHouseConnector* get() const;
+        explicit operator bool() const;
+
+        void release();
+
+    private:
+        friend class ClickHousePool;
+        Lease(ClickHousePool* pool, std::unique_ptr<ClickHouseConnector> connection);
+
+        ClickHousePool* pool_;
+        std::unique_ptr<ClickHouseConnector> connection_;
+    };
+
+    explicit ClickHousePool(ClickHouseEndpoint endpoint, ClickHousePoolOptions options = {});
+    ~ClickHousePool();
+    ClickHousePool(const ClickHousePool&) = delete;
+    ClickHousePool& operator=(const ClickHousePool&) = delete;
+
+    Lease acquire();
+    Lease acquire(std::chrono::milliseconds timeout);
+
+    QueryResult execute(const std::string& query);
+    // Независимые запросы параллельно, не больше size одновременно;
+    // результаты — в порядке запросов. Ошибка любого запроса выбрасывается
+    // после завершения остальных
+    std::vector<QueryResult> execute_many(const std::vector<std::string>& queries);
+
+    size_t size() const;
+    size_t idle() const;
+    size_t in_use() const;
+
+    void close();
+
+private:
+    struct IdleConnection {
+        std::unique_ptr<ClickHouseConnector> connection;
+        std::chrono::steady_clock::time_point since;
+    };
+
+    std::unique_ptr<ClickHouseConnector> open_connection() const;
+    std::vector<IdleConnection> take_expired(std::chrono::steady_clock::time_point now);
+    void give_back(std::unique_ptr<ClickHouseConnector> connection);
+
+    const ClickHouseEndpoint endpoint_;
+    const ClickHousePoolOptions options_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable available_;
+    std::vector<IdleConnection> idle_;   // стек: в начале — дольше всех простаивающие
+    size_t open_;
+    size_t leased_;
+    bool closed_;
+
+    std::unique_ptr<ThreadPool> workers_;   // для execute_many, создаётся при первом вызове
+    std::once_flag workers_once_;
+};
+
+#endif // CLICKHOUSE_POOL_H
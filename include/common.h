@@ -2,12 +2,25 @@
 #define COMMON_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <variant>
 #include <type_traits>
 #include <charconv>
 #include <cstring>
 #include <cstdio>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <regex>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define JSON_ESCAPE_X86_SIMD 1
+#include <immintrin.h>
+#else
+#define JSON_ESCAPE_X86_SIMD 0
+#endif
 
 // Компиляторный якорь для static_assert
 template<class> inline constexpr bool always_false = false;
@@ -67,18 +80,17 @@ public:
 
 // Таблица простых escape-последовательностей
 inline const char** get_escape_table() {
-    static const char* table[256] = { nullptr };
-    static bool inited = false;
-    if (!inited) {
-        inited = true;
-        table[(unsigned char)'"']  = "\\\"";
-        table[(unsigned char)'\\'] = "\\\\";
-        table[(unsigned char)'\b'] = "\\b";
-        table[(unsigned char)'\f'] = "\\f";
-        table[(unsigned char)'\n'] = "\\n";
-        table[(unsigned char)'\r'] = "\\r";
-        table[(unsigned char)'\t'] = "\\t";
-    }
+    static const char** table = [] {
+        static const char* t[256] = { nullptr };
+        t[(unsigned char)'"']  = "\\\"";
+        t[(unsigned char)'\\'] = "\\\\";
+        t[(unsigned char)'\b'] = "\\b";
+        t[(unsigned char)'\f'] = "\\f";
+        t[(unsigned char)'\n'] = "\\n";
+        t[(unsigned char)'\r'] = "\\r";
+        t[(unsigned char)'\t'] = "\\t";
+        return t;
+    }();
     return table;
 }
 
@@ -89,22 +101,83 @@ inline void append_hex2(FastStringBuilder &b, unsigned char c) {
     b.append(tmp, 2);
 }
 
+// Байт, требующий экранирования в JSON: управляющие символы, '"' и '\'
+inline bool json_needs_escape(unsigned char c) {
+    return c < 0x20 || c == '"' || c == '\\';
+}
+
+// Поиск первого байта, требующего экранирования, в [p, end); end — если таких нет
+inline const char* find_json_escape_scalar(const char* p, const char* end) {
+    while (p < end && !json_needs_escape(static_cast<unsigned char>(*p))) ++p;
+    return p;
+}
+
+#if JSON_ESCAPE_X86_SIMD
+// SSE2 (есть на любом x86-64): 16 байт за сравнение. Управляющие символы — через
+// беззнаковый max: max(c, 0x1F) == 0x1F ⇔ c <= 0x1F
+inline const char* find_json_escape_sse2(const char* p, const char* end) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control_max = _mm_set1_epi8(0x1F);
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+                                   _mm_cmpeq_epi8(_mm_max_epu8(v, control_max), control_max));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hit));
+        if (mask != 0) return p + __builtin_ctz(mask);
+    }
+    return find_json_escape_scalar(p, end);
+}
+
+// AVX2: 32 байта за сравнение; хвост — SSE2 и скалярно
+__attribute__((target("avx2")))
+inline const char* find_json_escape_avx2(const char* p, const char* end) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i control_max = _mm256_set1_epi8(0x1F);
+    for (; end - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash)),
+                                      _mm256_cmpeq_epi8(_mm256_max_epu8(v, control_max), control_max));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hit));
+        if (mask != 0) return p + __builtin_ctz(mask);
+    }
+    return find_json_escape_sse2(p, end);
+}
+#endif
+
+using JsonEscapeScanner = const char* (*)(const char*, const char*);
+
+// Реализация поиска выбирается один раз по возможностям процессора
+inline JsonEscapeScanner json_escape_scanner() {
+    static const JsonEscapeScanner scanner = []() -> JsonEscapeScanner {
+#if JSON_ESCAPE_X86_SIMD
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return &find_json_escape_avx2;
+        return &find_json_escape_sse2;
+#else
+        return &find_json_escape_scalar;
+#endif
+    }();
+    return scanner;
+}
+
+// Строки короче блока SIMD проверяются скалярно — без косвенного вызова
+inline const char* find_json_escape(const char* p, const char* end) {
+    if (end - p < 16) return find_json_escape_scalar(p, end);
+    return json_escape_scanner()(p, end);
+}
+
 // Экранирование строки без кавычек ("")
 // Копирует большие блоки "безопасных" байт за один append
 inline void append_escaped_unquoted(FastStringBuilder &b, std::string_view s) {
-    const char* data = s.data();
-    const char* end = data + s.size();
+    const char* p = s.data();
+    const char* end = p + s.size();
     const char** table = get_escape_table();
 
-    const char* p = data;
     while (p < end) {
-        const char* q = p;
         // Найти первый символ, требующий экранирования
-        while (q < end) {
-            unsigned char uc = static_cast<unsigned char>(*q);
-            if (uc < 0x20 || table[uc] != nullptr) break;
-            ++q;
-        }
+        const char* q = find_json_escape(p, end);
 
         // Добавить блок безопасных байт
         if (q > p)
@@ -133,76 +206,613 @@ inline void append_quoted_escaped(FastStringBuilder &b, std::string_view s) {
     b.push_back('"');
 }
 
+
+// -----------------------------------------------------------------------------
+// Колоночное хранилище результата
+// -----------------------------------------------------------------------------
+
+// Физический тип значений колонки
+enum class ValueKind : uint8_t {
+    Null,     // тип ещё не определён (в колонке пока только NULL)
+    Bool,
+    Int64,
+    Float64,
+    String,
+    Timestamp,    // микросекунды от 1970-01-01 00:00:00, без часового пояса
+    TimestampTz,  // микросекунды от 1970-01-01 00:00:00 UTC
+    Date          // дни от 1970-01-01
+};
+
+inline int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Текст UUID ("xxxxxxxx-xxxx-...", дефисы и фигурные скобки допускаются) → 16 байт
+inline bool parse_uuid(std::string_view text, uint8_t out[16]) {
+    size_t n = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        char c = text[i];
+        if (c == '-' || c == '{' || c == '}') continue;
+        int hi = hex_digit(c);
+        int lo = i + 1 < text.size() ? hex_digit(text[i + 1]) : -1;
+        if (hi < 0 || lo < 0 || n == 16) return false;
+        out[n++] = static_cast<uint8_t>((hi << 4) | lo);
+        ++i;
+    }
+    return n == 16;
+}
+
+inline const char* value_kind_name(ValueKind kind) {
+    switch (kind) {
+        case ValueKind::Null: return "null";
+        case ValueKind::Bool: return "bool";
+        case ValueKind::Int64: return "int";
+        case ValueKind::Float64: return "float";
+        case ValueKind::String: return "string";
+        case ValueKind::Timestamp: return "timestamp";
+        case ValueKind::TimestampTz: return "timestamptz";
+        case ValueKind::Date: return "date";
+    }
+    return "unknown";
+}
+
+// Значения времени и дат хранятся в том же int64-буфере, что и целые
+inline bool is_int_storage(ValueKind kind) {
+    return kind == ValueKind::Int64 || kind == ValueKind::Timestamp ||
+           kind == ValueKind::TimestampTz || kind == ValueKind::Date;
+}
+
+// Маркеры бесконечных дат ('infinity' / '-infinity' в PostgreSQL)
+inline constexpr int64_t TEMPORAL_INFINITY = INT64_MAX;
+inline constexpr int64_t TEMPORAL_NEG_INFINITY = INT64_MIN;
+
+// -----------------------------------------------------------------------------
+// Форматирование дат и времени в текстовый вид PostgreSQL
+// -----------------------------------------------------------------------------
+
+// Гражданская дата по числу дней от 1970-01-01 (алгоритм civil_from_days)
+inline void civil_from_days(int64_t days, int64_t& year, unsigned& month, unsigned& day) {
+    days += 719468;
+    const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    const unsigned doe = static_cast<unsigned>(days - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    day = doy - (153 * mp + 2) / 5 + 1;
+    month = mp < 10 ? mp + 3 : mp - 9;
+    year = static_cast<int64_t>(yoe) + era * 400 + (month <= 2);
+}
+
+// Число дней от 1970-01-01 по гражданской дате (алгоритм days_from_civil)
+inline int64_t days_from_civil(int64_t year, unsigned month, unsigned day) {
+    year -= month <= 2;
+    const int64_t era = (year >= 0 ? year : year - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(year - era * 400);
+    const unsigned doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+inline void append_padded(FastStringBuilder& b, int64_t value, int width) {
+    char buf[24];
+    int len = std::snprintf(buf, sizeof(buf), "%0*lld", width, static_cast<long long>(value));
+    if (len > 0) b.append(buf, static_cast<size_t>(len));
+}
+
+// "YYYY-MM-DD"; годы до нашей эры — с суффиксом " BC", как в PostgreSQL
+inline void append_date_parts(FastStringBuilder& b, int64_t days, bool& bc) {
+    int64_t year;
+    unsigned month, day;
+    civil_from_days(days, year, month, day);
+    bc = year <= 0;
+    append_padded(b, bc ? 1 - year : year, 4);
+    b.push_back('-');
+    append_padded(b, month, 2);
+    b.push_back('-');
+    append_padded(b, day, 2);
+}
+
+inline bool append_infinity(FastStringBuilder& b, int64_t value) {
+    if (value == TEMPORAL_INFINITY) { b.append_literal("infinity"); return true; }
+    if (value == TEMPORAL_NEG_INFINITY) { b.append_literal("-infinity"); return true; }
+    return false;
+}
+
+inline void append_date(FastStringBuilder& b, int64_t days) {
+    if (append_infinity(b, days)) return;
+    bool bc;
+    append_date_parts(b, days, bc);
+    if (bc) b.append_literal(" BC");
+}
+
+// "YYYY-MM-DD HH:MM:SS[.ffffff][+00]" — дробная часть без хвостовых нулей
+inline void append_timestamp(FastStringBuilder& b, int64_t micros, bool utc) {
+    if (append_infinity(b, micros)) return;
+
+    constexpr int64_t micros_per_day = 86400LL * 1000000LL;
+    int64_t days = micros / micros_per_day;
+    int64_t rem = micros % micros_per_day;
+    if (rem < 0) { rem += micros_per_day; --days; }
+
+    bool bc;
+    append_date_parts(b, days, bc);
+    b.push_back(' ');
+    append_padded(b, rem / 3600000000LL, 2);
+    b.push_back(':');
+    append_padded(b, rem / 60000000LL % 60, 2);
+    b.push_back(':');
+    append_padded(b, rem / 1000000LL % 60, 2);
+
+    int64_t frac = rem % 1000000LL;
+    if (frac != 0) {
+        int width = 6;
+        while (frac % 10 == 0) { frac /= 10; --width; }
+        b.push_back('.');
+        append_padded(b, frac, width);
+    }
+    if (utc) b.append_literal("+00");
+    if (bc) b.append_literal(" BC");
+}
+
+// Текстовое представление значения времени/даты заданного типа
+inline void append_temporal_text(FastStringBuilder& b, ValueKind kind, int64_t value) {
+    if (kind == ValueKind::Date) append_date(b, value);
+    else append_timestamp(b, value, kind == ValueKind::TimestampTz);
+}
+
+// Данные одной колонки: типизированный непрерывный буфер, битовая маска
+// валидности и единый буфер offsets + bytes для строк.
+// Маска совместима с Arrow: бит i (младший первым) = 1, если значение не NULL.
+// Для NULL-ячеек в типизированный буфер пишется значение по умолчанию, чтобы
+// индексы буфера совпадали с номерами строк.
+// Строки со словарём (intern_strings): offsets/chars хранят каждое различное значение
+// один раз (значение 0 — пустая строка, на него же ссылаются NULL), codes — номер
+// значения для каждой строки колонки.
+struct ColumnData {
+    ValueKind kind = ValueKind::Null;
+    size_t size = 0;
+    size_t null_count = 0;
+
+    std::vector<uint8_t> validity;   // битовая маска валидности
+    std::vector<uint8_t> bools;      // ValueKind::Bool, по байту на значение
+    std::vector<int64_t> ints;       // ValueKind::Int64
+    std::vector<double> doubles;     // ValueKind::Float64
+    std::vector<int64_t> offsets;    // ValueKind::String, size + 1 смещений в chars
+    std::string chars;               // ValueKind::String, байты всех строк подряд
+    std::vector<uint32_t> codes;     // ValueKind::String со словарём, size номеров значений
+    bool interned = false;           // строки хранятся словарём
+
+    ColumnData() = default;
+    explicit ColumnData(ValueKind k) { set_kind(k); }
+
+    // Установить тип колонки. Если до этого были только NULL — дозаполняет
+    // типизированный буфер значениями по умолчанию
+    void set_kind(ValueKind k) {
+        if (kind == k) return;
+        if (kind != ValueKind::Null)
+            throw std::runtime_error("Column kind mismatch");
+        kind = k;
+        switch (kind) {
+            case ValueKind::Bool:    bools.assign(size, 0); break;
+            case ValueKind::Float64: doubles.assign(size, 0.0); break;
+            case ValueKind::String:  offsets.assign(size + 1, 0); break;
+            case ValueKind::Null:    break;
+            default:                 ints.assign(size, 0); break;  // целочисленное хранение
+        }
+    }
+
+    // Словарное хранение строк: повторяющиеся значения хранятся один раз.
+    // Включается только на пустой колонке
+    void intern_strings() {
+        if (interned) return;
+        if (size > 0 || (kind != ValueKind::Null && kind != ValueKind::String))
+            throw std::runtime_error("String interning must be enabled on an empty column");
+        kind = ValueKind::String;
+        interned = true;
+        offsets.assign(2, 0);
+        chars.clear();
+        intern_slots_.assign(16, 0);
+        intern_slots_[std::hash<std::string_view>{}(std::string_view()) & 15] = 1;
+    }
+
+    // Число различных значений словаря (вместе с пустой строкой)
+    size_t dictionary_size() const {
+        return interned ? offsets.size() - 1 : 0;
+    }
+
+    // Перевод словарной колонки в обычную раскладку offsets + chars (нужна Arrow)
+    void materialize_strings() {
+        if (!interned) return;
+        std::vector<int64_t> flat_offsets;
+        std::string flat_chars;
+        flat_offsets.reserve(size + 1);
+        flat_chars.reserve(string_bytes(0, size));
+        flat_offsets.push_back(0);
+        for (size_t i = 0; i < size; ++i) {
+            if (!is_null(i)) flat_chars.append(string_at(i));
+            flat_offsets.push_back(static_cast<int64_t>(flat_chars.size()));
+        }
+        offsets = std::move(flat_offsets);
+        chars = std::move(flat_chars);
+        codes = std::vector<uint32_t>();
+        intern_slots_ = std::vector<uint32_t>();
+        interned = false;
+    }
+
+    void reserve(size_t n) {
+        validity.reserve((n + 7) / 8);
+        switch (kind) {
+            case ValueKind::Bool:    bools.reserve(n); break;
+            case ValueKind::Float64: doubles.reserve(n); break;
+            case ValueKind::String:
+                if (interned) codes.reserve(n);
+                else offsets.reserve(n + 1);
+                break;
+            case ValueKind::Null:    break;
+            default:                 ints.reserve(n); break;
+        }
+    }
+
+    void append_null() {
+        switch (kind) {
+            case ValueKind::Bool:    bools.push_back(0); break;
+            case ValueKind::Float64: doubles.push_back(0.0); break;
+            case ValueKind::String:
+                if (interned) codes.push_back(0);
+                else offsets.push_back(static_cast<int64_t>(chars.size()));
+                break;
+            case ValueKind::Null:    break;
+            default:                 ints.push_back(0); break;
+        }
+        push_validity(false);
+    }
+
+    void append_bool(bool v) {
+        set_kind(ValueKind::Bool);
+        bools.push_back(v ? 1 : 0);
+        push_validity(true);
+    }
+
+    void append_int(int64_t v) {
+        set_kind(ValueKind::Int64);
+        ints.push_back(v);
+        push_validity(true);
+    }
+
+    // Время/дата (kind — Timestamp, TimestampTz или Date)
+    void append_temporal(ValueKind k, int64_t v) {
+        set_kind(k);
+        ints.push_back(v);
+        push_validity(true);
+    }
+
+    void append_double(double v) {
+        set_kind(ValueKind::Float64);
+        doubles.push_back(v);
+        push_validity(true);
+    }
+
+    void append_string(std::string_view v) {
+        set_kind(ValueKind::String);
+        if (interned) {
+            codes.push_back(intern(v));
+        } else {
+            chars.append(v.data(), v.size());
+            offsets.push_back(static_cast<int64_t>(chars.size()));
+        }
+        push_validity(true);
+    }
+
+    // Массовое добавление n значений из непрерывного массива (более узкие типы
+    // расширяются до int64_t / double). nulls (если задан) — по байту на значение,
+    // ненулевой байт означает NULL
+    template <typename T>
+    void append_ints(const T* values, size_t n, const uint8_t* nulls = nullptr) {
+        set_kind(ValueKind::Int64);
+        ints.insert(ints.end(), values, values + n);
+        push_validity_bulk(n, nulls);
+    }
+
+    template <typename T>
+    void append_doubles(const T* values, size_t n, const uint8_t* nulls = nullptr) {
+        set_kind(ValueKind::Float64);
+        doubles.insert(doubles.end(), values, values + n);
+        push_validity_bulk(n, nulls);
+    }
+
+    void append(const Value& value) {
+        std::visit([&](auto&& val) {
+            using T = std::decay_t<decltype(val)>;
+
+            if constexpr (std::is_same_v<T, std::nullptr_t>) {
+                append_null();
+            } else if constexpr (std::is_same_v<T, bool>) {
+                append_bool(val);
+            } else if constexpr (std::is_same_v<T, int64_t>) {
+                append_int(val);
+            } else if constexpr (std::is_same_v<T, double>) {
+                append_double(val);
+            } else if constexpr (std::is_same_v<T, std::string>) {
+                append_string(val);
+            } else {
+                static_assert(always_false<T>, "Необработанный тип в Value");
+            }
+        }, value);
+    }
+
+    bool is_null(size_t i) const {
+        return (validity[i >> 3] & (1u << (i & 7))) == 0;
+    }
+
+    std::string_view string_at(size_t i) const {
+        return entry_at(interned ? codes[i] : i);
+    }
+
+    // Суммарная длина строк [begin, end)
+    size_t string_bytes(size_t begin, size_t end) const {
+        if (!interned) return static_cast<size_t>(offsets[end] - offsets[begin]);
+        size_t total = 0;
+        for (size_t i = begin; i < end; ++i) total += entry_at(codes[i]).size();
+        return total;
+    }
+
+    // Значение ячейки в виде Value (для точечного доступа, не для обхода всей колонки)
+    Value value_at(size_t i) const {
+        if (is_null(i)) return nullptr;
+        switch (kind) {
+            case ValueKind::Bool:    return bools[i] != 0;
+            case ValueKind::Int64:   return ints[i];
+            case ValueKind::Float64: return doubles[i];
+            case ValueKind::String:  return std::string(string_at(i));
+            case ValueKind::Null:    break;
+            default: {
+                FastStringBuilder b;
+                append_temporal_text(b, kind, ints[i]);
+                return std::move(b.str());
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    std::vector<uint32_t> intern_slots_;   // хеш-индекс словаря: номер значения + 1, 0 — пусто
+
+    std::string_view entry_at(size_t k) const {
+        return std::string_view(chars.data() + offsets[k],
+                                static_cast<size_t>(offsets[k + 1] - offsets[k]));
+    }
+
+    // Номер значения в словаре; новое значение дописывается в chars.
+    // Открытая адресация, заполнение не больше половины
+    uint32_t intern(std::string_view v) {
+        if (dictionary_size() * 2 >= intern_slots_.size()) rehash(intern_slots_.size() * 2);
+        const size_t mask = intern_slots_.size() - 1;
+        for (size_t slot = std::hash<std::string_view>{}(v) & mask;; slot = (slot + 1) & mask) {
+            const uint32_t entry = intern_slots_[slot];
+            if (entry == 0) {
+                const auto code = static_cast<uint32_t>(dictionary_size());
+                chars.append(v.data(), v.size());
+                offsets.push_back(static_cast<int64_t>(chars.size()));
+                intern_slots_[slot] = code + 1;
+                return code;
+            }
+            if (entry_at(entry - 1) == v) return entry - 1;
+        }
+    }
+
+    void rehash(size_t capacity) {
+        intern_slots_.assign(capacity, 0);
+        const size_t mask = capacity - 1;
+        for (size_t k = 0; k < dictionary_size(); ++k) {
+            size_t slot = std::hash<std::string_view>{}(entry_at(k)) & mask;
+            while (intern_slots_[slot] != 0) slot = (slot + 1) & mask;
+            intern_slots_[slot] = static_cast<uint32_t>(k + 1);
+        }
+    }
+
+    void push_validity(bool valid) {
+        if ((size & 7) == 0) validity.push_back(0);
+        if (valid)
+            validity.back() |= static_cast<uint8_t>(1u << (size & 7));
+        else
+            ++null_count;
+        ++size;
+    }
+
+    void push_validity_bulk(size_t n, const uint8_t* nulls) {
+        if (nulls) {
+            for (size_t k = 0; k < n; ++k) push_validity(nulls[k] == 0);
+            return;
+        }
+        // Без NULL: добиваем текущий байт, затем пишем маску целыми байтами
+        size_t k = 0;
+        for (; k < n && (size & 7) != 0; ++k) push_validity(true);
+        const size_t full_bytes = (n - k) / 8;
+        validity.insert(validity.end(), full_bytes, 0xFF);
+        size += full_bytes * 8;
+        k += full_bytes * 8;
+        for (; k < n; ++k) push_validity(true);
+    }
+};
+
+// -----------------------------------------------------------------------------
+// Сериализация строк результата в JSON (общая для to_json() и потоковой записи)
+// -----------------------------------------------------------------------------
+
+// Ключи объектов строк — "name": с запятой перед всеми, кроме первого;
+// экранируются один раз на результат
+inline std::vector<std::string> json_row_keys(const std::vector<ColumnInfo>& columns, size_t num_cols) {
+    std::vector<std::string> keys(num_cols);
+    for (size_t j = 0; j < num_cols; ++j) {
+        FastStringBuilder key;
+        if (j > 0) key.push_back(',');
+        key.push_back('"');
+        append_escaped_unquoted(key, columns[j].name);
+        key.append_literal("\":");
+        keys[j] = std::move(key.str());
+    }
+    return keys;
+}
+
+inline void append_json_value(FastStringBuilder& b, const ColumnData& col, size_t i) {
+    if (col.is_null(i)) {
+        b.append_literal("null");
+        return;
+    }
+    switch (col.kind) {
+        case ValueKind::Bool:
+            b.append_literal(col.bools[i] ? "true" : "false");
+            break;
+        case ValueKind::Int64:
+            b.append_number(col.ints[i]);
+            break;
+        case ValueKind::Float64:
+            b.append_number(col.doubles[i]);
+            break;
+        case ValueKind::String:
+            append_quoted_escaped(b, col.string_at(i));
+            break;
+        case ValueKind::Null:
+            b.append_literal("null");
+            break;
+        default:
+            b.push_back('"');
+            append_temporal_text(b, col.kind, col.ints[i]);
+            b.push_back('"');
+            break;
+    }
+}
+
+// Строка i как объект {"колонка":значение,...}
+inline void append_json_row(FastStringBuilder& b, const std::vector<ColumnData>& data,
+                            const std::vector<std::string>& keys, size_t i) {
+    b.push_back('{');
+    for (size_t j = 0; j < keys.size(); ++j) {
+        b.append(keys[j]);
+        append_json_value(b, data[j], i);
+    }
+    b.push_back('}');
+}
+
+// Строки [begin, end) через запятую
+inline void append_json_rows(FastStringBuilder& b, const std::vector<ColumnData>& data,
+                             const std::vector<std::string>& keys, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+        if (i > begin) b.push_back(',');
+        append_json_row(b, data, keys, i);
+    }
+}
+
+// Описание колонок: [{"name":...,"type":...},...]
+inline void append_json_columns(FastStringBuilder& b, const std::vector<ColumnInfo>& columns) {
+    b.push_back('[');
+    for (size_t i = 0; i < columns.size(); ++i) {
+        b.append_literal("{\"name\":\"");
+        append_escaped_unquoted(b, columns[i].name);
+        b.append_literal("\",\"type\":\"");
+        append_escaped_unquoted(b, columns[i].type);
+        b.append_literal("\"}");
+        if (i + 1 < columns.size())
+            b.push_back(',');
+    }
+    b.push_back(']');
+}
+
 // -----------------------------------------------------------------------------
 // Основная структура результата запроса с быстрым to_json()
 // -----------------------------------------------------------------------------
 struct QueryResult {
-    std::vector<std::vector<Value>> rows;  // Строки результата
     std::vector<ColumnInfo> columns;       // Информация о колонках
+    std::vector<ColumnData> data;          // Данные колонок (по одной на columns[i])
     size_t count = 0;                      // Общее количество строк
 
+    size_t row_count() const { return data.empty() ? 0 : data[0].size; }
+
+    // Добавить колонку вместе с её хранилищем
+    ColumnData& add_column(std::string name, std::string type, ValueKind kind = ValueKind::Null) {
+        columns.push_back({std::move(name), std::move(type)});
+        data.emplace_back(kind);
+        return data.back();
+    }
+
+    // Построчное добавление (удобно для тестов и мелких результатов)
+    void append_row(const std::vector<Value>& row) {
+        if (data.size() < columns.size()) data.resize(columns.size());
+        for (size_t j = 0; j < data.size(); ++j) {
+            if (j < row.size()) data[j].append(row[j]);
+            else data[j].append_null();
+        }
+    }
+
+    Value value_at(size_t row, size_t col) const { return data[col].value_at(row); }
+
     // Быстрая сериализация результата в JSON
     std::string to_json() const {
-        // Предварительное резервирование памяти (для минимизации реаллокаций)
-        size_t estimate = (rows.size() * columns.size() * 40) + 128;
-        estimate += estimate / 5; // небольшой запас
-        FastStringBuilder b(estimate);
+        const size_t num_rows = row_count();
+        const size_t num_cols = std::min(columns.size(), data.size());
+
+        FastStringBuilder b(json_size_estimate(0, num_rows) + 128);
+        const std::vector<std::string> keys = json_row_keys(columns, num_cols);
 
         b.append_literal("{\"rows\":[");
-        for (size_t i = 0; i < rows.size(); ++i) {
-            b.push_back('{');
-            const auto& row = rows[i];
-
-            for (size_t j = 0; j < row.size() && j < columns.size(); ++j) {
-                b.push_back('"');
-                append_escaped_unquoted(b, columns[j].name);
-                b.append_literal("\":");
-
-                // Обрабатываем разные типы значения
-                std::visit([&](auto&& val) {
-                    using T = std::decay_t<decltype(val)>;
-
-                    if constexpr (std::is_same_v<T, std::nullptr_t>) {
-                        b.append_literal("null");
-                    } else if constexpr (std::is_same_v<T, bool>) {
-                        b.append_literal(val ? "true" : "false");
-                    } else if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool>) {
-                        b.append_number(val);
-                    } else if constexpr (std::is_floating_point_v<T>) {
-                        b.append_number(val);
-                    } else if constexpr (std::is_same_v<T, std::string>) {
-                        append_quoted_escaped(b, val);
-                    } else {
-                        static_assert(always_false<T>, "Необработанный тип в Value");
-                    }
-                }, row[j]);
-
-                if (j + 1 < row.size())
-                    b.push_back(',');
-            }
+        append_json_rows(b, data, keys, 0, num_rows);
+        append_json_tail(b);
 
-            b.push_back('}');
-            if (i + 1 < rows.size())
-                b.push_back(',');
-        }
+        return std::move(b.str());
+    }
 
-        b.append_literal("],\"columns\":[");
-        for (size_t i = 0; i < columns.size(); ++i) {
-            b.append_literal("{\"name\":\"");
-            append_escaped_unquoted(b, columns[i].name);
-            b.append_literal("\",\"type\":\"");
-            append_escaped_unquoted(b, columns[i].type);
-            b.append_literal("\"}");
-            if (i + 1 < columns.size())
-                b.push_back(',');
+    // Оценка размера JSON строк [begin, end) для резервирования памяти:
+    // строки учитываем по фактическому размеру (словарные — по словарю), остальное — по оценке
+    size_t json_size_estimate(size_t begin, size_t end) const {
+        const size_t num_rows = end - begin;
+        const size_t num_cols = std::min(columns.size(), data.size());
+        size_t estimate = num_rows * num_cols * 24;
+        for (size_t j = 0; j < num_cols; ++j) {
+            estimate += num_rows * (columns[j].name.size() + 4);
+            if (data[j].kind != ValueKind::String) continue;
+            estimate += data[j].interned ? data[j].chars.size() : data[j].string_bytes(begin, end);
         }
+        return estimate + estimate / 5; // небольшой запас
+    }
 
-        b.append_literal("],\"count\":");
+    // Окончание документа после строк: ],"columns":[...],"count":N}
+    void append_json_tail(FastStringBuilder& b) const {
+        b.append_literal("],\"columns\":");
+        append_json_columns(b, columns);
+        b.append_literal(",\"count\":");
         b.append_number(count);
         b.push_back('}');
-
-        return b.str();
     }
 };
 
+// Завершающий "LIMIT <число> [OFFSET <число>]" запроса
+struct LimitClause {
+    std::string text;       // пусто — LIMIT нет
+    uint64_t limit = 0;
+    uint64_t offset = 0;
+};
+
+// Отделяет LIMIT / OFFSET в конце запроса; возвращает запрос без них
+inline std::string strip_limit_clause(const std::string& query, LimitClause& clause) {
+    static const std::regex limit_regex(R"(\s+LIMIT\s+(\d+)(\s+OFFSET\s+(\d+))?\s*;?\s*$)",
+                                        std::regex_constants::icase | std::regex_constants::ECMAScript);
+    std::smatch match;
+    if (!std::regex_search(query, match, limit_regex)) return query;
+
+    clause.text = match.str();
+    clause.limit = std::stoull(match.str(1));
+    clause.offset = match[3].matched ? std::stoull(match.str(3)) : 0;
+    return query.substr(0, match.position());
+}
+
+// Неполная страница после LIMIT — последняя: общее число строк известно без запроса
+inline bool count_from_page(const LimitClause& clause, size_t rows, size_t& count) {
+    if (rows >= clause.limit || (rows == 0 && clause.offset > 0)) return false;
+    count = clause.offset + rows;
+    return true;
+}
+
 #endif // COMMON_H
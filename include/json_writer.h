@@ -0,0 +1,93 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "common.h"
+#include "output_sink.h"
+#include "thread_pool.h"
+
+enum class JsonFormat {
+    Document,   // {"rows":[...],"columns":[...],"count":N} — как QueryResult::to_json()
+    Ndjson      // по объекту на строку текста
+};
+
+// "json", "ndjson" / "jsonl"
+JsonFormat parse_json_format(const std::string& name);
+
+// Потоковая запись результата в JSON: строки пишутся пачками по мере поступления,
+// текст копится в буфере buffer_size байт и уходит в sink, весь документ в памяти
+// не собирается. Document совпадает с to_json() байт в байт
+class JsonWriter {
+public:
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 64 << 10;
+
+    explicit JsonWriter(OutputSink& out, JsonFormat format = JsonFormat::Document,
+                        size_t buffer_size = DEFAULT_BUFFER_SIZE);
+
+    // Строки [begin, end) пачки; колонки всех пачек должны совпадать
+    void write_rows(const QueryResult& rows, size_t begin = 0, size_t end = SIZE_MAX);
+    // Завершает документ (columns и count нужны только Document) и сбрасывает sink
+    void finish(const std::vector<ColumnInfo>& columns, size_t count);
+    // Весь результат: write_rows + finish(result.columns, result.count)
+    void write(const QueryResult& result);
+
+    size_t rows_written() const;
+    bool finished() const;
+
+private:
+    void flush_buffer();
+
+    OutputSink& out_;
+    JsonFormat format_;
+    size_t buffer_size_;
+    FastStringBuilder buffer_;
+    std::vector<std::string> keys_;   // экранированные ключи строк, по первой пачке
+    bool started_;
+    bool finished_;
+    size_t rows_;
+};
+
+// Источник пачек: false — строк больше нет
+using BatchSource = std::function<bool(QueryResult& batch)>;
+
+// JSON по запросу потребителя: next_chunk отдаёт очередной кусок ровно chunk_size байт
+// (последний — короче) и читает пачки из источника только по мере надобности.
+// count в Document — число выданных строк
+class JsonChunkReader {
+public:
+    JsonChunkReader(std::vector<ColumnInfo> columns, BatchSource source, JsonFormat format, size_t chunk_size);
+    JsonChunkReader(const JsonChunkReader&) = delete;
+    JsonChunkReader& operator=(const JsonChunkReader&) = delete;
+
+    bool next_chunk(std::string& chunk);   // false — документ выдан целиком
+
+private:
+    std::vector<ColumnInfo> columns_;
+    BatchSource source_;
+    ChunkSink sink_;
+    JsonWriter writer_;
+    QueryResult batch_;
+};
+
+// Параллельная сериализация to_json(): строки делятся на куски по chunk_rows, куски
+// пишутся в свои буферы на пуле потоков и склеиваются. Результат совпадает с to_json()
+// байт в байт; меньше min_rows строк (или пул из одного потока) — обычный to_json()
+struct JsonParallelOptions {
+    size_t min_rows = 100000;
+    size_t chunk_rows = 16384;
+};
+
+// Вызывающий поток тоже сериализует куски. Нельзя вызывать из задачи того же пула:
+// ожидание задач, стоящих в очереди за ней, может не закончиться
+std::string to_json_parallel(const QueryResult& result, ThreadPool& pool,
+                             const JsonParallelOptions& options = {});
+// На общем пуле json_thread_pool()
+std::string to_json_parallel(const QueryResult& result, const JsonParallelOptions& options = {});
+
+// Общий пул сериализации: по потоку на ядро, создаётся при первом обращении
+ThreadPool& json_thread_pool();
+
+#endif // JSON_WRITER_H
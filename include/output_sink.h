@@ -0,0 +1,90 @@
+#ifndef OUTPUT_SINK_H
+#define OUTPUT_SINK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Формат выгрузки copy_out
+enum class ExportFormat {
+    Csv,
+    Tsv,      // текстовый COPY PostgreSQL / TabSeparated ClickHouse
+    Binary    // бинарный COPY PostgreSQL / Native ClickHouse
+};
+
+// "csv", "tsv" / "text", "binary" / "native"
+ExportFormat parse_export_format(const std::string& name);
+
+// Приёмник выгружаемых байт
+class OutputSink {
+public:
+    virtual ~OutputSink() = default;
+    virtual void write(const char* data, size_t size) = 0;
+    // Дописывает буферизованные данные
+    virtual void flush() {}
+};
+
+// Буферизованная запись в файловый дескриптор: мелкие куски копятся в буфере
+// и уходят крупными write(2), куски больше буфера пишутся напрямую
+class FdSink : public OutputSink {
+public:
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 1 << 20;
+
+    // Дескриптор остаётся открытым после закрытия приёмника
+    explicit FdSink(int fd, size_t buffer_size = DEFAULT_BUFFER_SIZE);
+    // Файл создаётся или перезаписывается и закрывается в close() / деструкторе
+    static std::unique_ptr<FdSink> open(const std::string& path, size_t buffer_size = DEFAULT_BUFFER_SIZE);
+    ~FdSink() override;   // дописывает буфер; ошибки записи здесь теряются — используйте close()
+    FdSink(const FdSink&) = delete;
+    FdSink& operator=(const FdSink&) = delete;
+
+    void write(const char* data, size_t size) override;
+    void flush() override;
+    // flush и закрытие файла, открытого через open
+    void close();
+    uint64_t bytes_written() const;
+
+private:
+    FdSink(int fd, size_t buffer_size, bool owns_fd);
+    void write_all(const char* data, size_t size);
+
+    int fd_;
+    bool owns_fd_;
+    std::vector<char> buffer_;
+    size_t used_;
+    uint64_t written_;
+};
+
+// Передаёт каждый кусок данных функции (без буферизации)
+class CallbackSink : public OutputSink {
+public:
+    using Callback = std::function<void(const char* data, size_t size)>;
+    explicit CallbackSink(Callback callback);
+    void write(const char* data, size_t size) override;
+
+private:
+    Callback callback_;
+};
+
+// Нарезает поток на куски ровно по chunk_size байт (последний — короче, после flush);
+// готовые куски забираются через take — для потребителей, читающих по запросу
+class ChunkSink : public OutputSink {
+public:
+    explicit ChunkSink(size_t chunk_size);
+    void write(const char* data, size_t size) override;
+    // Недобранный кусок становится готовым
+    void flush() override;
+    bool has_chunk() const;
+    bool take(std::string& chunk);   // false — готовых кусков нет
+
+private:
+    size_t chunk_size_;
+    std::string current_;
+    std::deque<std::string> ready_;
+};
+
+#endif // OUTPUT_SINK_H
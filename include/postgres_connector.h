@@ -1,15 +1,171 @@
 #ifndef POSTGRES_CONNECTOR_H
 #define POSTGRES_CONNECTOR_H
 
+#include <chrono>
 #include <string>
 #include <vector>
+#include <list>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <mutex>
 #include <libpq-fe.h>
 #include "common.h" 
+#include "json_writer.h"
+#include "output_sink.h"
+#include "result_cache.h"
+
+struct ArrowArrayStream;
+
+// Параметры запроса в текстовом формате PostgreSQL; std::nullopt — NULL
+using QueryParams = std::vector<std::optional<std::string>>;
+
+// Как заполняется QueryResult::count для SELECT
+enum class CountMode {
+    None,       // число полученных строк
+    Exact,      // COUNT(*) OVER() в том же запросе (материализует весь подзапрос)
+    Separate,   // отдельный COUNT(*) без LIMIT, только если страница заполнена
+    Estimate    // оценка планировщика (EXPLAIN), только если страница заполнена
+};
+
+// Итог одного оператора пакета execute_pipeline
+enum class BatchStatus {
+    Ok,
+    Failed,     // ошибка этого оператора
+    Skipped     // не выполнялся: раньше в пакете произошла ошибка
+};
+
+struct BatchStatementResult {
+    BatchStatus status = BatchStatus::Skipped;
+    uint64_t affected_rows = 0;     // из тега команды (UPDATE 3 → 3)
+    std::string error;
+};
+
+struct BatchResult {
+    bool success = false;           // все операторы выполнены (и транзакция пакета зафиксирована)
+    std::string error;              // ошибка вне операторов: BEGIN / COMMIT / соединение
+    std::vector<BatchStatementResult> statements;
+};
+
+// Запись каталога pg_type
+struct PgTypeInfo {
+    std::string name;       // typname; массивы — "<элемент>[]", как у встроенных типов
+    Oid element = 0;        // typelem: тип элемента массива
+    Oid base_type = 0;      // typbasetype: базовый тип домена
+    char category = 0;      // typcategory: 'A' — массив, 'E' — перечисление, ...
+    char kind = 0;          // typtype: 'b' — базовый, 'e' — перечисление, 'd' — домен, ...
+};
+
+class PostgresConnector;
+struct PgDecodePlan;
+struct PgAsyncQuery;
+
+// Потоковое чтение результата пачками строк (single-row / chunked rows mode libpq).
+// Память ограничена размером пачки, первые строки доступны до завершения запроса.
+// Пока поток открыт, соединение занято; коннектор должен жить дольше потока
+class PostgresStream {
+public:
+    ~PostgresStream();
+    PostgresStream(const PostgresStream&) = delete;
+    PostgresStream& operator=(const PostgresStream&) = delete;
+
+    // Следующая пачка (до batch_size строк); false — строк больше нет
+    bool next_batch(QueryResult& batch);
+    const std::vector<ColumnInfo>& columns();
+    bool is_open() const;
+    // Досрочное закрытие: отменяет запрос на сервере и освобождает соединение
+    void close();
+
+private:
+    friend class PostgresConnector;
+    PostgresStream(PostgresConnector* connector, size_t batch_size);
+
+    bool fetch_header();
+    void finish();
+
+    PostgresConnector* connector_;
+    size_t batch_size_;
+    bool finished_;
+    std::unique_ptr<PgDecodePlan> plan_;
+    QueryResult header_;     // колонки результата без данных
+    PGresult* pending_;      // результат, прочитанный заранее ради колонок
+};
+
+// Загрузка через COPY ... FROM STDIN. Строки передаются пачками колонок (QueryResult),
+// пачка кодируется и сразу уходит в соединение — память ограничена размером пачки.
+// Бинарный формат используется, если для всех колонок таблицы есть кодировщик и он
+// принимает значения первой пачки (строки в колонку date или int4 — текстовый формат,
+// их разбирает сервер). Колонка только из NULL вид значений не определяет: без явного
+// binary = true она тоже выбирает текстовый формат. Команда COPY уходит на сервер
+// с первой непустой пачкой.
+// Пока загрузка открыта, соединение занято
+class PostgresCopyIn {
+public:
+    ~PostgresCopyIn();   // незавершённая загрузка отменяется
+    PostgresCopyIn(const PostgresCopyIn&) = delete;
+    PostgresCopyIn& operator=(const PostgresCopyIn&) = delete;
+
+    // Колонки пачки сопоставляются колонкам COPY по порядку
+    void write(const QueryResult& batch);
+    // Завершает загрузку и возвращает число строк; ошибка сервера выбрасывается здесь
+    uint64_t finish();
+    // Отмена: сервер отбрасывает всё загруженное этим COPY
+    void abort(const std::string& reason = "COPY aborted by client");
+    bool is_open() const;
+    bool binary() const;   // окончательно — после первой непустой пачки
+    const std::vector<ColumnInfo>& columns() const;
+
+private:
+    friend class PostgresConnector;
+    PostgresCopyIn(PostgresConnector* connector, std::string command, std::vector<ColumnInfo> columns,
+                   bool binary, bool binary_requested);
+
+    void start(const QueryResult* first);
+    void encode_binary(const ColumnData& data, size_t row, size_t col);
+    void encode_text(const ColumnData& data, size_t row, size_t col);
+    void flush(size_t threshold);
+    void end(const char* error);
+
+    PostgresConnector* connector_;
+    std::string command_;               // COPY ... FROM STDIN без опции формата
+    std::vector<ColumnInfo> columns_;   // колонки таблицы с типами PostgreSQL
+    bool binary_;
+    bool binary_requested_;             // бинарный формат задан явно
+    bool started_;                      // команда COPY отправлена на сервер
+    bool finished_;
+    FastStringBuilder buffer_;
+};
 
 class PostgresConnector {
 private:
+    friend class PostgresStream;
+    friend class PostgresCopyIn;
+
     PGconn* connection_;
     bool in_transaction_;  
+    bool binary_results_;   // запрашивать результаты в бинарном формате
+    bool intern_strings_;   // строковые колонки результатов — со словарём
+    CountMode count_mode_;
+    bool preload_types_;    // загружать каталог pg_type при подключении
+
+    // Типы вне встроенной таблицы OID, прочитанные из pg_type этого соединения
+    mutable std::unordered_map<Oid, PgTypeInfo> type_cache_;
+
+    std::shared_ptr<ResultCache> result_cache_;   // кэш результатов execute; nullptr — выключен
+    std::chrono::milliseconds result_cache_ttl_;
+    std::string cache_target_;                    // сервер, база и пользователь соединения
+
+    // LRU-кэш подготовленных операторов: текст запроса -> имя оператора
+    using StatementList = std::list<std::pair<std::string, std::string>>;
+    StatementList statement_lru_;   // от недавно к давно использованным
+    std::unordered_map<std::string, StatementList::iterator> statement_index_;
+    size_t statement_cache_size_;
+    uint64_t statement_counter_;
+
+    PostgresStream* active_stream_;   // открытый поток, занимающий соединение
+    PostgresCopyIn* active_copy_;     // открытая загрузка COPY FROM STDIN
+    std::unique_ptr<PgAsyncQuery> async_;   // неблокирующий запрос в процессе
+    mutable std::mutex call_mutex_;
 
 public:
     PostgresConnector();
@@ -18,10 +174,98 @@ public:
     bool connect(const std::string& conninfo);
     void disconnect();
     bool is_connected() const;
+    // Проверка соединения одним round trip (пустой запрос)
+    bool ping();
+    // Возврат сессии в исходное состояние перед повторным использованием (пул):
+    // закрывает поток, откатывает незавершённую транзакцию. false — соединение непригодно
+    bool reset_session();
+
+    // Бинарный формат результатов: значения разбираются из сетевого порядка байт
+    // без текстового парсинга; timestamp/date хранятся как время, а не строки
+    void set_binary_results(bool enabled);
+    bool binary_results() const;
+
+    // Словарное хранение строковых колонок результатов: повторяющиеся значения
+    // (статусы, коды, категории) хранятся один раз
+    void set_intern_strings(bool enabled);
+    bool intern_strings() const;
+
+    // Каталог типов. OID вне встроенной таблицы (перечисления, домены, массивы,
+    // пользовательские типы) читаются из pg_type один раз на соединение: все неизвестные
+    // колонки результата — одним запросом. С preload весь pg_type загружается при connect
+    void set_preload_types(bool enabled);
+    bool preload_types() const;
+    // Перечитывает pg_type целиком (после CREATE TYPE / ALTER TYPE); возвращает число типов
+    size_t refresh_types();
+    // Сведения о типе (с запросом к pg_type, если его ещё нет в кэше); nullopt — тип неизвестен
+    std::optional<PgTypeInfo> type_info(Oid type_oid);
+
+    // Кэш результатов execute (SELECT / WITH вне транзакции, с параметрами и без);
+    // ключ учитывает соединение, параметры и режимы binary_results / intern_strings / count.
+    // ttl 0 — TTL кэша по умолчанию; nullptr выключает кэш
+    void set_result_cache(std::shared_ptr<ResultCache> cache,
+                          std::chrono::milliseconds ttl = std::chrono::milliseconds(0));
+    std::shared_ptr<ResultCache> result_cache() const;
     
+    // Режим подсчёта count по умолчанию для execute / prepare
+    void set_count_mode(CountMode mode);
+    CountMode count_mode() const;
+
     QueryResult execute(const std::string& query);
-    std::string execute_to_json(const std::string& query);
+    QueryResult execute(const std::string& query, CountMode count_mode);
+    // Большие результаты сериализуются параллельно (to_json_parallel)
+    std::string execute_to_json(const std::string& query, const JsonParallelOptions& json_options = {});
+    void execute_arrow(const std::string& query, ArrowArrayStream* out);
+    // Разбор готового PGresult (res не освобождается) с режимами этого коннектора;
+    // подходит и для PGresult, собранного вручную (PQmakeEmptyPGresult / PQsetvalue)
+    QueryResult decode_result(PGresult* res) const;
+
+    // Подготовленные операторы ($1, $2, ... в тексте запроса)
+    bool prepare(const std::string& name, const std::string& query);
+    QueryResult execute_prepared(const std::string& name, const QueryParams& params);
+    // Запрос с параметрами через автоматический LRU-кэш подготовленных операторов
+    QueryResult execute(const std::string& query, const QueryParams& params);
+    QueryResult execute(const std::string& query, const QueryParams& params, CountMode count_mode);
+    void set_statement_cache_size(size_t size);   // 0 — без кэша
+    size_t statement_cache_size() const;
+    void clear_statement_cache();
+
+    // Потоковое чтение без буферизации всего результата
+    std::unique_ptr<PostgresStream> stream(const std::string& query, size_t batch_size = 1000);
+    void stream_arrow(const std::string& query, size_t batch_size, ArrowArrayStream* out);
+
+    // Массовая загрузка COPY table (columns) FROM STDIN; пустой columns — все колонки,
+    // кроме генерируемых (список берётся из pg_attribute и передаётся в COPY явно).
+    // table подставляется в запрос как есть (можно со схемой), имена колонок экранируются.
+    // binary: nullopt — формат по типам колонок и первой пачке, false — текстовый,
+    // true — бинарный, если его допускают типы колонок и значения первой пачки
+    std::unique_ptr<PostgresCopyIn> copy_in(const std::string& table, const std::vector<std::string>& columns,
+                                            std::optional<bool> binary = std::nullopt);
+    uint64_t copy_in(const std::string& table, const std::vector<std::string>& columns,
+                     const QueryResult& rows, std::optional<bool> binary = std::nullopt);
+
+    // Выгрузка COPY (query) TO STDOUT: данные сервера пишутся в out как есть, без разбора.
+    // header — строка с именами колонок, только для csv (для прочих форматов — invalid_argument).
+    // Возвращает число выгруженных строк
+    uint64_t copy_out(const std::string& query, OutputSink& out, ExportFormat format = ExportFormat::Csv,
+                      bool header = false);
     
+    // Неблокирующее выполнение для цикла событий (asyncio): запрос отправляется сразу,
+    // poll_async() вызывается, когда socket() готов к чтению, и не блокируется.
+    // Запросы с параметрами идут через безымянный оператор (без кэша)
+    void send_async(const std::string& query, const QueryParams* params, CountMode count_mode);
+    int socket() const;
+    bool poll_async();                  // true — результат готов
+    // Ошибка запроса выбрасывается здесь. Строки разбираются здесь же, когда соединение
+    // уже свободно: неизвестные типы колонок дочитываются из pg_type (один раз на соединение)
+    QueryResult take_async_result();
+    bool async_pending() const;
+    void cancel_async();
+
+    // Коннектор не потокобезопасен: обёртки, вызывающие его из разных потоков
+    // (Python без GIL), сериализуют вызовы этим мьютексом
+    std::mutex& call_mutex() const;
+
     bool begin_transaction();
     int64_t get_current_transaction_id();
     bool commit_transaction();
@@ -29,10 +273,36 @@ public:
     bool is_in_transaction() const;
     
     bool execute_batch(const std::vector<std::string>& queries);
+    // Пакет в режиме конвейера libpq: все операторы отправляются без ожидания ответов,
+    // за один сетевой круг. Транзакционная семантика та же, что у execute_batch:
+    // вне транзакции пакет оборачивается в BEGIN/COMMIT, при ошибке всё откатывается
+    // (в том числе уже открытая транзакция). Каждая строка — один оператор без ;
+    BatchResult execute_pipeline(const std::vector<std::string>& queries);
 
 private:
     std::string oid_to_type_name(Oid type_oid) const;
+    QueryResult run_query(const std::string& query, const QueryParams* params, CountMode count_mode);
+    bool use_result_cache(const std::string& query) const;
+    std::string result_cache_key(const std::string& query, const QueryParams* params, CountMode count_mode) const;
+    std::string decode_type_name(Oid type_oid, const std::string& type_name) const;
+    std::string element_type_name(Oid type_oid, const std::string& type_name) const;
+    bool load_types(const std::string& filter) const;
+    void load_result_types(PGresult* res) const;
+    QueryResult build_result(PGresult* res) const;
+    void init_result_columns(PGresult* res, QueryResult& result, PgDecodePlan& plan) const;
+    void ensure_idle() const;
+    bool busy() const;
+    QueryResult command_result(PGresult* res) const;
+    std::string wrap_count_query(const std::string& query) const;
+    std::string statement_text(const std::string& query, CountMode mode) const;
+    void apply_count_mode(QueryResult& result, const std::string& query,
+                          const QueryParams* params, CountMode mode);
+    std::string scalar_query(const std::string& query, const QueryParams* params);
+    bool prepare_statement(const std::string& name, const std::string& statement);
+    const std::string& cached_statement(const std::string& statement);
+    void evict_statement();
     bool execute_simple_query(const std::string& query);
+    void run_pipeline(const std::vector<std::string>& queries, bool own_transaction, BatchResult& batch);
 };
 
 #endif // POSTGRES_CONNECTOR_H
\ No newline at end of file
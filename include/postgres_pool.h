@@ -0,0 +1,95 @@
+#ifndef POSTGRES_POOL_H
+#define POSTGRES_POOL_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include "postgres_connector.h"
+
+struct PostgresPoolOptions {
+    size_t size = 4;                                          // число соединений
+    std::chrono::milliseconds acquire_timeout{5000};          // ожидание свободного соединения
+    // Соединение, простоявшее дольше, проверяется round trip'ом при выдаче;
+    // более свежее — только по локальному статусу libpq
+    std::chrono::milliseconds health_check_after{30000};
+    // Настройки, с которыми каждое соединение выдаётся из пула
+    bool binary_results = false;
+    bool intern_strings = false;
+    bool preload_types = false;                               // весь pg_type при подключении
+    CountMode count_mode = CountMode::Exact;
+    // Общий кэш результатов execute для всех соединений пула (nullptr — без кэша)
+    std::shared_ptr<ResultCache> result_cache;
+    std::chrono::milliseconds result_cache_ttl{0};                // 0 — TTL кэша по умолчанию
+};
+
+// Потокобезопасный пул соединений PostgreSQL.
+// Соединения открываются заранее и выдаются в аренду (Lease); при возврате
+// незавершённая транзакция откатывается, а сломанное соединение закрывается.
+// Пул должен жить дольше выданных из него аренд
+class PostgresPool {
+public:
+    // Аренда соединения: возвращает его в пул в деструкторе или release()
+    class Lease {
+    public:
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&& other) noexcept;
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease();
+
+        PostgresConnector& operator*() const;
+        PostgresConnector* operator->() const;
+        PostgresConnector* get() const;
+        explicit operator bool() const;
+
+        void release();
+
+    private:
+        friend class PostgresPool;
+        Lease(PostgresPool* pool, std::unique_ptr<PostgresConnector> connection);
+
+        PostgresPool* pool_;
+        std::unique_ptr<PostgresConnector> connection_;
+    };
+
+    explicit PostgresPool(std::string conninfo, PostgresPoolOptions options = {});
+    ~PostgresPool();
+    PostgresPool(const PostgresPool&) = delete;
+    PostgresPool& operator=(const PostgresPool&) = delete;
+
+    // Ждёт свободное соединение не дольше acquire_timeout; по таймауту — исключение
+    Lease acquire();
+    Lease acquire(std::chrono::milliseconds timeout);
+
+    size_t size() const;        // максимальное число соединений
+    size_t idle() const;        // готовы к выдаче
+    size_t in_use() const;      // выданы в аренду
+
+    // Закрывает свободные соединения; выданные закрываются при возврате
+    void close();
+
+private:
+    struct IdleConnection {
+        std::unique_ptr<PostgresConnector> connection;
+        std::chrono::steady_clock::time_point since;
+    };
+
+    std::unique_ptr<PostgresConnector> open_connection() const;
+    bool check_out(PostgresConnector& connection, std::chrono::steady_clock::time_point idle_since) const;
+    void give_back(std::unique_ptr<PostgresConnector> connection);
+
+    const std::string conninfo_;
+    const PostgresPoolOptions options_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable available_;
+    std::vector<IdleConnection> idle_;   // стек: последним возвращённое выдаётся первым
+    size_t open_;                        // свободные + выданные + открывающиеся
+    size_t leased_;
+    bool closed_;
+};
+
+#endif // POSTGRES_POOL_H
@@ -0,0 +1,87 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "common.h"
+
+struct ResultCacheStats {
+    uint64_t hits = 0;          // результат выдан из кэша
+    uint64_t misses = 0;        // запрос выполнен
+    uint64_t coalesced = 0;     // дождались такого же запроса, выполнявшегося в другом потоке
+    uint64_t evictions = 0;     // вытеснены по бюджету памяти
+    uint64_t expirations = 0;   // удалены по истечении TTL
+    size_t entries = 0;
+    size_t bytes = 0;
+};
+
+// Кэш готовых результатов запросов (QueryResult после разбора) для PostgreSQL и ClickHouse.
+// Ключ — цель соединения и текст запроса без пробелов по краям (make_key). У каждой записи свой TTL,
+// общий объём ограничен max_bytes с вытеснением давно не использованных (LRU).
+// Одновременные запросы с одним ключом выполняются один раз: остальные ждут результата
+// (или ошибки) первого. Потокобезопасен; один экземпляр разделяют коннекторы и пулы
+class ResultCache {
+public:
+    using Loader = std::function<QueryResult()>;
+
+    static constexpr size_t DEFAULT_MAX_BYTES = 256 << 20;
+
+    explicit ResultCache(size_t max_bytes = DEFAULT_MAX_BYTES,
+                         std::chrono::milliseconds default_ttl = std::chrono::seconds(5));
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    // Результат из кэша или load(). ttl 0 — TTL по умолчанию.
+    // Ошибка load не кэшируется и передаётся всем, кто ждал этого выполнения.
+    // Результат больше max_bytes возвращается, но не кэшируется
+    std::shared_ptr<const QueryResult> get_or_load(const std::string& key, const Loader& load,
+                                                   std::chrono::milliseconds ttl = std::chrono::milliseconds(0));
+
+    void clear();
+    ResultCacheStats stats() const;
+    size_t max_bytes() const;
+    std::chrono::milliseconds default_ttl() const;
+
+    // Ключ: цель соединения, вариант (режимы коннектора, параметры) и нормализованный запрос
+    static std::string make_key(const std::string& target, const std::string& query,
+                                const std::string& variant = {});
+    // Текст запроса без пробелов и ; по краям; внутри запрос не меняется
+    static std::string normalize_query(const std::string& query);
+    // Кэшируются только чтения: запрос начинается с SELECT или WITH и не содержит
+    // INSERT / UPDATE / DELETE / MERGE (изменяющие CTE, SELECT ... FOR UPDATE)
+    static bool is_cacheable_query(const std::string& query);
+    // Память, занятая буферами результата
+    static size_t result_bytes(const QueryResult& result);
+
+private:
+    using Clock = std::chrono::steady_clock;
+    using ResultPtr = std::shared_ptr<const QueryResult>;
+
+    struct Entry {
+        ResultPtr result;
+        size_t bytes = 0;
+        Clock::time_point expires;
+        std::list<std::string>::iterator lru;
+    };
+
+    void store(const std::string& key, ResultPtr result, std::chrono::milliseconds ttl);
+    void erase(std::unordered_map<std::string, Entry>::iterator it);
+
+    const size_t max_bytes_;
+    const std::chrono::milliseconds default_ttl_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::list<std::string> lru_;   // от недавно к давно использованным
+    std::unordered_map<std::string, std::shared_future<ResultPtr>> in_flight_;
+    ResultCacheStats stats_;
+};
+
+#endif // RESULT_CACHE_H
@@ -0,0 +1,358 @@
+#include "arrow_export.h"
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+
+// -------------------------
+// Выбор типов Arrow
+// -------------------------
+
+static bool is_integer_format(const std::string& format) {
+    return format == "c" || format == "s" || format == "i" || format == "l" ||
+           format == "C" || format == "S" || format == "I" || format == "L" ||
+           format.starts_with("tss:");
+}
+
+// Совместим ли формат с физическим типом хранения колонки
+static bool format_matches_kind(const std::string& format, ValueKind kind) {
+    if (kind == ValueKind::Null) return true;  // колонка целиком из NULL подойдёт под любой тип
+    if (format == "b") return kind == ValueKind::Bool || kind == ValueKind::Int64;
+    if (is_integer_format(format)) return kind == ValueKind::Int64;
+    if (format == "tdD") return kind == ValueKind::Int64 || kind == ValueKind::Date;
+    if (format.starts_with("tsu:"))
+        return kind == ValueKind::Timestamp || kind == ValueKind::TimestampTz;
+    if (format == "f" || format == "g") return kind == ValueKind::Float64;
+    if (format == "U") return kind == ValueKind::String;
+    return false;
+}
+
+static std::string format_for_type_name(const std::string& type) {
+    static const std::unordered_map<std::string, std::string> type_map = {
+        // PostgreSQL
+        {"bool", "b"}, {"int2", "s"}, {"int4", "i"}, {"int8", "l"}, {"oid", "l"},
+        {"float4", "f"}, {"float8", "g"}, {"numeric", "g"},
+        {"text", "U"}, {"varchar", "U"}, {"bpchar", "U"}, {"name", "U"}, {"char", "U"},
+        {"json", "U"}, {"jsonb", "U"}, {"xml", "U"}, {"uuid", "U"},
+        {"timestamp", "tsu:"}, {"timestamptz", "tsu:UTC"}, {"date", "tdD"},
+        // ClickHouse
+        {"Bool", "b"},
+        {"Int8", "c"}, {"Int16", "s"}, {"Int32", "i"}, {"Int64", "l"},
+        {"UInt8", "C"}, {"UInt16", "S"}, {"UInt32", "I"}, {"UInt64", "L"},
+        {"Float32", "f"}, {"Float64", "g"},
+        {"String", "U"}, {"UUID", "U"},
+        {"Date", "tdD"}, {"DateTime", "tss:"}
+    };
+
+    auto it = type_map.find(type);
+    if (it != type_map.end()) return it->second;
+
+    if (type.starts_with("FixedString(")) return "U";
+    if (type.starts_with("DateTime('") && type.ends_with("')"))
+        return "tss:" + type.substr(10, type.size() - 12);
+
+    return {};
+}
+
+static std::string format_for_kind(ValueKind kind) {
+    switch (kind) {
+        case ValueKind::Bool:    return "b";
+        case ValueKind::Int64:   return "l";
+        case ValueKind::Float64: return "g";
+        case ValueKind::String:  return "U";
+        case ValueKind::Timestamp:   return "tsu:";
+        case ValueKind::TimestampTz: return "tsu:UTC";
+        case ValueKind::Date:        return "tdD";
+        case ValueKind::Null:    break;
+    }
+    return "n";
+}
+
+std::string arrow_format_for(const ColumnInfo& column, ValueKind kind) {
+    std::string format = format_for_type_name(column.type);
+    if (!format.empty() && format_matches_kind(format, kind)) return format;
+    return format_for_kind(kind);
+}
+
+// -------------------------
+// Экспорт схемы
+// -------------------------
+
+struct SchemaHolder {
+    std::string format;
+    std::string name;
+    std::vector<ArrowSchema> children;
+    std::vector<ArrowSchema*> child_ptrs;
+};
+
+static void release_schema(ArrowSchema* schema) {
+    if (!schema->release) return;
+    for (int64_t i = 0; i < schema->n_children; ++i) {
+        ArrowSchema* child = schema->children[i];
+        if (child->release) child->release(child);
+    }
+    delete static_cast<SchemaHolder*>(schema->private_data);
+    schema->release = nullptr;
+}
+
+static void fill_schema(ArrowSchema* out, SchemaHolder* holder, int64_t flags) {
+    out->format = holder->format.c_str();
+    out->name = holder->name.c_str();
+    out->metadata = nullptr;
+    out->flags = flags;
+    out->n_children = static_cast<int64_t>(holder->child_ptrs.size());
+    out->children = holder->child_ptrs.empty() ? nullptr : holder->child_ptrs.data();
+    out->dictionary = nullptr;
+    out->release = &release_schema;
+    out->private_data = holder;
+}
+
+static void export_schema(const std::vector<ColumnInfo>& columns,
+                          const std::vector<std::string>& formats, ArrowSchema* out) {
+    auto* holder = new SchemaHolder{"+s", "", {}, {}};
+    holder->children.resize(columns.size());
+    holder->child_ptrs.resize(columns.size());
+
+    for (size_t i = 0; i < columns.size(); ++i) {
+        auto* child_holder = new SchemaHolder{formats[i], columns[i].name, {}, {}};
+        fill_schema(&holder->children[i], child_holder, ARROW_FLAG_NULLABLE);
+        holder->child_ptrs[i] = &holder->children[i];
+    }
+
+    fill_schema(out, holder, 0);
+}
+
+// -------------------------
+// Экспорт массивов
+// -------------------------
+
+struct ArrayHolder {
+    ColumnData column;               // владелец перенесённых без копирования буферов
+    std::vector<uint8_t> converted;  // буфер значений, если потребовалось приведение типа
+    const void* buffers[3] = {nullptr, nullptr, nullptr};
+    std::vector<ArrowArray> children;
+    std::vector<ArrowArray*> child_ptrs;
+};
+
+static void release_array(ArrowArray* array) {
+    if (!array->release) return;
+    for (int64_t i = 0; i < array->n_children; ++i) {
+        ArrowArray* child = array->children[i];
+        if (child->release) child->release(child);
+    }
+    delete static_cast<ArrayHolder*>(array->private_data);
+    array->release = nullptr;
+}
+
+// Приведение int64-буфера к более узкому целому типу Arrow
+template <typename T>
+static const void* narrow_ints(ArrayHolder& holder, int64_t divisor = 1) {
+    const ColumnData& col = holder.column;
+    holder.converted.assign(col.size * sizeof(T), 0);
+    if (!is_int_storage(col.kind)) return holder.converted.data();
+
+    T* out = reinterpret_cast<T*>(holder.converted.data());
+    for (size_t i = 0; i < col.size; ++i) {
+        int64_t v = col.ints[i];
+        if (divisor != 1) v = (v >= 0 ? v : v - divisor + 1) / divisor;  // деление с округлением вниз
+        out[i] = static_cast<T>(v);
+    }
+    return holder.converted.data();
+}
+
+// Упаковка bool (по байту на значение) в битовую маску Arrow
+static const void* pack_bools(ArrayHolder& holder) {
+    const ColumnData& col = holder.column;
+    holder.converted.assign((col.size + 7) / 8, 0);
+    for (size_t i = 0; i < col.size; ++i) {
+        bool v = col.kind == ValueKind::Bool ? col.bools[i] != 0
+               : col.kind == ValueKind::Int64 ? col.ints[i] != 0
+               : false;
+        if (v) holder.converted[i >> 3] |= static_cast<uint8_t>(1u << (i & 7));
+    }
+    return holder.converted.data();
+}
+
+static void export_column(ColumnData&& column, const std::string& format, ArrowArray* out) {
+    auto* holder = new ArrayHolder();
+    holder->column = std::move(column);
+    ColumnData& col = holder->column;
+
+    out->length = static_cast<int64_t>(col.size);
+    out->null_count = static_cast<int64_t>(col.null_count);
+    out->offset = 0;
+    out->n_buffers = 2;
+    out->n_children = 0;
+    out->children = nullptr;
+    out->dictionary = nullptr;
+    out->release = &release_array;
+    out->private_data = holder;
+
+    holder->buffers[0] = col.null_count > 0 ? col.validity.data() : nullptr;
+
+    if (format == "n") {
+        out->n_buffers = 0;
+        out->null_count = out->length;
+    } else if (format == "b") {
+        holder->buffers[1] = pack_bools(*holder);
+    } else if (format == "c" || format == "C") {
+        holder->buffers[1] = narrow_ints<int8_t>(*holder);
+    } else if (format == "s" || format == "S") {
+        holder->buffers[1] = narrow_ints<int16_t>(*holder);
+    } else if (format == "i" || format == "I") {
+        holder->buffers[1] = narrow_ints<int32_t>(*holder);
+    } else if (format == "tdD") {
+        // ClickHouse Date хранится в секундах от эпохи, Arrow date32 — в днях
+        holder->buffers[1] = narrow_ints<int32_t>(*holder, col.kind == ValueKind::Date ? 1 : 86400);
+    } else if (format == "f") {
+        holder->converted.assign(col.size * sizeof(float), 0);
+        float* values = reinterpret_cast<float*>(holder->converted.data());
+        if (col.kind == ValueKind::Float64) {
+            for (size_t i = 0; i < col.size; ++i) values[i] = static_cast<float>(col.doubles[i]);
+        }
+        holder->buffers[1] = values;
+    } else if (format == "U") {
+        if (col.kind != ValueKind::String) col.offsets.assign(col.size + 1, 0);
+        col.materialize_strings();   // Arrow utf8 — без словаря
+        holder->buffers[1] = col.offsets.data();
+        holder->buffers[2] = col.chars.data();
+        out->n_buffers = 3;
+    } else if (format == "g") {
+        if (col.kind != ValueKind::Float64) col.doubles.assign(col.size, 0.0);
+        holder->buffers[1] = col.doubles.data();
+    } else {
+        // l, L, tss:*, tsu:* — 64-битные целые, передаются как есть
+        if (!is_int_storage(col.kind)) col.ints.assign(col.size, 0);
+        holder->buffers[1] = col.ints.data();
+    }
+
+    out->buffers = holder->buffers;
+}
+
+static void export_batch(QueryResult&& batch, const std::vector<std::string>& formats,
+                         ArrowArray* out) {
+    if (batch.data.size() != formats.size())
+        throw std::runtime_error("Batch column count does not match stream schema");
+
+    auto* holder = new ArrayHolder();
+    holder->children.resize(formats.size());
+    holder->child_ptrs.resize(formats.size());
+
+    out->length = static_cast<int64_t>(batch.row_count());
+    out->null_count = 0;
+    out->offset = 0;
+    out->n_buffers = 1;
+    out->n_children = static_cast<int64_t>(formats.size());
+    out->buffers = holder->buffers;
+    out->children = holder->child_ptrs.empty() ? nullptr : holder->child_ptrs.data();
+    out->dictionary = nullptr;
+    out->release = &release_array;
+    out->private_data = holder;
+
+    for (size_t i = 0; i < formats.size(); ++i) {
+        holder->child_ptrs[i] = &holder->children[i];
+        export_column(std::move(batch.data[i]), formats[i], &holder->children[i]);
+    }
+}
+
+// -------------------------
+// Поток батчей
+// -------------------------
+
+struct StreamState {
+    BatchSource source;
+    QueryResult pending;          // первый батч, прочитанный ради схемы
+    bool has_pending = false;
+    bool schema_ready = false;
+    bool finished = false;
+    std::vector<ColumnInfo> columns;
+    std::vector<std::string> formats;
+    std::string last_error;
+
+    void ensure_schema() {
+        if (schema_ready) return;
+        has_pending = source(pending);
+        if (!has_pending) finished = true;
+
+        columns = pending.columns;
+        formats.reserve(columns.size());
+        for (size_t i = 0; i < columns.size(); ++i) {
+            ValueKind kind = i < pending.data.size() ? pending.data[i].kind : ValueKind::Null;
+            formats.push_back(arrow_format_for(columns[i], kind));
+        }
+        schema_ready = true;
+    }
+};
+
+static StreamState* stream_state(ArrowArrayStream* stream) {
+    return static_cast<StreamState*>(stream->private_data);
+}
+
+static int stream_get_schema(ArrowArrayStream* stream, ArrowSchema* out) {
+    StreamState* state = stream_state(stream);
+    try {
+        state->ensure_schema();
+        export_schema(state->columns, state->formats, out);
+        return 0;
+    } catch (const std::exception& e) {
+        state->last_error = e.what();
+        return EIO;
+    }
+}
+
+static int stream_get_next(ArrowArrayStream* stream, ArrowArray* out) {
+    StreamState* state = stream_state(stream);
+    try {
+        state->ensure_schema();
+
+        QueryResult batch;
+        if (state->has_pending) {
+            batch = std::move(state->pending);
+            state->has_pending = false;
+        } else if (state->finished || !state->source(batch)) {
+            state->finished = true;
+            std::memset(out, 0, sizeof(*out));  // release == nullptr — конец потока
+            return 0;
+        }
+
+        export_batch(std::move(batch), state->formats, out);
+        return 0;
+    } catch (const std::exception& e) {
+        state->last_error = e.what();
+        return EIO;
+    }
+}
+
+static const char* stream_get_last_error(ArrowArrayStream* stream) {
+    StreamState* state = stream_state(stream);
+    return state->last_error.empty() ? nullptr : state->last_error.c_str();
+}
+
+static void stream_release(ArrowArrayStream* stream) {
+    if (!stream->release) return;
+    delete stream_state(stream);
+    stream->release = nullptr;
+}
+
+void export_arrow_stream(BatchSource source, ArrowArrayStream* out) {
+    auto* state = new StreamState();
+    state->source = std::move(source);
+
+    out->get_schema = &stream_get_schema;
+    out->get_next = &stream_get_next;
+    out->get_last_error = &stream_get_last_error;
+    out->release = &stream_release;
+    out->private_data = state;
+}
+
+void export_arrow_stream(QueryResult result, ArrowArrayStream* out) {
+    auto holder = std::make_shared<std::optional<QueryResult>>(std::move(result));
+    export_arrow_stream([holder](QueryResult& batch) {
+        if (!holder->has_value()) return false;
+        batch = std::move(**holder);
+        holder->reset();
+        return true;
+    }, out);
+}
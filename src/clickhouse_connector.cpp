@@ -1,10 +1,14 @@
 #include "clickhouse_connector.h"
+#include "arrow_export.h"
 #include <clickhouse/client.h>
 #include <clickhouse/columns/column.h>
 #include <clickhouse/columns/string.h>
 #include <clickhouse/columns/numeric.h>
 #include <clickhouse/columns/date.h>
+#include <clickhouse/columns/lowcardinality.h>
+#include <clickhouse/columns/itemview.h>
 #include <clickhouse/block.h>
+#include <clickhouse/query.h>
 #include <inttypes.h>
 #include <iostream>
 #include <stdexcept>
@@ -12,10 +16,12 @@
 #include <cstdio>
 #include <algorithm>
 #include <cctype>
+#include <utility>
 
 using namespace clickhouse;
 
-ClickHouseConnector::ClickHouseConnector() : client_(nullptr) {}
+ClickHouseConnector::ClickHouseConnector()
+    : client_(nullptr), active_stream_(nullptr), active_inserter_(nullptr), result_cache_ttl_(0) {}
 ClickHouseConnector::~ClickHouseConnector() { disconnect(); }
 
 bool ClickHouseConnector::connect(const std::string& host, int port,
@@ -29,8 +35,12 @@ bool ClickHouseConnector::connect(const std::string& host, int port,
         options.SetUser(user);
         options.SetPassword(password);
 
+        if (active_stream_) active_stream_->stop(false);
+        if (active_inserter_) active_inserter_->abort();
+        // Конструктор клиента уже устанавливает соединение и проходит handshake
         client_ = std::make_unique<Client>(options);
-        client_->Execute("SELECT 1");
+        options_ = std::make_unique<ClientOptions>(options);
+        cache_target_ = "clickhouse://" + user + "@" + host + ":" + std::to_string(port) + "/" + database;
         return true;
     } catch (const std::exception& e) {
         std::cerr << "ClickHouse connection error: " << e.what() << std::endl;
@@ -40,6 +50,12 @@ bool ClickHouseConnector::connect(const std::string& host, int port,
 }
 
 void ClickHouseConnector::disconnect() {
+    if (active_stream_) {
+        active_stream_->stop(false);
+    }
+    if (active_inserter_) {
+        active_inserter_->abort();
+    }
     client_.reset();
 }
 
@@ -47,17 +63,40 @@ bool ClickHouseConnector::is_connected() const {
     return client_ != nullptr;
 }
 
+bool ClickHouseConnector::ping() {
+    if (!is_connected() || active_stream_ || active_inserter_) return false;
+    try {
+        client_->Ping();
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+std::mutex& ClickHouseConnector::call_mutex() const {
+    return call_mutex_;
+}
+
+bool ClickHouseConnector::reset_session() {
+    if (active_stream_) {
+        active_stream_->close();
+    }
+    if (active_inserter_) {
+        active_inserter_->abort();
+    }
+    return is_connected();
+}
+
+void ClickHouseConnector::ensure_idle() const {
+    if (!is_connected()) throw std::runtime_error("Not connected to ClickHouse");
+    if (active_stream_) throw std::runtime_error("Connection is busy with an open stream");
+    if (active_inserter_) throw std::runtime_error("Connection is busy with an open insert");
+}
+
 // -------------------------
 // Вспомогательные функции
 // -------------------------
 
-inline std::string to_upper(const std::string& str) {
-    std::string upper = str;
-    std::transform(upper.begin(), upper.end(), upper.begin(),
-                   [](unsigned char c){ return std::toupper(c); });
-    return upper;
-}
-
 std::string ClickHouseConnector::normalize_type_name(const std::string& type_name) const {
     std::string result = type_name;
 
@@ -77,129 +116,430 @@ std::string ClickHouseConnector::normalize_type_name(const std::string& type_nam
     return result;
 }
 
-static Value value_to_variant(const ColumnRef& column, size_t row_idx) {
-    try {
-        // Обрабатываем Nullable типы
-        if (auto nullable_col = column->As<ColumnNullable>()) {
-            if (nullable_col->IsNull(row_idx)) return nullptr;
-            return value_to_variant(nullable_col->Nested(), row_idx);
-        }
+// Разбор колонки блока целиком. Тип определяется один раз на колонку блока
+// (resolve_column_decoder), затем декодер проходит всю колонку без поячеечного
+// выбора типа. nulls — маска Nullable (ненулевой байт — NULL) или nullptr
+using ColumnDecoder = void (*)(ColumnData& data, Column& column, const uint8_t* nulls);
+
+// Целые и числа с плавающей точкой лежат в clickhouse-cpp непрерывными массивами —
+// копируются целиком
+template <typename T>
+static void decode_integers(ColumnData& data, Column& column, const uint8_t* nulls) {
+    auto& values = static_cast<ColumnVector<T>&>(column).GetWritableData();
+    data.append_ints(values.data(), values.size(), nulls);
+}
+
+template <typename T>
+static void decode_floats(ColumnData& data, Column& column, const uint8_t* nulls) {
+    auto& values = static_cast<ColumnVector<T>&>(column).GetWritableData();
+    data.append_doubles(values.data(), values.size(), nulls);
+}
+
+// String / FixedString: байты копируются в буфер строк результата без промежуточных std::string
+template <typename Col>
+static void decode_strings(ColumnData& data, Column& column, const uint8_t* nulls) {
+    auto& col = static_cast<Col&>(column);
+    const size_t n = col.Size();
+    data.set_kind(ValueKind::String);
+    data.reserve(data.size + n);
+    for (size_t i = 0; i < n; ++i) {
+        if (nulls && nulls[i]) data.append_null();
+        else data.append_string(col.At(i));
+    }
+}
 
-        // Обрабатываем String
-        if (auto col = column->As<ColumnString>()) return std::string(col->At(row_idx));
-        if (auto col = column->As<ColumnFixedString>()) return std::string(col->At(row_idx));
-
-        // Обрабатываем Integers
-        if (auto col = column->As<ColumnInt8>()) return static_cast<int64_t>(col->At(row_idx));
-        if (auto col = column->As<ColumnInt16>()) return static_cast<int64_t>(col->At(row_idx));
-        if (auto col = column->As<ColumnInt32>()) return static_cast<int64_t>(col->At(row_idx));
-        if (auto col = column->As<ColumnInt64>()) return col->At(row_idx);
-
-        if (auto col = column->As<ColumnUInt8>()) return static_cast<int64_t>(col->At(row_idx));
-        if (auto col = column->As<ColumnUInt16>()) return static_cast<int64_t>(col->At(row_idx));
-        if (auto col = column->As<ColumnUInt32>()) return static_cast<int64_t>(col->At(row_idx));
-        if (auto col = column->As<ColumnUInt64>()) return static_cast<int64_t>(col->At(row_idx));
-
-        // Обрабатываем Floats
-        if (auto col = column->As<ColumnFloat32>()) return static_cast<double>(col->At(row_idx));
-        if (auto col = column->As<ColumnFloat64>()) return col->At(row_idx);
-
-        // Обрабатываем Date / DateTime
-        if (auto col = column->As<ColumnDate>()) return static_cast<int64_t>(col->At(row_idx));
-        if (auto col = column->As<ColumnDateTime>()) return static_cast<int64_t>(col->At(row_idx));
-
-        // Обрабатываем UUID
-        if (auto col = column->As<ColumnUUID>()) {
-            auto uuid = col->At(row_idx);
-            char buf[37];
-            snprintf(buf, sizeof(buf),
-                     "%08" PRIx64 "-%04" PRIx64 "-%04" PRIx64 "-%04" PRIx64 "-%012" PRIx64,
-                     (uuid.first >> 32) & 0xFFFFFFFF,
-                     (uuid.first >> 16) & 0xFFFF,
-                     uuid.first & 0xFFFF,
-                     (uuid.second >> 48) & 0xFFFF,
-                     uuid.second & 0xFFFFFFFFFFFF);
-            return std::string(buf);
+// Date / DateTime — секунды от эпохи
+template <typename Col>
+static void decode_seconds(ColumnData& data, Column& column, const uint8_t* nulls) {
+    auto& col = static_cast<Col&>(column);
+    const size_t n = col.Size();
+    data.set_kind(ValueKind::Int64);
+    data.reserve(data.size + n);
+    for (size_t i = 0; i < n; ++i) {
+        if (nulls && nulls[i]) data.append_null();
+        else data.append_int(static_cast<int64_t>(col.At(i)));
+    }
+}
+
+static void decode_uuids(ColumnData& data, Column& column, const uint8_t* nulls) {
+    auto& col = static_cast<ColumnUUID&>(column);
+    const size_t n = col.Size();
+    data.set_kind(ValueKind::String);
+    data.reserve(data.size + n);
+    char buf[37];
+    for (size_t i = 0; i < n; ++i) {
+        if (nulls && nulls[i]) {
+            data.append_null();
+            continue;
         }
+        auto uuid = col.At(i);
+        snprintf(buf, sizeof(buf),
+                 "%08" PRIx64 "-%04" PRIx64 "-%04" PRIx64 "-%04" PRIx64 "-%012" PRIx64,
+                 (uuid.first >> 32) & 0xFFFFFFFF,
+                 (uuid.first >> 16) & 0xFFFF,
+                 uuid.first & 0xFFFF,
+                 (uuid.second >> 48) & 0xFFFF,
+                 uuid.second & 0xFFFFFFFFFFFF);
+        data.append_string(std::string_view(buf, 36));
+    }
+}
 
-        return "[" + column->Type()->GetName() + "]";
+// LowCardinality(String), LowCardinality(Nullable(FixedString(N))) и т. п.
+static bool is_low_cardinality_string(std::string_view type) {
+    if (!type.starts_with("LowCardinality(")) return false;
+    type.remove_prefix(sizeof("LowCardinality(") - 1);
+    if (type.starts_with("Nullable(")) type.remove_prefix(sizeof("Nullable(") - 1);
+    return type.starts_with("String") || type.starts_with("FixedString(");
+}
 
-    } catch (const std::exception& e) {
-        return "[ERROR: " + std::string(e.what()) + "]";
+// LowCardinality-строки хранятся словарём, как и на сервере; NULL — внутри словаря
+static void decode_low_cardinality(ColumnData& data, Column& column, const uint8_t*) {
+    auto& col = static_cast<ColumnLowCardinality&>(column);
+    const size_t n = col.Size();
+    if (data.size == 0) data.intern_strings();
+    data.set_kind(ValueKind::String);
+    data.reserve(data.size + n);
+    for (size_t i = 0; i < n; ++i) {
+        const ItemView item = col.GetItem(i);
+        if (item.type == Type::Void) data.append_null();
+        else data.append_string(item.AsBinaryData());
+    }
+}
+
+// Тип без декодера: в ячейках имя типа в квадратных скобках
+static void decode_unsupported(ColumnData& data, Column& column, const uint8_t* nulls) {
+    const std::string placeholder = "[" + column.Type()->GetName() + "]";
+    const size_t n = column.Size();
+    data.reserve(data.size + n);
+    for (size_t i = 0; i < n; ++i) {
+        if (nulls && nulls[i]) data.append_null();
+        else data.append_string(placeholder);
     }
 }
 
+// Декодер для колонки (Nullable уже снят)
+static ColumnDecoder resolve_column_decoder(const ColumnRef& column) {
+    if (column->As<ColumnString>()) return &decode_strings<ColumnString>;
+    if (column->As<ColumnFixedString>()) return &decode_strings<ColumnFixedString>;
+
+    if (column->As<ColumnInt8>()) return &decode_integers<int8_t>;
+    if (column->As<ColumnInt16>()) return &decode_integers<int16_t>;
+    if (column->As<ColumnInt32>()) return &decode_integers<int32_t>;
+    if (column->As<ColumnInt64>()) return &decode_integers<int64_t>;
+    if (column->As<ColumnUInt8>()) return &decode_integers<uint8_t>;
+    if (column->As<ColumnUInt16>()) return &decode_integers<uint16_t>;
+    if (column->As<ColumnUInt32>()) return &decode_integers<uint32_t>;
+    if (column->As<ColumnUInt64>()) return &decode_integers<uint64_t>;
+
+    if (column->As<ColumnFloat32>()) return &decode_floats<float>;
+    if (column->As<ColumnFloat64>()) return &decode_floats<double>;
+
+    if (column->As<ColumnDate>()) return &decode_seconds<ColumnDate>;
+    if (column->As<ColumnDateTime>()) return &decode_seconds<ColumnDateTime>;
+    if (column->As<ColumnUUID>()) return &decode_uuids;
+
+    if (column->As<ColumnLowCardinality>() && is_low_cardinality_string(column->Type()->GetName()))
+        return &decode_low_cardinality;
+    return &decode_unsupported;
+}
+
 // -------------------------
 // Основные методы
 // -------------------------
 
-QueryResult ClickHouseConnector::execute(const std::string& query) {
-    if (!is_connected()) throw std::runtime_error("Not connected to ClickHouse");
+// Дописывает строки блока в колоночные буферы результата;
+// колонки результата создаются по первому блоку
+void ClickHouseConnector::append_block(QueryResult& result, const Block& block) const {
+    if (result.columns.empty()) {
+        for (size_t i = 0; i < block.GetColumnCount(); ++i) {
+            result.add_column(block.GetColumnName(i),
+                              normalize_type_name(block[i]->Type()->GetName()));
+        }
+    }
 
-    QueryResult result;
-    std::string upper_query = to_upper(query);
-    std::string count_query;
+    for (size_t col_idx = 0; col_idx < block.GetColumnCount(); ++col_idx) {
+        ColumnRef column = block[col_idx];
+        const uint8_t* nulls = nullptr;
+        if (auto nullable_col = column->As<ColumnNullable>()) {
+            auto nulls_col = nullable_col->Nulls()->As<ColumnUInt8>();
+            if (!nulls_col) throw std::runtime_error("Unexpected Nullable column layout");
+            nulls = nulls_col->GetWritableData().data();
+            column = nullable_col->Nested();
+        }
+        resolve_column_decoder(column)(result.data[col_idx], *column, nulls);
+    }
+}
 
-    if (upper_query.find("SELECT") != std::string::npos &&
-        upper_query.find("COUNT(") == std::string::npos) {
-        size_t from_pos = upper_query.find("FROM");
-        if (from_pos != std::string::npos) {
-            count_query = "SELECT COUNT(*) " + query.substr(from_pos);
+// Запасной подсчёт, когда сервер применил LIMIT, но не прислал rows_before_limit:
+// count() по запросу без завершающего LIMIT / OFFSET
+size_t ClickHouseConnector::count_without_limit(const std::string& query, size_t rows) {
+    LimitClause clause;
+    std::string body = strip_limit_clause(query, clause);
+    if (clause.text.empty()) return rows;   // LIMIT внутри подзапроса — считаем полученные строки
 
-            size_t order_pos = count_query.find("ORDER BY");
-            if (order_pos != std::string::npos) count_query = count_query.substr(0, order_pos);
+    size_t count = rows;
+    if (count_from_page(clause, rows, count)) return count;
 
-            size_t limit_pos = count_query.find("LIMIT");
-            if (limit_pos != std::string::npos) count_query = count_query.substr(0, limit_pos);
-        }
-    }
+    try {
+        client_->Select("SELECT count() FROM (" + body + ")", [&count](const Block& block) {
+            if (block.GetRowCount() > 0 && block.GetColumnCount() > 0) {
+                if (auto col = block[0]->As<ColumnUInt64>()) count = col->At(0);
+            }
+        });
+    } catch (...) {}
+    return count;
+}
 
-    // COUNT(*)
-    if (!count_query.empty()) {
-        try {
-            client_->Select(count_query, [&result](const Block& block) {
-                if (block.GetRowCount() > 0 && block.GetColumnCount() > 0) {
-                    if (auto col = block[0]->As<ColumnUInt64>()) result.count = col->At(0);
-                }
-            });
-        } catch (...) { result.count = 0; }
+QueryResult ClickHouseConnector::execute(const std::string& query) {
+    ensure_idle();
+    if (result_cache_ && ResultCache::is_cacheable_query(query)) {
+        return *result_cache_->get_or_load(ResultCache::make_key(cache_target_, query),
+                                          [&] { return run_query(query); }, result_cache_ttl_);
     }
+    return run_query(query);
+}
+
+void ClickHouseConnector::set_result_cache(std::shared_ptr<ResultCache> cache, std::chrono::milliseconds ttl) {
+    result_cache_ = std::move(cache);
+    result_cache_ttl_ = ttl;
+}
+
+std::shared_ptr<ResultCache> ClickHouseConnector::result_cache() const {
+    return result_cache_;
+}
 
-    // Основной запрос
+// Выполнение запроса в обход кэша результатов
+QueryResult ClickHouseConnector::run_query(const std::string& query) {
+    QueryResult result;
     size_t total_rows = 0;
+    // Общее число строк без LIMIT сервер присылает в пакете Profile вместе с основным запросом
+    bool applied_limit = false;
+    bool rows_before_limit_known = false;
+    size_t rows_before_limit = 0;
+
     try {
-        client_->Select(query, [this, &result, &total_rows](const Block& block) {
-            if (result.columns.empty()) {
-                for (size_t i = 0; i < block.GetColumnCount(); ++i) {
-                    ColumnInfo col;
-                    col.name = block.GetColumnName(i);
-                    col.type = normalize_type_name(block[i]->Type()->GetName());
-                    result.columns.push_back(col);
-                }
+        Query select(query);
+        select.OnData([this, &result, &total_rows](const Block& block) {
+            total_rows += block.GetRowCount();
+            append_block(result, block);
+        });
+        select.OnProfile([&](const Profile& profile) {
+            applied_limit = applied_limit || profile.applied_limit;
+            if (profile.calculated_rows_before_limit) {
+                rows_before_limit_known = true;
+                rows_before_limit = std::max<size_t>(rows_before_limit, profile.rows_before_limit);
             }
+        });
+        client_->Select(select);
+
+        if (rows_before_limit_known) {
+            result.count = std::max(rows_before_limit, total_rows);
+        } else if (applied_limit) {
+            result.count = count_without_limit(query, total_rows);
+        } else {
+            result.count = total_rows;
+        }
+
+    } catch (const std::exception& e) {
+        throw std::runtime_error("ClickHouse query failed: " + std::string(e.what()));
+    }
+
+    return result;
+}
+
+std::string ClickHouseConnector::execute_to_json(const std::string& query, const JsonParallelOptions& json_options) {
+    QueryResult result = execute(query);
+    return to_json_parallel(result, json_options);
+}
+
+void ClickHouseConnector::execute_arrow(const std::string& query, ArrowArrayStream* out) {
+    export_arrow_stream(execute(query), out);
+}
+
+// -------------------------
+// Потоковое чтение
+// -------------------------
+
+std::unique_ptr<ClickHouseStream> ClickHouseConnector::stream(const std::string& query, size_t batch_rows,
+                                                              size_t queue_depth) {
+    ensure_idle();
+
+    std::unique_ptr<ClickHouseStream> result(
+        new ClickHouseStream(this, batch_rows, std::max<size_t>(queue_depth, 1)));
+    active_stream_ = result.get();
+    result->start(query);
+    return result;
+}
 
-            size_t rows_in_block = block.GetRowCount();
-            total_rows += rows_in_block;
+void ClickHouseConnector::stream_arrow(const std::string& query, size_t batch_rows, ArrowArrayStream* out) {
+    std::shared_ptr<ClickHouseStream> rows = stream(query, batch_rows);
+    export_arrow_stream([rows](QueryResult& batch) {
+        if (rows->next_batch(batch)) return true;
+        batch.columns = rows->columns();   // схема нужна и для пустого результата
+        return false;
+    }, out);
+}
+
+ClickHouseStream::ClickHouseStream(ClickHouseConnector* connector, size_t batch_rows, size_t queue_depth)
+    : connector_(connector),
+      batch_rows_(batch_rows),
+      queue_depth_(queue_depth),
+      shared_(std::make_shared<Shared>()),
+      finished_(false) {}
+
+ClickHouseStream::~ClickHouseStream() {
+    close();
+}
+
+bool ClickHouseStream::is_open() const {
+    return !finished_;
+}
 
-            for (size_t row_idx = 0; row_idx < rows_in_block; ++row_idx) {
-                std::vector<Value> row;
-                for (size_t col_idx = 0; col_idx < block.GetColumnCount(); ++col_idx) {
-                    row.push_back(value_to_variant(block[col_idx], row_idx));
+// Клиент берётся здесь, а не в потоке: close() может забрать client_ у коннектора в любой момент
+void ClickHouseStream::start(const std::string& query) {
+    worker_ = std::thread(&ClickHouseStream::produce, shared_, connector_, connector_->client_.get(),
+                          query, batch_rows_, queue_depth_);
+}
+
+// Фоновый поток: блоки сервера копятся в пачку до batch_rows строк и уходят в очередь.
+// Возврат false из колбэка отменяет запрос на сервере (SelectCancelable).
+// К коннектору поток обращается только внутри колбэка (in_callback): после close()
+// ClickHouseStream и коннектор могут быть уже уничтожены
+void ClickHouseStream::produce(std::shared_ptr<Shared> shared, ClickHouseConnector* connector,
+                               clickhouse::Client* client, const std::string& query,
+                               size_t batch_rows, size_t queue_depth) {
+    Shared& state = *shared;
+    QueryResult pending;
+    try {
+        client->SelectCancelable(query, [&](const Block& block) {
+            {
+                // После отмены клиент дочитывает ответ сервера — блоки уже не разбираем
+                std::lock_guard<std::mutex> lock(state.mutex);
+                if (state.cancelled) return false;
+                state.in_callback = true;
+            }
+            bool more = false;
+            try {
+                connector->append_block(pending, block);
+
+                if (!pending.columns.empty()) {
+                    std::lock_guard<std::mutex> lock(state.mutex);
+                    if (!state.columns_ready) {
+                        state.columns = pending.columns;
+                        state.columns_ready = true;
+                        state.ready.notify_all();
+                    }
                 }
-                result.rows.push_back(std::move(row));
+
+                more = pending.row_count() == 0 || pending.row_count() < batch_rows ||
+                       push_batch(state, pending, queue_depth);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(state.mutex);
+                state.in_callback = false;
+                state.space.notify_all();
+                throw;
             }
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.in_callback = false;
+            state.space.notify_all();
+            return more;
         });
+        if (pending.row_count() > 0) push_batch(state, pending, queue_depth);
+    } catch (const std::exception& e) {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.error = std::make_exception_ptr(
+            std::runtime_error("ClickHouse query failed: " + std::string(e.what())));
+    }
+
+    std::unique_ptr<Client> orphan;
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.producer_done = true;
+        orphan = std::move(state.orphan);
+        state.ready.notify_all();
+        state.space.notify_all();
+    }
+    // orphan закрывает соединение, брошенное close()
+}
 
-        if (result.count == 0) result.count = total_rows;
+// Ждёт места в очереди: пока потребитель не забрал пачки, сокет не читается
+bool ClickHouseStream::push_batch(Shared& shared, QueryResult& batch, size_t queue_depth) {
+    std::unique_lock<std::mutex> lock(shared.mutex);
+    shared.space.wait(lock, [&] { return shared.cancelled || shared.queue.size() < queue_depth; });
+    if (shared.cancelled) return false;
+
+    batch.count = batch.row_count();
+    shared.queue.push_back(std::move(batch));
+    batch = QueryResult();
+    shared.ready.notify_all();
+    return true;
+}
 
-    } catch (const std::exception& e) {
-        throw std::runtime_error("ClickHouse query failed: " + std::string(e.what()));
+const std::vector<ColumnInfo>& ClickHouseStream::columns() {
+    std::unique_lock<std::mutex> lock(shared_->mutex);
+    shared_->ready.wait(lock, [this] {
+        return shared_->columns_ready || shared_->producer_done || shared_->cancelled;
+    });
+    return shared_->columns;
+}
+
+bool ClickHouseStream::next_batch(QueryResult& batch) {
+    if (finished_) return false;
+
+    std::unique_lock<std::mutex> lock(shared_->mutex);
+    shared_->ready.wait(lock, [this] { return !shared_->queue.empty() || shared_->producer_done; });
+
+    if (!shared_->queue.empty()) {
+        batch = std::move(shared_->queue.front());
+        shared_->queue.pop_front();
+        shared_->space.notify_all();
+        return true;
     }
 
-    return result;
+    std::exception_ptr error = std::exchange(shared_->error, nullptr);
+    lock.unlock();
+    finish();
+    if (error) std::rethrow_exception(error);
+    return false;
 }
 
-std::string ClickHouseConnector::execute_to_json(const std::string& query) {
-    QueryResult result = execute(query);
-    return result.to_json();
-}
\ No newline at end of file
+void ClickHouseStream::close() {
+    stop(true);
+}
+
+// Если поток ещё читает ответ сервера, join ждал бы следующего блока (у долгого запроса —
+// до его конца). Вместо этого клиент вместе с потоком отсоединяется от коннектора
+void ClickHouseStream::stop(bool reconnect) {
+    if (finished_) return;
+    bool detached = false;
+    {
+        std::unique_lock<std::mutex> lock(shared_->mutex);
+        shared_->cancelled = true;
+        shared_->queue.clear();
+        shared_->space.notify_all();
+        // Разбор блока и ожидание места в очереди завершаются сразу после отмены
+        shared_->space.wait(lock, [this] { return !shared_->in_callback || shared_->producer_done; });
+        if (!shared_->producer_done && worker_.joinable()) {
+            shared_->orphan = std::move(connector_->client_);
+            worker_.detach();
+            detached = true;
+        }
+    }
+    finish();
+
+    if (detached && reconnect && connector_->options_) {
+        try {
+            connector_->client_ = std::make_unique<Client>(*connector_->options_);
+        } catch (const std::exception& e) {
+            std::cerr << "ClickHouse reconnection error: " << e.what() << std::endl;
+        }
+    }
+}
+
+void ClickHouseStream::finish() {
+    if (worker_.joinable()) worker_.join();
+    finished_ = true;
+    if (connector_->active_stream_ == this) {
+        connector_->active_stream_ = nullptr;
+    }
+}
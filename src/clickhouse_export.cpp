@@ -0,0 +1,165 @@
+#include "clickhouse_connector.h"
+#include <clickhouse/client.h>
+#include <clickhouse/block.h>
+#include <clickhouse/base/output.h>
+#include <clickhouse/base/wire_format.h>
+#include <clickhouse/columns/column.h>
+#include <clickhouse/columns/string.h>
+#include <cctype>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace clickhouse;
+
+// -------------------------
+// Выгрузка в CSV / TSV / Native
+// -------------------------
+
+namespace {
+
+// Текст копится до такого размера и передаётся приёмнику одним куском
+constexpr size_t EXPORT_CHUNK_BYTES = 1 << 20;
+
+// Экранирование TabSeparated: \\, \t, \n, \r
+void append_tsv_escaped(FastStringBuilder& b, std::string_view text) {
+    const char* p = text.data();
+    const char* end = p + text.size();
+    while (p < end) {
+        const char* q = p;
+        while (q < end && *q != '\\' && *q != '\t' && *q != '\n' && *q != '\r') ++q;
+        if (q > p) b.append(p, static_cast<size_t>(q - p));
+        if (q == end) break;
+        switch (*q) {
+            case '\\': b.append_literal("\\\\"); break;
+            case '\t': b.append_literal("\\t"); break;
+            case '\n': b.append_literal("\\n"); break;
+            default:   b.append_literal("\\r"); break;
+        }
+        p = q + 1;
+    }
+}
+
+// Строка CSV в кавычках; кавычки внутри удваиваются
+void append_csv_quoted(FastStringBuilder& b, std::string_view text) {
+    b.push_back('"');
+    const char* p = text.data();
+    const char* end = p + text.size();
+    while (p < end) {
+        const char* q = static_cast<const char*>(std::memchr(p, '"', static_cast<size_t>(end - p)));
+        if (!q) q = end;
+        b.append(p, static_cast<size_t>(q - p));
+        if (q == end) break;
+        b.append_literal("\"\"");
+        p = q + 1;
+    }
+    b.push_back('"');
+}
+
+void append_header(FastStringBuilder& b, const std::vector<std::string>& names, ExportFormat format) {
+    const char separator = format == ExportFormat::Csv ? ',' : '\t';
+    for (size_t j = 0; j < names.size(); ++j) {
+        if (j > 0) b.push_back(separator);
+        if (format == ExportFormat::Csv) append_csv_quoted(b, names[j]);
+        else append_tsv_escaped(b, names[j]);
+    }
+    b.push_back('\n');
+}
+
+// Запрос без завершающих ; и пробелов — для подстановки в подзапрос
+std::string export_query_body(const std::string& query) {
+    size_t end = query.size();
+    while (end > 0 && (std::isspace(static_cast<unsigned char>(query[end - 1])) || query[end - 1] == ';')) --end;
+    return query.substr(0, end);
+}
+
+// Блок в формате Native: число колонок и строк, затем для каждой колонки
+// имя, тип и данные в сериализации clickhouse-cpp (та же, что у сервера)
+void append_native(Buffer& buffer, const Block& block) {
+    BufferOutput output(&buffer);
+    WireFormat::WriteUInt64(output, block.GetColumnCount());
+    WireFormat::WriteUInt64(output, block.GetRowCount());
+    for (size_t j = 0; j < block.GetColumnCount(); ++j) {
+        WireFormat::WriteString(output, block.GetColumnName(j));
+        WireFormat::WriteString(output, block[j]->Type()->GetName());
+        block[j]->Save(&output);
+    }
+    output.Flush();
+}
+
+} // namespace
+
+// Csv / Tsv строки форматирует сервер (formatRow), поэтому вывод совпадает с FORMAT CSV /
+// TabSeparated для любых типов: Decimal, Enum, даты в часовом поясе колонки, массивы, кортежи
+uint64_t ClickHouseConnector::copy_out(const std::string& query, OutputSink& out, ExportFormat format,
+                                       bool header) {
+    ensure_idle();
+
+    const bool binary = format == ExportFormat::Binary;
+    const std::string body = export_query_body(query);
+    uint64_t rows = 0;
+    FastStringBuilder text;
+    Buffer native;
+    std::exception_ptr sink_error;
+
+    try {
+        if (header && !binary) {
+            // Имена колонок без выполнения запроса
+            std::vector<std::string> names;
+            bool layout_ok = true;
+            client_->Select("DESCRIBE TABLE (" + body + ")", [&](const Block& block) {
+                if (block.GetColumnCount() == 0) return;
+                auto name = block[0]->As<ColumnString>();
+                if (!name) {
+                    layout_ok = false;
+                    return;
+                }
+                for (size_t i = 0; i < block.GetRowCount(); ++i) names.emplace_back(name->At(i));
+            });
+            if (!layout_ok) throw std::runtime_error("Unexpected DESCRIBE result layout");
+            append_header(text, names, format);
+        }
+
+        const std::string select = binary ? query
+            : "SELECT formatRow('" + std::string(format == ExportFormat::Csv ? "CSV" : "TabSeparated") +
+              "', *) FROM (" + body + ")";
+
+        // Ошибка приёмника отменяет запрос: клиент дочитывает ответ сервера без разбора блоков
+        client_->SelectCancelable(select, [&](const Block& block) {
+            try {
+                if (block.GetRowCount() == 0) return true;
+                rows += block.GetRowCount();
+
+                if (binary) {
+                    native.clear();
+                    append_native(native, block);
+                    out.write(reinterpret_cast<const char*>(native.data()), native.size());
+                    return true;
+                }
+
+                // Каждое значение — готовая строка текста вместе с переводом строки
+                auto lines = block[0]->As<ColumnString>();
+                if (!lines) throw std::runtime_error("Unexpected formatRow result layout");
+                for (size_t i = 0; i < block.GetRowCount(); ++i) text.append(lines->At(i));
+                if (text.str().size() >= EXPORT_CHUNK_BYTES) {
+                    out.write(text.str().data(), text.str().size());
+                    text.str().clear();
+                }
+                return true;
+            } catch (...) {
+                sink_error = std::current_exception();
+                return false;
+            }
+        });
+    } catch (const std::exception& e) {
+        if (sink_error) std::rethrow_exception(sink_error);
+        throw std::runtime_error("ClickHouse query failed: " + std::string(e.what()));
+    }
+    if (sink_error) std::rethrow_exception(sink_error);
+
+    if (!text.str().empty()) out.write(text.str().data(), text.str().size());
+    out.flush();
+    return rows;
+}
@@ -0,0 +1,519 @@
+#include "clickhouse_connector.h"
+#include <clickhouse/client.h>
+#include <clickhouse/block.h>
+#include <clickhouse/columns/column.h>
+#include <clickhouse/columns/date.h>
+#include <clickhouse/columns/enum.h>
+#include <clickhouse/columns/factory.h>
+#include <clickhouse/columns/lowcardinality.h>
+#include <clickhouse/columns/nullable.h>
+#include <clickhouse/columns/numeric.h>
+#include <clickhouse/columns/string.h>
+#include <clickhouse/columns/uuid.h>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+using namespace clickhouse;
+
+// -------------------------
+// Колонки пачки → колонки clickhouse-cpp
+// -------------------------
+
+namespace {
+
+constexpr int64_t MICROS_PER_SECOND = 1000000;
+constexpr int64_t SECONDS_PER_DAY = 86400;
+
+[[noreturn]] void type_mismatch(const ColumnInfo& info, ValueKind kind) {
+    throw std::runtime_error("Cannot insert " + std::string(value_kind_name(kind)) + " value into column '" +
+                             info.name + "' of type " + info.type);
+}
+
+bool is_null_cell(const ColumnData& data, size_t row) {
+    return data.kind == ValueKind::Null || data.is_null(row);
+}
+
+int64_t floor_div(int64_t value, int64_t divisor) {
+    int64_t q = value / divisor;
+    return (value % divisor != 0 && (value < 0) != (divisor < 0)) ? q - 1 : q;
+}
+
+// Секунды Unix для Date / DateTime
+int64_t unix_seconds(const ColumnData& data, size_t row, const ColumnInfo& info) {
+    switch (data.kind) {
+        case ValueKind::Timestamp:
+        case ValueKind::TimestampTz: return floor_div(data.ints[row], MICROS_PER_SECOND);
+        case ValueKind::Date:        return data.ints[row] * SECONDS_PER_DAY;
+        case ValueKind::Int64:       return data.ints[row];
+        default:                     type_mismatch(info, data.kind);
+    }
+}
+
+template <typename T>
+void append_integers(ColumnVector<T>& column, const ColumnData& data, size_t begin, size_t end,
+                     const ColumnInfo& info) {
+    auto& out = column.GetWritableData();
+    if constexpr (std::is_same_v<T, int64_t>) {
+        if (data.kind == ValueKind::Int64) {
+            out.insert(out.end(), data.ints.begin() + begin, data.ints.begin() + end);
+            return;
+        }
+    }
+    for (size_t i = begin; i < end; ++i) {
+        int64_t v = 0;
+        if (is_null_cell(data, i)) v = 0;
+        else if (data.kind == ValueKind::Int64) v = data.ints[i];
+        else if (data.kind == ValueKind::Bool) v = data.bools[i];
+        else type_mismatch(info, data.kind);
+
+        bool fits = std::is_signed_v<T>
+            ? v >= static_cast<int64_t>(std::numeric_limits<T>::min()) &&
+              v <= static_cast<int64_t>(std::numeric_limits<T>::max())
+            : v >= 0 && static_cast<uint64_t>(v) <= static_cast<uint64_t>(std::numeric_limits<T>::max());
+        if (!fits) {
+            throw std::runtime_error("Value " + std::to_string(v) + " is out of range for column '" +
+                                     info.name + "' of type " + info.type);
+        }
+        out.push_back(static_cast<T>(v));
+    }
+}
+
+template <typename T>
+void append_floats(ColumnVector<T>& column, const ColumnData& data, size_t begin, size_t end,
+                   const ColumnInfo& info) {
+    auto& out = column.GetWritableData();
+    if constexpr (std::is_same_v<T, double>) {
+        if (data.kind == ValueKind::Float64) {
+            out.insert(out.end(), data.doubles.begin() + begin, data.doubles.begin() + end);
+            return;
+        }
+    }
+    for (size_t i = begin; i < end; ++i) {
+        if (is_null_cell(data, i)) out.push_back(T{});
+        else if (data.kind == ValueKind::Float64) out.push_back(static_cast<T>(data.doubles[i]));
+        else if (data.kind == ValueKind::Int64) out.push_back(static_cast<T>(data.ints[i]));
+        else type_mismatch(info, data.kind);
+    }
+}
+
+template <typename Col>
+void append_strings(Col& column, const ColumnData& data, size_t begin, size_t end, const ColumnInfo& info) {
+    if (data.kind != ValueKind::String && data.kind != ValueKind::Null) type_mismatch(info, data.kind);
+    for (size_t i = begin; i < end; ++i) {
+        column.Append(is_null_cell(data, i) ? std::string_view() : data.string_at(i));
+    }
+}
+
+// Значения без NULL-обёрток; NULL-ячейки (для Nullable) получают значение по умолчанию
+void append_plain(const ColumnRef& target, const ColumnData& data, size_t begin, size_t end,
+                  const ColumnInfo& info) {
+    switch (target->Type()->GetCode()) {
+        case Type::Int8:    append_integers(*target->As<ColumnInt8>(), data, begin, end, info); break;
+        case Type::Int16:   append_integers(*target->As<ColumnInt16>(), data, begin, end, info); break;
+        case Type::Int32:   append_integers(*target->As<ColumnInt32>(), data, begin, end, info); break;
+        case Type::Int64:   append_integers(*target->As<ColumnInt64>(), data, begin, end, info); break;
+        case Type::UInt8:   append_integers(*target->As<ColumnUInt8>(), data, begin, end, info); break;
+        case Type::UInt16:  append_integers(*target->As<ColumnUInt16>(), data, begin, end, info); break;
+        case Type::UInt32:  append_integers(*target->As<ColumnUInt32>(), data, begin, end, info); break;
+        case Type::UInt64:  append_integers(*target->As<ColumnUInt64>(), data, begin, end, info); break;
+        case Type::Float32: append_floats(*target->As<ColumnFloat32>(), data, begin, end, info); break;
+        case Type::Float64: append_floats(*target->As<ColumnFloat64>(), data, begin, end, info); break;
+        case Type::String:  append_strings(*target->As<ColumnString>(), data, begin, end, info); break;
+        case Type::FixedString:
+            append_strings(*target->As<ColumnFixedString>(), data, begin, end, info);
+            break;
+        case Type::Date: {
+            auto column = target->As<ColumnDate>();
+            for (size_t i = begin; i < end; ++i) {
+                column->Append(is_null_cell(data, i) ? 0 : unix_seconds(data, i, info));
+            }
+            break;
+        }
+        case Type::Date32: {
+            auto column = target->As<ColumnDate32>();
+            for (size_t i = begin; i < end; ++i) {
+                column->Append(is_null_cell(data, i) ? 0 : unix_seconds(data, i, info));
+            }
+            break;
+        }
+        case Type::DateTime: {
+            auto column = target->As<ColumnDateTime>();
+            for (size_t i = begin; i < end; ++i) {
+                column->Append(is_null_cell(data, i) ? 0 : unix_seconds(data, i, info));
+            }
+            break;
+        }
+        case Type::DateTime64: {
+            // Значения времени хранятся в микросекундах — переводим в точность колонки
+            auto column = target->As<ColumnDateTime64>();
+            const size_t precision = column->GetPrecision();
+            int64_t scale = 1;
+            for (size_t p = std::min<size_t>(precision, 6); p < std::max<size_t>(precision, 6); ++p) scale *= 10;
+            for (size_t i = begin; i < end; ++i) {
+                int64_t ticks = 0;
+                if (is_null_cell(data, i)) ticks = 0;
+                else if (data.kind == ValueKind::Int64) ticks = data.ints[i];
+                else if (data.kind == ValueKind::Timestamp || data.kind == ValueKind::TimestampTz ||
+                         data.kind == ValueKind::Date) {
+                    int64_t micros = data.kind == ValueKind::Date
+                        ? data.ints[i] * SECONDS_PER_DAY * MICROS_PER_SECOND
+                        : data.ints[i];
+                    ticks = precision >= 6 ? micros * scale : floor_div(micros, scale);
+                } else {
+                    type_mismatch(info, data.kind);
+                }
+                column->Append(ticks);
+            }
+            break;
+        }
+        case Type::UUID: {
+            auto column = target->As<ColumnUUID>();
+            for (size_t i = begin; i < end; ++i) {
+                uint8_t bytes[16] = {};
+                if (!is_null_cell(data, i) &&
+                    (data.kind != ValueKind::String || !parse_uuid(data.string_at(i), bytes))) {
+                    type_mismatch(info, data.kind);
+                }
+                uint64_t high = 0, low = 0;
+                for (int k = 0; k < 8; ++k) {
+                    high = (high << 8) | bytes[k];
+                    low = (low << 8) | bytes[k + 8];
+                }
+                column->Append(UUID{high, low});
+            }
+            break;
+        }
+        case Type::Enum8:
+        case Type::Enum16: {
+            // Enum принимает имена значений; NULL-ячейки Nullable(Enum) получают код 0
+            if (data.kind != ValueKind::String && data.kind != ValueKind::Null) type_mismatch(info, data.kind);
+            auto enum8 = target->As<ColumnEnum8>();
+            auto enum16 = target->As<ColumnEnum16>();
+            for (size_t i = begin; i < end; ++i) {
+                if (is_null_cell(data, i)) {
+                    if (enum8) enum8->Append(int8_t{0});
+                    else enum16->Append(int16_t{0});
+                    continue;
+                }
+                std::string name(data.string_at(i));
+                if (enum8) enum8->Append(name);
+                else enum16->Append(name);
+            }
+            break;
+        }
+        default:
+            throw std::runtime_error("Insert into column '" + info.name + "' of type " + info.type +
+                                     " is not supported");
+    }
+}
+
+// Добавляет строки [begin, end) колонки пачки в колонку блока
+void append_values(const ColumnRef& target, const ColumnData& data, size_t begin, size_t end,
+                   const ColumnInfo& info, bool nullable) {
+    const Type::Code code = target->Type()->GetCode();
+
+    if (code == Type::Nullable) {
+        auto column = target->As<ColumnNullable>();
+        append_values(column->Nested(), data, begin, end, info, true);
+        auto nulls = column->Nulls()->As<ColumnUInt8>();
+        for (size_t i = begin; i < end; ++i) nulls->Append(is_null_cell(data, i) ? 1 : 0);
+        return;
+    }
+
+    if (code == Type::LowCardinality) {
+        // Словарь строит сама колонка: значения собираются в колонку вложенного типа
+        std::string type = target->Type()->GetName();
+        std::string nested_type = type.substr(type.find('(') + 1, type.size() - type.find('(') - 2);
+        ColumnRef plain = CreateColumnByType(nested_type);
+        append_values(plain, data, begin, end, info, nullable);
+        const size_t before = target->Size();
+        target->Append(plain);
+        if (target->Size() != before + plain->Size()) {
+            throw std::runtime_error("Insert into column '" + info.name + "' of type " + info.type +
+                                     " is not supported");
+        }
+        return;
+    }
+
+    if (!nullable && data.kind != ValueKind::Null && data.null_count > 0) {
+        for (size_t i = begin; i < end; ++i) {
+            if (data.is_null(i)) {
+                throw std::runtime_error("NULL value for non-Nullable column '" + info.name + "'");
+            }
+        }
+    }
+    if (!nullable && data.kind == ValueKind::Null && end > begin) {
+        throw std::runtime_error("NULL value for non-Nullable column '" + info.name + "'");
+    }
+    append_plain(target, data, begin, end, info);
+}
+
+// Оценка объёма строк [begin, end) для выбора размера блока
+size_t estimate_bytes(const ColumnData& data, size_t begin, size_t end) {
+    if (data.kind == ValueKind::String) {
+        return data.string_bytes(begin, end) + (end - begin) * 8;
+    }
+    return (end - begin) * 8;
+}
+
+std::string quote_identifier(const std::string& name) {
+    std::string out = "`";
+    for (char c : name) {
+        if (c == '`' || c == '\\') out.push_back('\\');
+        out.push_back(c);
+    }
+    out.push_back('`');
+    return out;
+}
+
+} // namespace
+
+// -------------------------
+// Вставка
+// -------------------------
+
+std::unique_ptr<ClickHouseInserter> ClickHouseConnector::inserter(const std::string& table,
+                                                                  const std::vector<std::string>& columns,
+                                                                  ClickHouseInsertOptions options) {
+    ensure_idle();
+
+    std::string column_list;
+    for (const std::string& column : columns) {
+        if (!column_list.empty()) column_list += ", ";
+        column_list += quote_identifier(column);
+    }
+
+    // Типы колонок берутся из заголовка пустого результата
+    std::vector<ColumnInfo> info;
+    std::vector<ColumnRef> templates;
+    try {
+        client_->Select("SELECT " + (column_list.empty() ? std::string("*") : column_list) +
+                        " FROM " + table + " LIMIT 0", [&](const Block& block) {
+            if (!templates.empty()) return;
+            for (size_t i = 0; i < block.GetColumnCount(); ++i) {
+                info.push_back({block.GetColumnName(i), block[i]->Type()->GetName()});
+                templates.push_back(block[i]->CloneEmpty());
+            }
+        });
+    } catch (const std::exception& e) {
+        throw std::runtime_error("ClickHouse insert failed: " + std::string(e.what()));
+    }
+    if (templates.empty()) throw std::runtime_error("ClickHouse insert failed: no columns in " + table);
+
+    std::unique_ptr<ClickHouseInserter> result(
+        new ClickHouseInserter(this, table, std::move(info), std::move(templates), options));
+    active_inserter_ = result.get();
+    return result;
+}
+
+uint64_t ClickHouseConnector::insert(const std::string& table, const std::vector<std::string>& columns,
+                                     const QueryResult& rows, ClickHouseInsertOptions options) {
+    options.background = false;
+    auto block_writer = inserter(table, columns, options);
+    block_writer->write(rows);
+    return block_writer->close();
+}
+
+ClickHouseInserter::ClickHouseInserter(ClickHouseConnector* connector, std::string table,
+                                       std::vector<ColumnInfo> columns, std::vector<ColumnRef> templates,
+                                       ClickHouseInsertOptions options)
+    : connector_(connector),
+      table_(std::move(table)),
+      columns_(std::move(columns)),
+      templates_(std::move(templates)),
+      current_rows_(0),
+      current_bytes_(0),
+      options_(options),
+      rows_sent_(0),
+      finished_(false),
+      sending_(false),
+      stopping_(false) {
+    if (options_.block_rows == 0) options_.block_rows = 1;
+    if (options_.queue_depth == 0) options_.queue_depth = 1;
+    for (const ColumnRef& column : templates_) current_.push_back(column->CloneEmpty());
+    if (options_.background) worker_ = std::thread([this] { send_loop(); });
+}
+
+ClickHouseInserter::~ClickHouseInserter() {
+    abort();
+}
+
+bool ClickHouseInserter::is_open() const {
+    return !finished_;
+}
+
+const std::vector<ColumnInfo>& ClickHouseInserter::columns() const {
+    return columns_;
+}
+
+void ClickHouseInserter::write(const QueryResult& rows) {
+    if (finished_) throw std::runtime_error("Insert is already closed");
+    if (rows.data.size() != columns_.size()) {
+        throw std::runtime_error("Insert expects " + std::to_string(columns_.size()) + " columns, got " +
+                                 std::to_string(rows.data.size()));
+    }
+    check_error();
+
+    const size_t num_rows = rows.row_count();
+    size_t row_bytes = 0;
+    for (const ColumnData& data : rows.data) row_bytes += num_rows ? estimate_bytes(data, 0, num_rows) : 0;
+    row_bytes = num_rows ? std::max<size_t>(row_bytes / num_rows, 1) : 1;
+
+    // Пачка режется по границам блоков: блок закрывается по числу строк или объёму
+    size_t begin = 0;
+    while (begin < num_rows) {
+        size_t room = options_.block_rows - current_rows_;
+        if (options_.block_bytes > 0) {
+            size_t bytes_room = options_.block_bytes > current_bytes_
+                ? (options_.block_bytes - current_bytes_) / row_bytes : 0;
+            room = std::min(room, std::max<size_t>(bytes_room, 1));
+        }
+        const size_t end = std::min(num_rows, begin + room);
+
+        try {
+            for (size_t j = 0; j < columns_.size(); ++j) {
+                append_values(current_[j], rows.data[j], begin, end, columns_[j], false);
+            }
+        } catch (...) {
+            // Колонки, успевшие принять часть строк, обрезаются до прежней длины:
+            // ранее записанные строки остаются в блоке. Обрезаются все колонки: у Nullable
+            // Size() — длина маски NULL, а вложенная колонка могла уже получить строки
+            for (size_t j = 0; j < current_.size(); ++j) {
+                current_[j] = current_[j]->Slice(0, current_rows_);
+            }
+            throw;
+        }
+        current_rows_ += end - begin;
+        current_bytes_ += (end - begin) * row_bytes;
+        begin = end;
+
+        if (current_rows_ >= options_.block_rows ||
+            (options_.block_bytes > 0 && current_bytes_ >= options_.block_bytes)) {
+            seal_block();
+        }
+    }
+}
+
+// Текущий блок уходит на отправку: сразу или в очередь фонового потока
+void ClickHouseInserter::seal_block() {
+    if (current_rows_ == 0) return;
+
+    auto block = std::make_unique<Block>();
+    for (size_t j = 0; j < columns_.size(); ++j) {
+        block->AppendColumn(columns_[j].name, current_[j]);
+        current_[j] = templates_[j]->CloneEmpty();
+    }
+    const size_t rows = current_rows_;
+    current_rows_ = 0;
+    current_bytes_ = 0;
+
+    if (!options_.background) {
+        send_block(*block);
+        rows_sent_ += rows;
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    space_.wait(lock, [this] { return error_ || queue_.size() < options_.queue_depth; });
+    if (error_) {
+        lock.unlock();
+        check_error();
+    }
+    queue_.push_back(std::move(block));
+    ready_.notify_all();
+}
+
+void ClickHouseInserter::send_block(const Block& block) {
+    try {
+        connector_->client_->Insert(table_, block);
+    } catch (const std::exception& e) {
+        throw std::runtime_error("ClickHouse insert failed: " + std::string(e.what()));
+    }
+}
+
+// Фоновый поток: отправляет блоки по очереди; после ошибки остальные блоки отбрасываются
+void ClickHouseInserter::send_loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        ready_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+        if (queue_.empty()) return;
+
+        std::unique_ptr<Block> block = std::move(queue_.front());
+        queue_.pop_front();
+        sending_ = true;
+        lock.unlock();
+
+        std::exception_ptr error;
+        try {
+            send_block(*block);
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        lock.lock();
+        sending_ = false;
+        if (error) {
+            error_ = error;
+            queue_.clear();
+        } else {
+            rows_sent_ += block->GetRowCount();
+        }
+        space_.notify_all();
+    }
+}
+
+void ClickHouseInserter::check_error() {
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        error = std::exchange(error_, nullptr);
+    }
+    if (!error) return;
+    abort();
+    std::rethrow_exception(error);
+}
+
+void ClickHouseInserter::flush() {
+    if (finished_) throw std::runtime_error("Insert is already closed");
+    seal_block();
+    if (options_.background) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        space_.wait(lock, [this] { return error_ || (queue_.empty() && !sending_); });
+    }
+    check_error();
+}
+
+uint64_t ClickHouseInserter::close() {
+    if (finished_) return rows_sent_;
+    flush();
+    finish();
+    return rows_sent_;
+}
+
+void ClickHouseInserter::abort() {
+    if (finished_) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.clear();
+    }
+    for (size_t j = 0; j < current_.size(); ++j) current_[j] = templates_[j]->CloneEmpty();
+    current_rows_ = 0;
+    current_bytes_ = 0;
+    finish();
+}
+
+// Останавливает фоновый поток (блок, уже отправляемый им, дописывается) и освобождает соединение
+void ClickHouseInserter::finish() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    ready_.notify_all();
+    if (worker_.joinable()) worker_.join();
+    finished_ = true;
+    if (connector_->active_inserter_ == this) {
+        connector_->active_inserter_ = nullptr;
+    }
+}
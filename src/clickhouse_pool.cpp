@@ -0,0 +1,233 @@
+#include "clickhouse_pool.h"
+#include <future>
+#include <stdexcept>
+#include <utility>
+
+// -------------------------
+// Аренда
+// -------------------------
+
+ClickHousePool::Lease::Lease(ClickHousePool* pool, std::unique_ptr<ClickHouseConnector> connection)
+    : pool_(pool), connection_(std::move(connection)) {}
+
+ClickHousePool::Lease::Lease(Lease&& other) noexcept
+    : pool_(std::exchange(other.pool_, nullptr)),
+      connection_(std::move(other.connection_)) {}
+
+ClickHousePool::Lease& ClickHousePool::Lease::operator=(Lease&& other) noexcept {
+    if (this != &other) {
+        release();
+        pool_ = std::exchange(other.pool_, nullptr);
+        connection_ = std::move(other.connection_);
+    }
+    return *this;
+}
+
+ClickHousePool::Lease::~Lease() {
+    release();
+}
+
+ClickHouseConnector& ClickHousePool::Lease::operator*() const {
+    return *get();
+}
+
+ClickHouseConnector* ClickHousePool::Lease::operator->() const {
+    return get();
+}
+
+ClickHouseConnector* ClickHousePool::Lease::get() const {
+    if (!connection_) throw std::runtime_error("Connection lease has been released");
+    return connection_.get();
+}
+
+ClickHousePool::Lease::operator bool() const {
+    return connection_ != nullptr;
+}
+
+void ClickHousePool::Lease::release() {
+    if (connection_ && pool_) {
+        pool_->give_back(std::move(connection_));
+    }
+    connection_.reset();
+    pool_ = nullptr;
+}
+
+// -------------------------
+// Пул
+// -------------------------
+
+ClickHousePool::ClickHousePool(ClickHouseEndpoint endpoint, ClickHousePoolOptions options)
+    : endpoint_(std::move(endpoint)),
+      options_(options),
+      open_(0),
+      leased_(0),
+      closed_(false) {
+    if (options_.size == 0) throw std::invalid_argument("Pool size must be positive");
+
+    idle_.reserve(options_.size);
+    auto now = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < options_.size; ++i) {
+        idle_.push_back({open_connection(), now});
+        ++open_;
+    }
+}
+
+ClickHousePool::~ClickHousePool() {
+    workers_.reset();   // задачи execute_many держат аренды — дожидаемся их
+    close();
+}
+
+std::unique_ptr<ClickHouseConnector> ClickHousePool::open_connection() const {
+    auto connection = std::make_unique<ClickHouseConnector>();
+    if (!connection->connect(endpoint_.host, endpoint_.port, endpoint_.database,
+                             endpoint_.user, endpoint_.password)) {
+        throw std::runtime_error("Failed to open pooled ClickHouse connection");
+    }
+    connection->set_result_cache(options_.result_cache, options_.result_cache_ttl);
+    return connection;
+}
+
+// Забирает из пула соединения, простоявшие дольше idle_timeout; вызывается под блокировкой
+std::vector<ClickHousePool::IdleConnection>
+ClickHousePool::take_expired(std::chrono::steady_clock::time_point now) {
+    std::vector<IdleConnection> expired;
+    auto fresh = idle_.begin();
+    while (fresh != idle_.end() && now - fresh->since >= options_.idle_timeout) ++fresh;
+
+    expired.insert(expired.end(), std::make_move_iterator(idle_.begin()), std::make_move_iterator(fresh));
+    idle_.erase(idle_.begin(), fresh);
+    open_ -= expired.size();
+    return expired;
+}
+
+ClickHousePool::Lease ClickHousePool::acquire() {
+    return acquire(options_.acquire_timeout);
+}
+
+ClickHousePool::Lease ClickHousePool::acquire(std::chrono::milliseconds timeout) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (true) {
+        if (closed_) throw std::runtime_error("Pool is closed");
+
+        auto now = std::chrono::steady_clock::now();
+        std::vector<IdleConnection> expired = take_expired(now);
+        if (!expired.empty()) {
+            // Закрытие соединений — вне блокировки; освободившиеся места видны ожидающим
+            lock.unlock();
+            expired.clear();
+            available_.notify_all();
+            lock.lock();
+            continue;
+        }
+
+        if (!idle_.empty()) {
+            IdleConnection entry = std::move(idle_.back());
+            idle_.pop_back();
+            ++leased_;
+            lock.unlock();
+
+            bool stale = now - entry.since >= options_.health_check_after;
+            if (!stale || entry.connection->ping()) {
+                return Lease(this, std::move(entry.connection));
+            }
+
+            entry.connection.reset();
+            lock.lock();
+            --leased_;
+            --open_;
+            continue;
+        }
+
+        if (open_ < options_.size) {
+            ++open_;
+            ++leased_;
+            lock.unlock();
+            try {
+                return Lease(this, open_connection());
+            } catch (...) {
+                lock.lock();
+                --open_;
+                --leased_;
+                available_.notify_one();
+                throw;
+            }
+        }
+
+        bool ready = available_.wait_until(lock, deadline, [this] {
+            return closed_ || !idle_.empty() || open_ < options_.size;
+        });
+        if (!ready) throw std::runtime_error("Timed out waiting for a pooled ClickHouse connection");
+    }
+}
+
+void ClickHousePool::give_back(std::unique_ptr<ClickHouseConnector> connection) {
+    bool reusable = connection->reset_session();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    --leased_;
+    if (reusable && !closed_) {
+        idle_.push_back({std::move(connection), std::chrono::steady_clock::now()});
+    } else {
+        --open_;
+    }
+    lock.unlock();
+    available_.notify_one();
+}
+
+QueryResult ClickHousePool::execute(const std::string& query) {
+    Lease lease = acquire();
+    return lease->execute(query);
+}
+
+std::vector<QueryResult> ClickHousePool::execute_many(const std::vector<std::string>& queries) {
+    std::call_once(workers_once_, [this] { workers_ = std::make_unique<ThreadPool>(options_.size); });
+
+    std::vector<std::future<QueryResult>> pending;
+    pending.reserve(queries.size());
+    for (const std::string& query : queries) {
+        pending.push_back(workers_->submit([this, &query] { return execute(query); }));
+    }
+
+    // Дожидаемся всех запросов, даже если какой-то завершился ошибкой:
+    // задачи ссылаются на queries
+    std::vector<QueryResult> results;
+    results.reserve(queries.size());
+    std::exception_ptr error;
+    for (auto& future : pending) {
+        try {
+            results.push_back(future.get());
+        } catch (...) {
+            if (!error) error = std::current_exception();
+            results.emplace_back();
+        }
+    }
+    if (error) std::rethrow_exception(error);
+    return results;
+}
+
+void ClickHousePool::close() {
+    std::vector<IdleConnection> idle;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        open_ -= idle_.size();
+        idle.swap(idle_);
+    }
+    available_.notify_all();
+}
+
+size_t ClickHousePool::size() const {
+    return options_.size;
+}
+
+size_t ClickHousePool::idle() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return idle_.size();
+}
+
+size_t ClickHousePool::in_use() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return leased_;
+}
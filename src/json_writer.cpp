@@ -0,0 +1,178 @@
+#include "json_writer.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <future>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+JsonFormat parse_json_format(const std::string& name) {
+    if (name == "json") return JsonFormat::Document;
+    if (name == "ndjson" || name == "jsonl") return JsonFormat::Ndjson;
+    throw std::invalid_argument("Unknown JSON format: " + name + " (expected json or ndjson)");
+}
+
+// -------------------------
+// Потоковая запись
+// -------------------------
+
+JsonWriter::JsonWriter(OutputSink& out, JsonFormat format, size_t buffer_size)
+    : out_(out),
+      format_(format),
+      buffer_size_(std::max<size_t>(buffer_size, 1)),
+      buffer_(std::min<size_t>(buffer_size, DEFAULT_BUFFER_SIZE) + 256),
+      started_(false),
+      finished_(false),
+      rows_(0) {}
+
+void JsonWriter::write_rows(const QueryResult& rows, size_t begin, size_t end) {
+    if (finished_) throw std::runtime_error("JSON document is already finished");
+
+    const size_t num_cols = std::min(rows.columns.size(), rows.data.size());
+    if (!started_) {
+        keys_ = json_row_keys(rows.columns, num_cols);
+        if (format_ == JsonFormat::Document) buffer_.append_literal("{\"rows\":[");
+        started_ = true;
+    } else if (keys_.size() != num_cols) {
+        throw std::runtime_error("JSON batches must have the same columns");
+    }
+
+    end = std::min(end, rows.row_count());
+    for (size_t i = begin; i < end; ++i) {
+        if (format_ == JsonFormat::Document && rows_ > 0) buffer_.push_back(',');
+        append_json_row(buffer_, rows.data, keys_, i);
+        if (format_ == JsonFormat::Ndjson) buffer_.push_back('\n');
+        ++rows_;
+        if (buffer_.str().size() >= buffer_size_) flush_buffer();
+    }
+}
+
+void JsonWriter::finish(const std::vector<ColumnInfo>& columns, size_t count) {
+    if (finished_) return;
+    if (format_ == JsonFormat::Document) {
+        if (!started_) buffer_.append_literal("{\"rows\":[");
+        buffer_.append_literal("],\"columns\":");
+        append_json_columns(buffer_, columns);
+        buffer_.append_literal(",\"count\":");
+        buffer_.append_number(count);
+        buffer_.push_back('}');
+    }
+    started_ = true;
+    finished_ = true;
+    flush_buffer();
+    out_.flush();
+}
+
+void JsonWriter::write(const QueryResult& result) {
+    write_rows(result);
+    finish(result.columns, result.count);
+}
+
+size_t JsonWriter::rows_written() const {
+    return rows_;
+}
+
+bool JsonWriter::finished() const {
+    return finished_;
+}
+
+void JsonWriter::flush_buffer() {
+    std::string& text = buffer_.str();
+    if (text.empty()) return;
+    out_.write(text.data(), text.size());
+    text.clear();
+}
+
+// -------------------------
+// Чтение по кускам
+// -------------------------
+
+JsonChunkReader::JsonChunkReader(std::vector<ColumnInfo> columns, BatchSource source, JsonFormat format,
+                                 size_t chunk_size)
+    : columns_(std::move(columns)),
+      source_(std::move(source)),
+      sink_(chunk_size),
+      writer_(sink_, format, chunk_size) {}
+
+bool JsonChunkReader::next_chunk(std::string& chunk) {
+    while (!sink_.has_chunk() && !writer_.finished()) {
+        if (source_(batch_)) {
+            writer_.write_rows(batch_);
+        } else {
+            writer_.finish(columns_, writer_.rows_written());
+        }
+    }
+    return sink_.take(chunk);
+}
+
+// -------------------------
+// Параллельная сериализация
+// -------------------------
+
+ThreadPool& json_thread_pool() {
+    static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    return pool;
+}
+
+std::string to_json_parallel(const QueryResult& result, const JsonParallelOptions& options) {
+    const size_t num_rows = result.row_count();
+    if (num_rows < options.min_rows) return result.to_json();   // общий пул не создаём зря
+    return to_json_parallel(result, json_thread_pool(), options);
+}
+
+std::string to_json_parallel(const QueryResult& result, ThreadPool& pool, const JsonParallelOptions& options) {
+    const size_t num_rows = result.row_count();
+    const size_t chunk_rows = std::max<size_t>(options.chunk_rows, 1);
+    const size_t num_chunks = (num_rows + chunk_rows - 1) / chunk_rows;
+    if (num_rows < options.min_rows || num_chunks < 2 || pool.size() < 2) return result.to_json();
+
+    const size_t num_cols = std::min(result.columns.size(), result.data.size());
+    const std::vector<std::string> keys = json_row_keys(result.columns, num_cols);
+    std::vector<std::string> chunks(num_chunks);
+
+    // Куски разбираются по счётчику, поэтому вызывающий поток не простаивает,
+    // а занятый пул не задерживает сериализацию
+    std::atomic<size_t> next{0};
+    auto work = [&] {
+        for (size_t k = next++; k < num_chunks; k = next++) {
+            const size_t begin = k * chunk_rows;
+            const size_t end = std::min(begin + chunk_rows, num_rows);
+            FastStringBuilder b(result.json_size_estimate(begin, end));
+            append_json_rows(b, result.data, keys, begin, end);
+            chunks[k] = std::move(b.str());
+        }
+    };
+
+    std::vector<std::future<void>> helpers;
+    const size_t num_helpers = std::min(pool.size(), num_chunks) - 1;
+    helpers.reserve(num_helpers);
+    std::exception_ptr error;
+    try {
+        for (size_t t = 0; t < num_helpers; ++t) helpers.push_back(pool.submit(work));
+        work();
+    } catch (...) {
+        error = std::current_exception();
+        next = num_chunks;
+    }
+    // Задачи ссылаются на локальные переменные: дожидаемся всех
+    for (auto& helper : helpers) {
+        try {
+            helper.get();
+        } catch (...) {
+            if (!error) error = std::current_exception();
+        }
+    }
+    if (error) std::rethrow_exception(error);
+
+    size_t total = 128;
+    for (const std::string& chunk : chunks) total += chunk.size() + 1;
+    FastStringBuilder b(total);
+    b.append_literal("{\"rows\":[");
+    for (size_t k = 0; k < num_chunks; ++k) {
+        if (k > 0) b.push_back(',');
+        b.append(chunks[k]);
+    }
+    result.append_json_tail(b);
+    return std::move(b.str());
+}
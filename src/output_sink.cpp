@@ -0,0 +1,146 @@
+#include "output_sink.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+
+ExportFormat parse_export_format(const std::string& name) {
+    if (name == "csv") return ExportFormat::Csv;
+    if (name == "tsv" || name == "text") return ExportFormat::Tsv;
+    if (name == "binary" || name == "native") return ExportFormat::Binary;
+    throw std::invalid_argument("Unknown export format: " + name + " (expected csv, tsv or binary)");
+}
+
+// -------------------------
+// Запись в файловый дескриптор
+// -------------------------
+
+FdSink::FdSink(int fd, size_t buffer_size) : FdSink(fd, buffer_size, false) {}
+
+FdSink::FdSink(int fd, size_t buffer_size, bool owns_fd)
+    : fd_(fd),
+      owns_fd_(owns_fd),
+      buffer_(std::max<size_t>(buffer_size, 1)),
+      used_(0),
+      written_(0) {
+    if (fd_ < 0) throw std::invalid_argument("Invalid file descriptor");
+}
+
+std::unique_ptr<FdSink> FdSink::open(const std::string& path, size_t buffer_size) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open " + path + ": " + std::strerror(errno));
+    }
+    return std::unique_ptr<FdSink>(new FdSink(fd, buffer_size, true));
+}
+
+FdSink::~FdSink() {
+    try {
+        close();
+    } catch (...) {}
+}
+
+void FdSink::write(const char* data, size_t size) {
+    if (fd_ < 0) throw std::runtime_error("Output is closed");
+
+    if (used_ + size <= buffer_.size()) {
+        std::memcpy(buffer_.data() + used_, data, size);
+        used_ += size;
+        return;
+    }
+    flush();
+    if (size >= buffer_.size()) {
+        write_all(data, size);
+    } else {
+        std::memcpy(buffer_.data(), data, size);
+        used_ = size;
+    }
+}
+
+void FdSink::flush() {
+    if (used_ == 0) return;
+    size_t pending = std::exchange(used_, 0);
+    write_all(buffer_.data(), pending);
+}
+
+void FdSink::close() {
+    if (fd_ < 0) return;
+    try {
+        flush();
+    } catch (...) {
+        if (owns_fd_) ::close(fd_);
+        fd_ = -1;
+        throw;
+    }
+    int fd = std::exchange(fd_, -1);
+    if (owns_fd_ && ::close(fd) != 0) {
+        throw std::runtime_error("Close failed: " + std::string(std::strerror(errno)));
+    }
+}
+
+uint64_t FdSink::bytes_written() const {
+    return written_ + used_;
+}
+
+void FdSink::write_all(const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::write(fd_, data, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("Write failed: " + std::string(std::strerror(errno)));
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+        written_ += static_cast<uint64_t>(n);
+    }
+}
+
+// -------------------------
+// Функция и куски фиксированного размера
+// -------------------------
+
+CallbackSink::CallbackSink(Callback callback) : callback_(std::move(callback)) {
+    if (!callback_) throw std::invalid_argument("Sink callback is empty");
+}
+
+void CallbackSink::write(const char* data, size_t size) {
+    if (size > 0) callback_(data, size);
+}
+
+ChunkSink::ChunkSink(size_t chunk_size) : chunk_size_(std::max<size_t>(chunk_size, 1)) {
+    current_.reserve(chunk_size_);
+}
+
+void ChunkSink::write(const char* data, size_t size) {
+    while (size > 0) {
+        size_t take = std::min(size, chunk_size_ - current_.size());
+        current_.append(data, take);
+        data += take;
+        size -= take;
+        if (current_.size() == chunk_size_) {
+            ready_.push_back(std::move(current_));
+            current_ = std::string();
+            current_.reserve(chunk_size_);
+        }
+    }
+}
+
+void ChunkSink::flush() {
+    if (current_.empty()) return;
+    ready_.push_back(std::move(current_));
+    current_ = std::string();
+}
+
+bool ChunkSink::has_chunk() const {
+    return !ready_.empty();
+}
+
+bool ChunkSink::take(std::string& chunk) {
+    if (ready_.empty()) return false;
+    chunk = std::move(ready_.front());
+    ready_.pop_front();
+    return true;
+}
@@ -1,13 +1,57 @@
 #include "postgres_connector.h"
+#include "arrow_export.h"
 #include <iostream>
 #include <string>
 #include <regex>
 #include <stdexcept>
 #include <unordered_map>
+#include <memory>
+#include <limits>
+#include <charconv>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+#include <cstdlib>
+#include <cerrno>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <cmath>
+
+// Дополнительный запрос для count в режимах Separate / Estimate
+struct CountRequest {
+    std::string sql;
+    CountMode mode;
+    size_t seen;        // строк до конца полученной страницы
+};
+
+// Состояние неблокирующего запроса (send_async / poll_async)
+struct PgAsyncQuery {
+    std::string query;
+    std::optional<QueryParams> params;       // нужны и для дополнительного запроса count
+    CountMode mode = CountMode::Exact;
+    // Строки разбираются в take_async_result: пока запрос идёт, соединение занято
+    // и неизвестные типы колонок нельзя дочитать из pg_type
+    std::unique_ptr<PGresult, decltype(&PQclear)> rows{nullptr, &PQclear};
+    QueryResult result;                       // результат команды без строк
+    std::optional<size_t> total;              // число строк, найденное режимами Separate / Estimate
+    std::optional<CountRequest> count;
+    bool counting = false;                    // выполняется запрос count
+    bool done = false;
+    std::string error;
+};
 
 PostgresConnector::PostgresConnector() {
     connection_ = nullptr;
     in_transaction_ = false;
+    binary_results_ = false;
+    intern_strings_ = false;
+    preload_types_ = false;
+    result_cache_ttl_ = std::chrono::milliseconds(0);
+    count_mode_ = CountMode::Exact;
+    statement_cache_size_ = 64;
+    statement_counter_ = 0;
+    active_stream_ = nullptr;
+    active_copy_ = nullptr;
 }
 
 PostgresConnector::~PostgresConnector() {
@@ -18,12 +62,31 @@ PostgresConnector::~PostgresConnector() {
 }
 
 bool PostgresConnector::connect(const std::string& conninfo) {
+    // Повторное подключение (например, из пула) закрывает прежнее соединение
+    disconnect();
     connection_ = PQconnectdb(conninfo.c_str());
     in_transaction_ = false;
-    return PQstatus(connection_) == CONNECTION_OK;
+    // Подготовленные операторы живут в сессии — на новом соединении их нет;
+    // OID пользовательских типов в другой базе другие
+    statement_lru_.clear();
+    statement_index_.clear();
+    type_cache_.clear();
+    if (PQstatus(connection_) != CONNECTION_OK) return false;
+    cache_target_ = std::string("postgresql://") + PQuser(connection_) + "@" + PQhost(connection_) + ":" +
+                    PQport(connection_) + "/" + PQdb(connection_);
+    if (preload_types_) load_types("");
+    return true;
 }
 
 void PostgresConnector::disconnect() {
+    if (active_stream_) {
+        active_stream_->close();
+    }
+    if (active_copy_) {
+        active_copy_->abort();
+    }
+    cancel_async();
+
     if (connection_ != nullptr) {
         if (in_transaction_) {
             rollback_transaction();
@@ -31,6 +94,8 @@ void PostgresConnector::disconnect() {
         PQfinish(connection_);
         connection_ = nullptr;
         in_transaction_ = false;
+        statement_lru_.clear();
+        statement_index_.clear();
     }
 }
 
@@ -38,15 +103,92 @@ bool PostgresConnector::is_connected() const {
     return connection_ != nullptr && PQstatus(connection_) == CONNECTION_OK;
 }
 
+bool PostgresConnector::ping() {
+    if (!is_connected() || busy()) return false;
+    PGresult* res = PQexec(connection_, "");
+    bool alive = PQresultStatus(res) == PGRES_EMPTY_QUERY;
+    PQclear(res);
+    return alive;
+}
+
+bool PostgresConnector::reset_session() {
+    if (active_stream_) {
+        active_stream_->close();
+    }
+    if (active_copy_) {
+        active_copy_->abort();
+    }
+    cancel_async();
+    if (!is_connected()) return false;
+
+    // Транзакция могла быть открыта и обычным execute("BEGIN") — смотрим статус сервера
+    switch (PQtransactionStatus(connection_)) {
+        case PQTRANS_IDLE:
+            break;
+        case PQTRANS_INTRANS:
+        case PQTRANS_INERROR:
+            if (!execute_simple_query("ROLLBACK")) return false;
+            break;
+        default:
+            return false;
+    }
+    in_transaction_ = false;
+    return true;
+}
+
 bool PostgresConnector::is_in_transaction() const {
     return in_transaction_;
 }
 
+void PostgresConnector::set_binary_results(bool enabled) {
+    binary_results_ = enabled;
+}
+
+bool PostgresConnector::binary_results() const {
+    return binary_results_;
+}
+
+void PostgresConnector::set_intern_strings(bool enabled) {
+    intern_strings_ = enabled;
+}
+
+bool PostgresConnector::intern_strings() const {
+    return intern_strings_;
+}
+
+void PostgresConnector::ensure_idle() const {
+    if (!is_connected()) {
+        throw std::runtime_error("Not connected to PostgreSQL");
+    }
+    if (active_stream_) {
+        throw std::runtime_error("Connection is busy with an open stream");
+    }
+    if (async_) {
+        throw std::runtime_error("Connection is busy with an async query");
+    }
+    if (active_copy_) {
+        throw std::runtime_error("Connection is busy with an open COPY");
+    }
+}
+
+bool PostgresConnector::busy() const {
+    return active_stream_ != nullptr || async_ != nullptr || active_copy_ != nullptr;
+}
+
+std::mutex& PostgresConnector::call_mutex() const {
+    return call_mutex_;
+}
+
 bool PostgresConnector::execute_simple_query(const std::string& query) {
     if (!is_connected()) {
         return false;
     }
 
+    if (busy()) {
+        std::cerr << "Query failed: connection is busy" << std::endl;
+        return false;
+    }
+
     PGresult* res = PQexec(connection_, query.c_str());
     bool success = (PQresultStatus(res) == PGRES_COMMAND_OK || 
                     PQresultStatus(res) == PGRES_TUPLES_OK);
@@ -86,8 +228,8 @@ int64_t PostgresConnector::get_current_transaction_id() {
     
     try {
         QueryResult result = execute("SELECT txid_current()");
-        if (!result.rows.empty() && !result.rows[0].empty()) {
-            const Value& txid_value = result.rows[0][0];
+        if (result.row_count() > 0 && !result.data.empty()) {
+            const Value txid_value = result.value_at(0, 0);
             
             if (std::holds_alternative<int64_t>(txid_value)) {
                 return std::get<int64_t>(txid_value);
@@ -189,7 +331,752 @@ bool PostgresConnector::execute_batch(const std::vector<std::string>& queries) {
     }
 }
 
-std::string PostgresConnector::oid_to_type_name(Oid type_oid) const {
+// Итог оператора пакета по результату libpq
+static BatchStatementResult batch_statement_result(PGresult* res) {
+    BatchStatementResult out;
+    ExecStatusType status = res ? PQresultStatus(res) : PGRES_FATAL_ERROR;
+    if (status == PGRES_COMMAND_OK || status == PGRES_TUPLES_OK) {
+        out.status = BatchStatus::Ok;
+        out.affected_rows = std::strtoull(PQcmdTuples(res), nullptr, 10);
+#ifdef LIBPQ_HAS_PIPELINING
+    } else if (status == PGRES_PIPELINE_ABORTED) {
+        out.status = BatchStatus::Skipped;
+#endif
+    } else {
+        out.status = BatchStatus::Failed;
+        out.error = res ? PQresultErrorMessage(res) : "No result for batch statement";
+    }
+    return out;
+}
+
+BatchResult PostgresConnector::execute_pipeline(const std::vector<std::string>& queries) {
+    ensure_idle();
+
+    BatchResult batch;
+    batch.statements.resize(queries.size());
+    if (queries.empty()) {
+        batch.success = true;
+        return batch;
+    }
+
+    const bool own_transaction = !in_transaction_;
+    run_pipeline(queries, own_transaction, batch);
+
+    bool failed = !batch.error.empty() ||
+        std::any_of(batch.statements.begin(), batch.statements.end(),
+                    [](const BatchStatementResult& s) { return s.status != BatchStatus::Ok; });
+    if (failed) {
+        // Транзакция после ошибки в состоянии aborted — откатываем, как execute_batch
+        if (is_connected() && PQtransactionStatus(connection_) != PQTRANS_IDLE) {
+            execute_simple_query("ROLLBACK");
+        }
+        in_transaction_ = false;
+        return batch;
+    }
+
+    if (own_transaction) in_transaction_ = false;   // COMMIT был последним в конвейере
+    batch.success = true;
+    return batch;
+}
+
+#ifdef LIBPQ_HAS_PIPELINING
+
+// Дописывает буфер libpq в сокет. Пока сервер отвечает на уже полученные операторы,
+// ответы вычитываются: иначе при длинном пакете обе стороны ждали бы записи
+static bool flush_pipeline(PGconn* conn) {
+    while (true) {
+        int pending = PQflush(conn);
+        if (pending <= 0) return pending == 0;
+
+        pollfd fd{PQsocket(conn), POLLIN | POLLOUT, 0};
+        if (poll(&fd, 1, -1) < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if ((fd.revents & POLLIN) && !PQconsumeInput(conn)) return false;
+    }
+}
+
+void PostgresConnector::run_pipeline(const std::vector<std::string>& queries, bool own_transaction,
+                                     BatchResult& batch) {
+    // Последовательность конвейера: [BEGIN] операторы [COMMIT] Sync
+    std::vector<const std::string*> sent;
+    static const std::string begin = "BEGIN";
+    static const std::string commit = "COMMIT";
+    if (own_transaction) sent.push_back(&begin);
+    for (const std::string& query : queries) sent.push_back(&query);
+    if (own_transaction) sent.push_back(&commit);
+
+    if (!PQenterPipelineMode(connection_)) {
+        batch.error = PQerrorMessage(connection_);
+        return;
+    }
+    PQsetnonblocking(connection_, 1);
+
+    size_t queued = 0;
+    for (const std::string* query : sent) {
+        if (!PQsendQueryParams(connection_, query->c_str(), 0, nullptr, nullptr, nullptr, nullptr, 0)) break;
+        ++queued;
+    }
+    bool sent_all = queued == sent.size() && PQpipelineSync(connection_) && flush_pipeline(connection_);
+    PQsetnonblocking(connection_, 0);
+    if (!sent_all) {
+        // Сервер получил неизвестную часть пакета — соединение дальше непригодно
+        batch.error = PQerrorMessage(connection_);
+        in_transaction_ = false;
+        disconnect();
+        return;
+    }
+
+    // Ответы в порядке отправки: у каждого оператора — результат и nullptr,
+    // после операторы ошибки — PGRES_PIPELINE_ABORTED, в конце — PGRES_PIPELINE_SYNC
+    const size_t first = own_transaction ? 1 : 0;
+    for (size_t i = 0; i < sent.size(); ++i) {
+        PGresult* res = PQgetResult(connection_);
+        BatchStatementResult statement = batch_statement_result(res);
+        PQclear(res);
+        while (PGresult* extra = PQgetResult(connection_)) PQclear(extra);
+
+        if (i >= first && i - first < queries.size()) {
+            batch.statements[i - first] = std::move(statement);
+        } else if (statement.status == BatchStatus::Failed) {
+            batch.error = (i == 0 ? "BEGIN failed: " : "COMMIT failed: ") + statement.error;
+        }
+    }
+    while (PGresult* res = PQgetResult(connection_)) {
+        bool sync = PQresultStatus(res) == PGRES_PIPELINE_SYNC;
+        PQclear(res);
+        if (sync) break;
+    }
+    if (!PQexitPipelineMode(connection_) && batch.error.empty()) {
+        batch.error = PQerrorMessage(connection_);
+    }
+}
+
+#else
+
+// libpq без конвейера (< 14): те же результаты, но по одному сетевому кругу на оператор
+void PostgresConnector::run_pipeline(const std::vector<std::string>& queries, bool own_transaction,
+                                     BatchResult& batch) {
+    if (own_transaction && !execute_simple_query("BEGIN")) {
+        batch.error = "BEGIN failed: " + std::string(PQerrorMessage(connection_));
+        return;
+    }
+    for (size_t i = 0; i < queries.size(); ++i) {
+        PGresult* res = PQexec(connection_, queries[i].c_str());
+        batch.statements[i] = batch_statement_result(res);
+        PQclear(res);
+        if (batch.statements[i].status != BatchStatus::Ok) return;
+    }
+    if (own_transaction && !execute_simple_query("COMMIT")) {
+        batch.error = "COMMIT failed: " + std::string(PQerrorMessage(connection_));
+    }
+}
+
+#endif
+
+// -------------------------
+// Декодирование значений
+// -------------------------
+
+namespace {
+
+using PGresultPtr = std::unique_ptr<PGresult, decltype(&PQclear)>;
+
+// Эпоха PostgreSQL (2000-01-01) относительно эпохи Unix
+constexpr int64_t PG_EPOCH_DAYS = 10957;
+constexpr int64_t PG_EPOCH_MICROS = PG_EPOCH_DAYS * 86400LL * 1000000LL;
+
+// Способ разбора ячейки — выбирается один раз на колонку по типу и формату
+enum class CellDecoder {
+    TextBool,
+    TextInt,
+    TextFloat,
+    TextString,
+    BinBool,
+    BinInt2,
+    BinInt4,
+    BinInt8,
+    BinOid,
+    BinFloat4,
+    BinFloat8,
+    BinNumeric,
+    BinUuid,
+    BinTimestamp,
+    BinTimestampTz,
+    BinDate,
+    BinText,       // бинарное представление совпадает с текстовым
+    BinJsonb,      // байт версии + текст
+    BinTime,       // типы ниже разбираются в строку, как её выводит сервер в текстовом формате
+    BinTimeTz,
+    BinInterval,
+    BinInet,
+    BinMacaddr,
+    BinMoney,
+    BinArray,      // элементы — декодером типа элемента, запись {a,b,...}
+    BinBytes       // прочие типы: сырые байты в виде \x<hex>, как bytea
+};
+
+uint16_t read_be16(const char* p) {
+    const auto* u = reinterpret_cast<const unsigned char*>(p);
+    return static_cast<uint16_t>((u[0] << 8) | u[1]);
+}
+
+uint32_t read_be32(const char* p) {
+    const auto* u = reinterpret_cast<const unsigned char*>(p);
+    return (uint32_t(u[0]) << 24) | (uint32_t(u[1]) << 16) | (uint32_t(u[2]) << 8) | uint32_t(u[3]);
+}
+
+uint64_t read_be64(const char* p) {
+    return (uint64_t(read_be32(p)) << 32) | read_be32(p + 4);
+}
+
+CellDecoder resolve_decoder(const std::string& type, bool binary) {
+    if (!binary) {
+        if (type == "bool") return CellDecoder::TextBool;
+        if (type == "int2" || type == "int4" || type == "int8" || type == "oid") return CellDecoder::TextInt;
+        if (type == "float4" || type == "float8" || type == "numeric") return CellDecoder::TextFloat;
+        return CellDecoder::TextString;
+    }
+
+    static const std::unordered_map<std::string, CellDecoder> binary_decoders = {
+        {"bool", CellDecoder::BinBool}, {"int2", CellDecoder::BinInt2},
+        {"int4", CellDecoder::BinInt4}, {"int8", CellDecoder::BinInt8},
+        {"oid", CellDecoder::BinOid}, {"float4", CellDecoder::BinFloat4},
+        {"float8", CellDecoder::BinFloat8}, {"numeric", CellDecoder::BinNumeric},
+        {"uuid", CellDecoder::BinUuid}, {"timestamp", CellDecoder::BinTimestamp},
+        {"timestamptz", CellDecoder::BinTimestampTz}, {"date", CellDecoder::BinDate},
+        {"text", CellDecoder::BinText}, {"varchar", CellDecoder::BinText},
+        {"bpchar", CellDecoder::BinText}, {"name", CellDecoder::BinText},
+        {"char", CellDecoder::BinText}, {"json", CellDecoder::BinText},
+        {"xml", CellDecoder::BinText}, {"cstring", CellDecoder::BinText},
+        {"unknown", CellDecoder::BinText}, {"jsonb", CellDecoder::BinJsonb},
+        {"time", CellDecoder::BinTime}, {"timetz", CellDecoder::BinTimeTz},
+        {"interval", CellDecoder::BinInterval}, {"inet", CellDecoder::BinInet},
+        {"cidr", CellDecoder::BinInet}, {"macaddr", CellDecoder::BinMacaddr},
+        {"macaddr8", CellDecoder::BinMacaddr}, {"money", CellDecoder::BinMoney}
+    };
+
+    auto it = binary_decoders.find(type);
+    if (it != binary_decoders.end()) return it->second;
+    return type.ends_with("[]") ? CellDecoder::BinArray : CellDecoder::BinBytes;
+}
+
+ValueKind decoder_kind(CellDecoder decoder) {
+    switch (decoder) {
+        case CellDecoder::TextBool:
+        case CellDecoder::BinBool:
+            return ValueKind::Bool;
+        case CellDecoder::TextInt:
+        case CellDecoder::BinInt2:
+        case CellDecoder::BinInt4:
+        case CellDecoder::BinInt8:
+        case CellDecoder::BinOid:
+            return ValueKind::Int64;
+        case CellDecoder::TextFloat:
+        case CellDecoder::BinFloat4:
+        case CellDecoder::BinFloat8:
+        case CellDecoder::BinNumeric:
+            return ValueKind::Float64;
+        case CellDecoder::BinTimestamp:
+            return ValueKind::Timestamp;
+        case CellDecoder::BinTimestampTz:
+            return ValueKind::TimestampTz;
+        case CellDecoder::BinDate:
+            return ValueKind::Date;
+        default:
+            return ValueKind::String;
+    }
+}
+
+// numeric: ndigits, weight, sign, dscale и цифры по основанию 10000.
+// Собираем десятичную запись "<цифры>e<порядок>" и разбираем её from_chars —
+// результат совпадает с std::stod по текстовому представлению
+double decode_numeric(const char* p, std::string& scratch) {
+    const int ndigits = static_cast<int16_t>(read_be16(p));
+    const int weight = static_cast<int16_t>(read_be16(p + 2));
+    const uint16_t sign = read_be16(p + 4);
+
+    if (sign == 0xC000) return std::numeric_limits<double>::quiet_NaN();
+    if (sign == 0xD000) return std::numeric_limits<double>::infinity();
+    if (sign == 0xF000) return -std::numeric_limits<double>::infinity();
+    if (ndigits == 0) return 0.0;
+
+    scratch.clear();
+    if (sign == 0x4000) scratch.push_back('-');
+    for (int i = 0; i < ndigits; ++i) {
+        char group[8];
+        std::snprintf(group, sizeof(group), "%04u", static_cast<unsigned>(read_be16(p + 8 + 2 * i)));
+        scratch.append(group, 4);
+    }
+    scratch.push_back('e');
+    scratch += std::to_string((weight - ndigits + 1) * 4);
+
+    double value = 0.0;
+    std::from_chars(scratch.data(), scratch.data() + scratch.size(), value);
+    return value;
+}
+
+int64_t decode_pg_timestamp(const char* p) {
+    const auto raw = static_cast<int64_t>(read_be64(p));
+    if (raw == TEMPORAL_INFINITY || raw == TEMPORAL_NEG_INFINITY) return raw;
+    return raw + PG_EPOCH_MICROS;
+}
+
+int64_t decode_pg_date(const char* p) {
+    const auto raw = static_cast<int32_t>(read_be32(p));
+    if (raw == INT32_MAX) return TEMPORAL_INFINITY;
+    if (raw == INT32_MIN) return TEMPORAL_NEG_INFINITY;
+    return raw + PG_EPOCH_DAYS;
+}
+
+// numeric в точной десятичной записи с dscale знаками после точки, как numeric_out
+void append_numeric_text(FastStringBuilder& b, const char* p) {
+    const int ndigits = static_cast<int16_t>(read_be16(p));
+    const int weight = static_cast<int16_t>(read_be16(p + 2));
+    const uint16_t sign = read_be16(p + 4);
+    const int dscale = read_be16(p + 6);
+
+    if (sign == 0xC000) { b.append_literal("NaN"); return; }
+    if (sign == 0xD000) { b.append_literal("Infinity"); return; }
+    if (sign == 0xF000) { b.append_literal("-Infinity"); return; }
+
+    // Цифра i по основанию 10000 имеет вес weight - i; за пределами ndigits — нули
+    auto digit = [&](int i) -> int64_t { return i >= 0 && i < ndigits ? read_be16(p + 8 + 2 * i) : 0; };
+    if (sign == 0x4000) b.push_back('-');
+    if (weight < 0) {
+        b.push_back('0');
+    } else {
+        b.append_number(digit(0));
+        for (int i = 1; i <= weight; ++i) append_padded(b, digit(i), 4);
+    }
+    if (dscale > 0) {
+        b.push_back('.');
+        for (int i = weight + 1, left = dscale; left > 0; ++i, left -= 4) {
+            FastStringBuilder group;
+            append_padded(group, digit(i), 4);
+            b.append(group.str().data(), static_cast<size_t>(std::min(left, 4)));
+        }
+    }
+}
+
+// "HH:MM:SS[.ffffff]" для неотрицательного времени; часы не ограничены сутками (interval)
+void append_clock(FastStringBuilder& b, int64_t micros) {
+    append_padded(b, micros / 3600000000LL, 2);
+    b.push_back(':');
+    append_padded(b, micros / 60000000LL % 60, 2);
+    b.push_back(':');
+    append_padded(b, micros / 1000000LL % 60, 2);
+    int64_t frac = micros % 1000000LL;
+    if (frac != 0) {
+        int width = 6;
+        while (frac % 10 == 0) { frac /= 10; --width; }
+        b.push_back('.');
+        append_padded(b, frac, width);
+    }
+}
+
+// timetz: время и смещение зоны в секундах к западу от UTC; вывод "+03", "+05:30"
+void append_timetz(FastStringBuilder& b, const char* p) {
+    append_clock(b, static_cast<int64_t>(read_be64(p)));
+    const int32_t offset = -static_cast<int32_t>(read_be32(p + 8));
+    const int32_t abs_offset = offset < 0 ? -offset : offset;
+    b.push_back(offset < 0 ? '-' : '+');
+    append_padded(b, abs_offset / 3600, 2);
+    if (abs_offset % 3600 != 0) {
+        b.push_back(':');
+        append_padded(b, abs_offset / 60 % 60, 2);
+        if (abs_offset % 60 != 0) {
+            b.push_back(':');
+            append_padded(b, abs_offset % 60, 2);
+        }
+    }
+}
+
+// interval в стиле IntervalStyle = postgres: "1 year 2 mons -3 days +04:05:06.5"
+void append_interval(FastStringBuilder& b, const char* p) {
+    const auto micros = static_cast<int64_t>(read_be64(p));
+    const auto days = static_cast<int32_t>(read_be32(p + 8));
+    const auto months = static_cast<int32_t>(read_be32(p + 12));
+    if (months == INT32_MAX && days == INT32_MAX && micros == INT64_MAX) { b.append_literal("infinity"); return; }
+    if (months == INT32_MIN && days == INT32_MIN && micros == INT64_MIN) { b.append_literal("-infinity"); return; }
+
+    bool empty = true;
+    bool negative = false;   // предыдущая часть отрицательна — следующая положительная пишется с "+"
+    auto part = [&](int64_t value, const char* unit) {
+        if (value == 0) return;
+        if (!empty) b.push_back(' ');
+        if (negative && value > 0) b.push_back('+');
+        b.append_number(value);
+        b.push_back(' ');
+        b.append_literal(unit);
+        if (value != 1) b.push_back('s');
+        negative = value < 0;
+        empty = false;
+    };
+    part(months / 12, "year");
+    part(months % 12, "mon");
+    part(days, "day");
+    if (empty || micros != 0) {
+        if (!empty) b.push_back(' ');
+        if (micros < 0) b.push_back('-');
+        else if (negative) b.push_back('+');
+        append_clock(b, micros < 0 ? -micros : micros);
+    }
+}
+
+// inet / cidr: семейство, длина маски, признак cidr, длина адреса, адрес.
+// Маска пишется у cidr всегда, у inet — если она короче адреса
+void append_inet(FastStringBuilder& b, const char* p) {
+    const auto* u = reinterpret_cast<const unsigned char*>(p);
+    const bool v4 = u[0] == 2;   // PGSQL_AF_INET; PGSQL_AF_INET6 = 3
+    char buf[INET6_ADDRSTRLEN];
+    if (!inet_ntop(v4 ? AF_INET : AF_INET6, p + 4, buf, sizeof(buf))) return;
+    b.append(buf, std::strlen(buf));
+    if (u[2] || u[1] != (v4 ? 32 : 128)) {
+        b.push_back('/');
+        b.append_number(static_cast<int>(u[1]));
+    }
+}
+
+// money: целое число в сотых; вывод как у сервера с локалью C / en_US: "-$1,234.56"
+void append_money(FastStringBuilder& b, const char* p) {
+    const auto cents = static_cast<int64_t>(read_be64(p));
+    const uint64_t abs_cents = cents < 0 ? 0 - static_cast<uint64_t>(cents) : static_cast<uint64_t>(cents);
+    if (cents < 0) b.push_back('-');
+    b.push_back('$');
+    const std::string units = std::to_string(abs_cents / 100);
+    for (size_t i = 0; i < units.size(); ++i) {
+        if (i > 0 && (units.size() - i) % 3 == 0) b.push_back(',');
+        b.push_back(units[i]);
+    }
+    b.push_back('.');
+    append_padded(b, static_cast<int64_t>(abs_cents % 100), 2);
+}
+
+void append_float_text(FastStringBuilder& b, double v) {
+    if (std::isnan(v)) b.append_literal("NaN");
+    else if (std::isinf(v)) b.append_literal(v > 0 ? "Infinity" : "-Infinity");
+    else b.append_number(v);
+}
+
+void append_hex(FastStringBuilder& b, const char* p, int len) {
+    static const char hex[] = "0123456789abcdef";
+    for (int i = 0; i < len; ++i) {
+        const auto c = static_cast<unsigned char>(p[i]);
+        b.push_back(hex[c >> 4]);
+        b.push_back(hex[c & 0xF]);
+    }
+}
+
+void append_uuid(FastStringBuilder& b, const char* p) {
+    append_hex(b, p, 4);
+    b.push_back('-');
+    append_hex(b, p + 4, 2);
+    b.push_back('-');
+    append_hex(b, p + 6, 2);
+    b.push_back('-');
+    append_hex(b, p + 8, 2);
+    b.push_back('-');
+    append_hex(b, p + 10, 6);
+}
+
+// Бинарное значение в текстовой записи сервера — для строковых типов и элементов массивов
+void append_binary_text(FastStringBuilder& b, CellDecoder decoder, const char* p, int len) {
+    switch (decoder) {
+        case CellDecoder::BinBool:
+            b.push_back(p[0] ? 't' : 'f');
+            break;
+        case CellDecoder::BinInt2:
+            b.append_number(static_cast<int16_t>(read_be16(p)));
+            break;
+        case CellDecoder::BinInt4:
+            b.append_number(static_cast<int32_t>(read_be32(p)));
+            break;
+        case CellDecoder::BinInt8:
+            b.append_number(static_cast<int64_t>(read_be64(p)));
+            break;
+        case CellDecoder::BinOid:
+            b.append_number(read_be32(p));
+            break;
+        case CellDecoder::BinFloat4: {
+            uint32_t bits = read_be32(p);
+            float f;
+            std::memcpy(&f, &bits, sizeof(f));
+            append_float_text(b, f);
+            break;
+        }
+        case CellDecoder::BinFloat8: {
+            uint64_t bits = read_be64(p);
+            double d;
+            std::memcpy(&d, &bits, sizeof(d));
+            append_float_text(b, d);
+            break;
+        }
+        case CellDecoder::BinNumeric:
+            append_numeric_text(b, p);
+            break;
+        case CellDecoder::BinUuid:
+            append_uuid(b, p);
+            break;
+        case CellDecoder::BinTimestamp:
+            append_temporal_text(b, ValueKind::Timestamp, decode_pg_timestamp(p));
+            break;
+        case CellDecoder::BinTimestampTz:
+            append_temporal_text(b, ValueKind::TimestampTz, decode_pg_timestamp(p));
+            break;
+        case CellDecoder::BinDate:
+            append_temporal_text(b, ValueKind::Date, decode_pg_date(p));
+            break;
+        case CellDecoder::BinJsonb:
+            if (len > 0) b.append(p + 1, static_cast<size_t>(len - 1));
+            break;
+        case CellDecoder::BinTime:
+            append_clock(b, static_cast<int64_t>(read_be64(p)));
+            break;
+        case CellDecoder::BinTimeTz:
+            append_timetz(b, p);
+            break;
+        case CellDecoder::BinInterval:
+            append_interval(b, p);
+            break;
+        case CellDecoder::BinInet:
+            append_inet(b, p);
+            break;
+        case CellDecoder::BinMacaddr:
+            for (int i = 0; i < len; ++i) {
+                if (i > 0) b.push_back(':');
+                append_hex(b, p + i, 1);
+            }
+            break;
+        case CellDecoder::BinMoney:
+            append_money(b, p);
+            break;
+        case CellDecoder::BinArray:
+        case CellDecoder::BinBytes:
+            b.append_literal("\\x");
+            append_hex(b, p, len);
+            break;
+        default:   // текстовый формат и BinText — значение уже в текстовой записи
+            b.append(p, static_cast<size_t>(len));
+            break;
+    }
+}
+
+// Элемент массива берётся в кавычки, если его иначе нельзя отличить от разметки или NULL
+bool array_element_needs_quotes(std::string_view v) {
+    if (v.empty()) return true;
+    if (v.size() == 4 && (v[0] | 0x20) == 'n' && (v[1] | 0x20) == 'u' && (v[2] | 0x20) == 'l' &&
+        (v[3] | 0x20) == 'l') return true;
+    for (char c : v) {
+        if (c == '{' || c == '}' || c == ',' || c == '"' || c == '\\' || c == ' ' ||
+            (c >= '\t' && c <= '\r')) return true;
+    }
+    return false;
+}
+
+// Массив: число измерений, флаг NULL, OID элемента, (длина, нижняя граница) на измерение,
+// затем элементы (длина -1 — NULL). Вывод как у array_out: "{1,2}", "{{a,NULL},{\"b c\",d}}",
+// при нижней границе не 1 — с префиксом "[0:1]="
+void append_array(FastStringBuilder& b, CellDecoder element, const char* p, int len) {
+    const char* end = p + len;
+    auto need = [&](const char* at, size_t bytes) {
+        if (at + bytes > end) throw std::runtime_error("Malformed array value");
+    };
+    need(p, 12);
+    const auto ndim = static_cast<int32_t>(read_be32(p));
+    if (ndim <= 0) {
+        b.append_literal("{}");
+        return;
+    }
+    need(p + 12, static_cast<size_t>(ndim) * 8);
+    std::vector<int32_t> dims(ndim);
+    bool default_bounds = true;
+    for (int d = 0; d < ndim; ++d) {
+        dims[d] = static_cast<int32_t>(read_be32(p + 12 + 8 * d));
+        default_bounds = default_bounds && static_cast<int32_t>(read_be32(p + 16 + 8 * d)) == 1;
+    }
+    if (!default_bounds) {
+        for (int d = 0; d < ndim; ++d) {
+            const auto lower = static_cast<int32_t>(read_be32(p + 16 + 8 * d));
+            b.push_back('[');
+            b.append_number(lower);
+            b.push_back(':');
+            b.append_number(static_cast<int64_t>(lower) + dims[d] - 1);
+            b.push_back(']');
+        }
+        b.push_back('=');
+    }
+
+    const char* cur = p + 12 + 8 * ndim;
+    std::string& out = b.str();
+    auto append_level = [&](auto& self, int level) -> void {
+        b.push_back('{');
+        for (int32_t k = 0; k < dims[level]; ++k) {
+            if (k > 0) b.push_back(',');
+            if (level + 1 < ndim) {
+                self(self, level + 1);
+                continue;
+            }
+            need(cur, 4);
+            const auto elem_len = static_cast<int32_t>(read_be32(cur));
+            cur += 4;
+            if (elem_len < 0) {
+                b.append_literal("NULL");
+                continue;
+            }
+            need(cur, static_cast<size_t>(elem_len));
+            const size_t start = out.size();
+            append_binary_text(b, element, cur, elem_len);
+            cur += elem_len;
+            if (array_element_needs_quotes(std::string_view(out).substr(start))) {
+                const std::string raw = out.substr(start);
+                out.resize(start);
+                b.push_back('"');
+                for (char c : raw) {
+                    if (c == '"' || c == '\\') b.push_back('\\');
+                    b.push_back(c);
+                }
+                b.push_back('"');
+            }
+        }
+        b.push_back('}');
+    };
+    append_level(append_level, 0);
+}
+
+// Декодер — параметр шаблона: в каждой специализации switch сворачивается
+// в одну ветку, и в цикле по колонке выбора типа не остаётся
+template <CellDecoder D>
+void decode_cell(ColumnData& data, const char* val, int len, CellDecoder element, FastStringBuilder& scratch) {
+    switch (D) {
+        case CellDecoder::TextBool:
+            data.append_bool(val[0] == 't');
+            break;
+        case CellDecoder::TextInt:
+            data.append_int(std::stoll(val));
+            break;
+        case CellDecoder::TextFloat:
+            data.append_double(std::stod(val));
+            break;
+        case CellDecoder::TextString:
+        case CellDecoder::BinText:
+            data.append_string(std::string_view(val, len));
+            break;
+        case CellDecoder::BinBool:
+            data.append_bool(val[0] != 0);
+            break;
+        case CellDecoder::BinInt2:
+            data.append_int(static_cast<int16_t>(read_be16(val)));
+            break;
+        case CellDecoder::BinInt4:
+            data.append_int(static_cast<int32_t>(read_be32(val)));
+            break;
+        case CellDecoder::BinInt8:
+            data.append_int(static_cast<int64_t>(read_be64(val)));
+            break;
+        case CellDecoder::BinOid:
+            data.append_int(read_be32(val));
+            break;
+        case CellDecoder::BinFloat4: {
+            uint32_t bits = read_be32(val);
+            float f;
+            std::memcpy(&f, &bits, sizeof(f));
+            data.append_double(f);
+            break;
+        }
+        case CellDecoder::BinFloat8: {
+            uint64_t bits = read_be64(val);
+            double d;
+            std::memcpy(&d, &bits, sizeof(d));
+            data.append_double(d);
+            break;
+        }
+        case CellDecoder::BinNumeric:
+            data.append_double(decode_numeric(val, scratch.str()));
+            break;
+        case CellDecoder::BinTimestamp:
+            data.append_temporal(ValueKind::Timestamp, decode_pg_timestamp(val));
+            break;
+        case CellDecoder::BinTimestampTz:
+            data.append_temporal(ValueKind::TimestampTz, decode_pg_timestamp(val));
+            break;
+        case CellDecoder::BinDate:
+            data.append_temporal(ValueKind::Date, decode_pg_date(val));
+            break;
+        case CellDecoder::BinJsonb:
+            data.append_string(len > 0 ? std::string_view(val + 1, len - 1) : std::string_view());
+            break;
+        case CellDecoder::BinArray:
+            scratch.str().clear();
+            append_array(scratch, element, val, len);
+            data.append_string(scratch.str());
+            break;
+        case CellDecoder::BinUuid:
+        case CellDecoder::BinTime:
+        case CellDecoder::BinTimeTz:
+        case CellDecoder::BinInterval:
+        case CellDecoder::BinInet:
+        case CellDecoder::BinMacaddr:
+        case CellDecoder::BinMoney:
+        case CellDecoder::BinBytes:
+            scratch.str().clear();
+            append_binary_text(scratch, D, val, len);
+            data.append_string(scratch.str());
+            break;
+    }
+}
+
+// Разбор колонки j всех строк PGresult одним циклом
+template <CellDecoder D>
+void decode_column(PGresult* res, int j, CellDecoder element, ColumnData& data, FastStringBuilder& scratch) {
+    const int num_rows = PQntuples(res);
+    for (int i = 0; i < num_rows; ++i) {
+        if (PQgetisnull(res, i, j)) {
+            data.append_null();
+            continue;
+        }
+        decode_cell<D>(data, PQgetvalue(res, i, j), PQgetlength(res, i, j), element, scratch);
+    }
+}
+
+using ColumnDecodeFn = void (*)(PGresult* res, int j, CellDecoder element, ColumnData& data,
+                                FastStringBuilder& scratch);
+
+ColumnDecodeFn column_decoder(CellDecoder decoder) {
+    switch (decoder) {
+        case CellDecoder::TextBool:       return &decode_column<CellDecoder::TextBool>;
+        case CellDecoder::TextInt:        return &decode_column<CellDecoder::TextInt>;
+        case CellDecoder::TextFloat:      return &decode_column<CellDecoder::TextFloat>;
+        case CellDecoder::TextString:     return &decode_column<CellDecoder::TextString>;
+        case CellDecoder::BinBool:        return &decode_column<CellDecoder::BinBool>;
+        case CellDecoder::BinInt2:        return &decode_column<CellDecoder::BinInt2>;
+        case CellDecoder::BinInt4:        return &decode_column<CellDecoder::BinInt4>;
+        case CellDecoder::BinInt8:        return &decode_column<CellDecoder::BinInt8>;
+        case CellDecoder::BinOid:         return &decode_column<CellDecoder::BinOid>;
+        case CellDecoder::BinFloat4:      return &decode_column<CellDecoder::BinFloat4>;
+        case CellDecoder::BinFloat8:      return &decode_column<CellDecoder::BinFloat8>;
+        case CellDecoder::BinNumeric:     return &decode_column<CellDecoder::BinNumeric>;
+        case CellDecoder::BinUuid:        return &decode_column<CellDecoder::BinUuid>;
+        case CellDecoder::BinTimestamp:   return &decode_column<CellDecoder::BinTimestamp>;
+        case CellDecoder::BinTimestampTz: return &decode_column<CellDecoder::BinTimestampTz>;
+        case CellDecoder::BinDate:        return &decode_column<CellDecoder::BinDate>;
+        case CellDecoder::BinText:        return &decode_column<CellDecoder::BinText>;
+        case CellDecoder::BinJsonb:       return &decode_column<CellDecoder::BinJsonb>;
+        case CellDecoder::BinTime:        return &decode_column<CellDecoder::BinTime>;
+        case CellDecoder::BinTimeTz:      return &decode_column<CellDecoder::BinTimeTz>;
+        case CellDecoder::BinInterval:    return &decode_column<CellDecoder::BinInterval>;
+        case CellDecoder::BinInet:        return &decode_column<CellDecoder::BinInet>;
+        case CellDecoder::BinMacaddr:     return &decode_column<CellDecoder::BinMacaddr>;
+        case CellDecoder::BinMoney:       return &decode_column<CellDecoder::BinMoney>;
+        case CellDecoder::BinArray:       return &decode_column<CellDecoder::BinArray>;
+        case CellDecoder::BinBytes:       break;
+    }
+    return &decode_column<CellDecoder::BinBytes>;
+}
+
+// Встроенные типы PostgreSQL: их OID одинаковы во всех базах и версиях
+const std::string* builtin_type_name(Oid type_oid) {
     static const std::unordered_map<Oid, std::string> type_map = {
         {16, "bool"}, {17, "bytea"}, {18, "char"}, {20, "int8"}, {21, "int2"},
         {23, "int4"}, {26, "oid"}, {700, "float4"}, {701, "float8"}, {1700, "numeric"},
@@ -199,139 +1086,837 @@ std::string PostgresConnector::oid_to_type_name(Oid type_oid) const {
         {1000, "bool[]"}, {1005, "int2[]"}, {1007, "int4[]"}, {1016, "int8[]"},
         {1021, "float4[]"}, {1022, "float8[]"}, {1009, "text[]"}, {1015, "varchar[]"},
         {1231, "numeric[]"}, {600, "point"}, {601, "line"}, {602, "lseg"}, {603, "box"},
-        {604, "path"}, {628, "line"}, {869, "inet"}, {650, "cidr"}, {1040, "macaddr"},
-        {1041, "macaddr8"}, {142, "xml"}, {2950, "uuid"}, {2278, "bytea"}
+        {604, "path"}, {628, "line"}, {869, "inet"}, {650, "cidr"}, {829, "macaddr"},
+        {774, "macaddr8"}, {790, "money"}, {1040, "macaddr[]"}, {1041, "inet[]"},
+        {1182, "date[]"}, {1115, "timestamp[]"}, {1185, "timestamptz[]"}, {2951, "uuid[]"}, {142, "xml"}, {2950, "uuid"}, {2278, "void"}
     };
 
     auto it = type_map.find(type_oid);
-    if (it != type_map.end()) {
-        return it->second;
-    }
+    return it != type_map.end() ? &it->second : nullptr;
+}
 
-    if (is_connected()) {
-        std::string query = "SELECT typname FROM pg_type WHERE oid = " + std::to_string(type_oid);
-        PGresult* res = PQexec(connection_, query.c_str());
+constexpr const char* TYPE_CATALOG_QUERY =
+    "SELECT oid, typname, typelem, typbasetype, typcategory, typtype FROM pg_type";
 
-        if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0) {
-            std::string type_name = PQgetvalue(res, 0, 0);
-            PQclear(res);
-            return type_name;
-        }
-        PQclear(res);
+Oid parse_oid(const char* text) {
+    return static_cast<Oid>(std::strtoul(text, nullptr, 10));
+}
+
+} // namespace
+
+std::string PostgresConnector::oid_to_type_name(Oid type_oid) const {
+    if (const std::string* name = builtin_type_name(type_oid)) return *name;
+
+    auto it = type_cache_.find(type_oid);
+    if (it == type_cache_.end() && load_types("oid = " + std::to_string(type_oid))) {
+        it = type_cache_.find(type_oid);
     }
+    if (it != type_cache_.end()) return it->second.name;
 
     return "oid_" + std::to_string(type_oid);
 }
 
-QueryResult PostgresConnector::execute(const std::string& query) {
-    if (!is_connected()) {
-        throw std::runtime_error("Not connected to PostgreSQL");
+// Тип, по которому выбирается декодер: перечисления разбираются как текст,
+// домены — как их базовый тип (в том числе домен над доменом)
+std::string PostgresConnector::decode_type_name(Oid type_oid, const std::string& type_name) const {
+    std::string name = type_name;
+    for (int depth = 0; depth < 8; ++depth) {
+        auto it = type_cache_.find(type_oid);
+        if (it == type_cache_.end()) break;
+        if (it->second.kind == 'e') return "text";
+        if (it->second.kind != 'd') break;
+
+        type_oid = it->second.base_type;
+        if (const std::string* base = builtin_type_name(type_oid)) return *base;
+        auto base_it = type_cache_.find(type_oid);
+        if (base_it == type_cache_.end()) break;
+        name = base_it->second.name;
     }
+    return name;
+}
 
-    std::string wrapped_query;
-    std::string query_;
-    
-    query_ = query;
+// Тип элемента массива для выбора декодера: int4[] → int4, mood[] → text (перечисление).
+// type_name — тип, по которому выбран декодер массива, с суффиксом []
+std::string PostgresConnector::element_type_name(Oid type_oid, const std::string& type_name) const {
+    std::string element = type_name.substr(0, type_name.size() - 2);
+    auto it = type_cache_.find(type_oid);
+    if (it != type_cache_.end() && it->second.element != 0) return decode_type_name(it->second.element, element);
+    return element;
+}
 
-    wrapped_query.reserve(query.size() + 128);
+// Дописывает в кэш записи pg_type, подходящие под условие filter (пусто — весь каталог).
+// false — соединение занято или запрос не выполнился
+bool PostgresConnector::load_types(const std::string& filter) const {
+    if (!is_connected() || busy()) return false;
 
-    std::string limit_clause;
-    {
-        // Регэксп ищет "LIMIT <число> [OFFSET <число>]" в конце строки
-        std::regex limit_regex(R"(\s+LIMIT\s+\d+(\s+OFFSET\s+\d+)?\s*;?\s*$)", 
-                      std::regex_constants::icase | std::regex_constants::ECMAScript);
-        std::smatch match;
+    std::string query = TYPE_CATALOG_QUERY;
+    if (!filter.empty()) query += " WHERE " + filter;
+    PGresultPtr res(PQexec(connection_, query.c_str()), &PQclear);
+    if (PQresultStatus(res.get()) != PGRES_TUPLES_OK) return false;
 
-        if (std::regex_search(query_, match, limit_regex)) {
-            limit_clause = match.str();                            // сохраняем LIMIT / OFFSET
-            query_.erase(match.position(), match.length());          // вырезаем из подзапроса
+    for (int i = 0; i < PQntuples(res.get()); ++i) {
+        PgTypeInfo info;
+        info.name = PQgetvalue(res.get(), i, 1);
+        info.element = parse_oid(PQgetvalue(res.get(), i, 2));
+        info.base_type = parse_oid(PQgetvalue(res.get(), i, 3));
+        info.category = PQgetvalue(res.get(), i, 4)[0];
+        info.kind = PQgetvalue(res.get(), i, 5)[0];
+        // Массивы называются как встроенные: _mood → mood[]
+        if (info.category == 'A' && info.element != 0 && info.name.starts_with('_')) {
+            info.name = info.name.substr(1) + "[]";
         }
+        type_cache_[parse_oid(PQgetvalue(res.get(), i, 0))] = std::move(info);
+    }
+    return true;
+}
+
+// Неизвестные OID колонок результата читаются одним запросом —
+// вместе с типами элементов массивов и базовыми типами доменов
+void PostgresConnector::load_result_types(PGresult* res) const {
+    std::string oids;
+    for (int i = 0; i < PQnfields(res); ++i) {
+        const Oid type_oid = PQftype(res, i);
+        if (builtin_type_name(type_oid) || type_cache_.count(type_oid)) continue;
+        if (!oids.empty()) oids.push_back(',');
+        oids += std::to_string(type_oid);
     }
+    if (oids.empty()) return;
+    load_types("oid IN (SELECT unnest(ARRAY[oid, typelem, typbasetype]) FROM pg_type WHERE oid IN (" +
+               oids + "))");
+}
+
+void PostgresConnector::set_preload_types(bool enabled) {
+    preload_types_ = enabled;
+}
+
+bool PostgresConnector::preload_types() const {
+    return preload_types_;
+}
+
+size_t PostgresConnector::refresh_types() {
+    ensure_idle();
+    type_cache_.clear();
+    if (!load_types("")) {
+        throw std::runtime_error("Failed to load pg_type: " + std::string(PQerrorMessage(connection_)));
+    }
+    return type_cache_.size();
+}
+
+std::optional<PgTypeInfo> PostgresConnector::type_info(Oid type_oid) {
+    auto it = type_cache_.find(type_oid);
+    if (it == type_cache_.end() && load_types("oid = " + std::to_string(type_oid))) {
+        it = type_cache_.find(type_oid);
+    }
+    if (it == type_cache_.end()) return std::nullopt;
+    return it->second;
+}
+
+// Указатели на значения параметров для PQexecPrepared / PQexecParams
+static std::vector<const char*> param_values(const QueryParams& params) {
+    std::vector<const char*> values;
+    values.reserve(params.size());
+    for (const auto& param : params) {
+        values.push_back(param ? param->c_str() : nullptr);
+    }
+    return values;
+}
 
+static bool is_select_query(const std::string& query) {
+    return query.starts_with("SELECT") || query.starts_with("select");
+}
+
+std::string PostgresConnector::wrap_count_query(const std::string& query) const {
     if (query.find("__total_count") != std::string::npos ||
-    query.find("COUNT(") != std::string::npos) {
-        wrapped_query = query_;
-    } else if (query_.starts_with("SELECT") || query_.starts_with("select")) {
-        wrapped_query = "SELECT subq.*, COUNT(*) OVER() AS __total_count FROM (" + query_ + ") AS subq";
-        if (!limit_clause.empty()) {
-            wrapped_query += " " + limit_clause; // добавляем лимит снаружи
+        query.find("COUNT(") != std::string::npos || !is_select_query(query)) {
+        return query;
+    }
+
+    LimitClause clause;
+    std::string body = strip_limit_clause(query, clause);
+
+    std::string wrapped_query;
+    wrapped_query.reserve(query.size() + 128);
+    wrapped_query = "SELECT subq.*, COUNT(*) OVER() AS __total_count FROM (" + body + ") AS subq";
+    if (!clause.text.empty()) {
+        wrapped_query += " " + clause.text; // добавляем лимит снаружи
+    }
+    return wrapped_query;
+}
+
+// Текст, который реально уходит на сервер: обёртка с __total_count только в режиме Exact
+std::string PostgresConnector::statement_text(const std::string& query, CountMode mode) const {
+    return mode == CountMode::Exact ? wrap_count_query(query) : query;
+}
+
+// Выполняет служебный запрос в текстовом формате и возвращает первое значение
+std::string PostgresConnector::scalar_query(const std::string& query, const QueryParams* params) {
+    std::vector<const char*> values = params ? param_values(*params) : std::vector<const char*>{};
+    PGresultPtr res(PQexecParams(connection_, query.c_str(), static_cast<int>(values.size()),
+                                 nullptr, values.data(), nullptr, nullptr, 0), &PQclear);
+    if (PQresultStatus(res.get()) != PGRES_TUPLES_OK) {
+        throw std::runtime_error("Count query failed: " + std::string(PQresultErrorMessage(res.get())));
+    }
+    if (PQntuples(res.get()) == 0 || PQgetisnull(res.get(), 0, 0)) return {};
+    return PQgetvalue(res.get(), 0, 0);
+}
+
+// Оценка числа строк из плана: "Plan Rows" корневого узла EXPLAIN (FORMAT JSON)
+static size_t parse_plan_rows(const std::string& plan) {
+    static const std::string key = "\"Plan Rows\":";
+    size_t pos = plan.find(key);
+    if (pos == std::string::npos) return 0;
+    double rows = std::strtod(plan.c_str() + pos + key.size(), nullptr);
+    return rows > 0 ? static_cast<size_t>(rows) : 0;
+}
+
+// Запрос выполнен как есть, count — число полученных строк. Дополнительный запрос
+// нужен, только если LIMIT обрезал результат; иначе count уточняется здесь же
+// rows — строк на странице; count — число строк результата, уточняется по неполной странице
+static std::optional<CountRequest> count_request(size_t rows, size_t& count, const std::string& query,
+                                                 CountMode mode) {
+    if (mode != CountMode::Separate && mode != CountMode::Estimate) return std::nullopt;
+    if (!is_select_query(query)) return std::nullopt;
+
+    LimitClause clause;
+    std::string body = strip_limit_clause(query, clause);
+    if (clause.text.empty()) return std::nullopt;   // без LIMIT получены все строки
+
+    if (count_from_page(clause, rows, count)) return std::nullopt;
+
+    CountRequest request{"", mode, clause.offset + rows};
+    request.sql = mode == CountMode::Separate
+        ? "SELECT COUNT(*) FROM (" + body + ") AS subq"
+        : "EXPLAIN (FORMAT JSON) " + body;
+    return request;
+}
+
+static size_t count_value(const CountRequest& request, const std::string& value) {
+    if (request.mode == CountMode::Separate) {
+        return value.empty() ? request.seen : std::stoull(value);
+    }
+    return std::max(parse_plan_rows(value), request.seen);
+}
+
+void PostgresConnector::apply_count_mode(QueryResult& result, const std::string& query,
+                                         const QueryParams* params, CountMode mode) {
+    if (auto request = count_request(result.row_count(), result.count, query, mode)) {
+        result.count = count_value(*request, scalar_query(request->sql, params));
+    }
+}
+
+void PostgresConnector::set_count_mode(CountMode mode) {
+    count_mode_ = mode;
+}
+
+CountMode PostgresConnector::count_mode() const {
+    return count_mode_;
+}
+
+QueryResult PostgresConnector::execute(const std::string& query) {
+    return execute(query, count_mode_);
+}
+
+QueryResult PostgresConnector::execute(const std::string& query, CountMode count_mode) {
+    ensure_idle();
+    if (use_result_cache(query)) {
+        return *result_cache_->get_or_load(result_cache_key(query, nullptr, count_mode),
+                                          [&] { return run_query(query, nullptr, count_mode); },
+                                          result_cache_ttl_);
+    }
+    return run_query(query, nullptr, count_mode);
+}
+
+// Кэш только вне транзакции по состоянию сервера, а не по in_transaction_: транзакция могла
+// быть открыта запросом BEGIN или остаться после пакета. Внутри неё запрос видит свой снимок
+// и незафиксированные изменения — ни брать их из общего кэша, ни класть туда нельзя
+bool PostgresConnector::use_result_cache(const std::string& query) const {
+    return result_cache_ && connection_ && PQtransactionStatus(connection_) == PQTRANS_IDLE &&
+           ResultCache::is_cacheable_query(query);
+}
+
+// Выполнение запроса в обход кэша результатов
+QueryResult PostgresConnector::run_query(const std::string& query, const QueryParams* params,
+                                         CountMode count_mode) {
+    std::string statement = statement_text(query, count_mode);
+    QueryResult result;
+
+    if (params) {
+        if (statement_cache_size_ == 0) {
+            // Кэш выключен — разбор и планирование на каждый вызов, за один round trip
+            std::vector<const char*> values = param_values(*params);
+            PGresult* res = PQexecParams(connection_, statement.c_str(), static_cast<int>(values.size()),
+                                         nullptr, values.data(), nullptr, nullptr, binary_results_ ? 1 : 0);
+            result = command_result(res);
+        } else {
+            result = execute_prepared(cached_statement(statement), *params);
         }
     } else {
-        wrapped_query = query;
+        // Выполняем запрос: в бинарном режиме через PQexecParams с resultFormat = 1
+        PGresult* res = binary_results_
+            ? PQexecParams(connection_, statement.c_str(), 0, nullptr, nullptr, nullptr, nullptr, 1)
+            : PQexec(connection_, statement.c_str());
+        if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+            std::string error = PQresultErrorMessage(res);
+            PQclear(res);
+            throw std::runtime_error("Query failed: " + error);
+        }
+
+        PGresultPtr guard(res, &PQclear);
+        result = build_result(res);
+    }
+
+    apply_count_mode(result, query, params, count_mode);
+    return result;
+}
+
+// Режимы, меняющие результат, и параметры (с длиной — чтобы границы значений были однозначны)
+std::string PostgresConnector::result_cache_key(const std::string& query, const QueryParams* params,
+                                                CountMode count_mode) const {
+    std::string variant = "binary=" + std::to_string(binary_results_) +
+                          " intern=" + std::to_string(intern_strings_) +
+                          " count=" + std::to_string(static_cast<int>(count_mode));
+    if (params) {
+        for (const auto& param : *params) {
+            if (!param) {
+                variant += " null";
+            } else {
+                variant += " " + std::to_string(param->size()) + ":";
+                variant += *param;
+            }
+        }
     }
+    return ResultCache::make_key(cache_target_, query, variant);
+}
+
+void PostgresConnector::set_result_cache(std::shared_ptr<ResultCache> cache, std::chrono::milliseconds ttl) {
+    result_cache_ = std::move(cache);
+    result_cache_ttl_ = ttl;
+}
 
-    // Выполняем запрос
-    PGresult* res = PQexec(connection_, wrapped_query.c_str());
-    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+std::shared_ptr<ResultCache> PostgresConnector::result_cache() const {
+    return result_cache_;
+}
+
+// -------------------------
+// Подготовленные запросы
+// -------------------------
+
+bool PostgresConnector::prepare(const std::string& name, const std::string& query) {
+    return prepare_statement(name, statement_text(query, count_mode_));
+}
+
+bool PostgresConnector::prepare_statement(const std::string& name, const std::string& statement) {
+    if (!is_connected()) {
+        std::cerr << "Cannot prepare statement: not connected" << std::endl;
+        return false;
+    }
+
+    if (busy()) {
+        std::cerr << "Cannot prepare statement: connection is busy" << std::endl;
+        return false;
+    }
+
+    PGresult* res = PQprepare(connection_, name.c_str(), statement.c_str(), 0, nullptr);
+    bool success = PQresultStatus(res) == PGRES_COMMAND_OK;
+
+    if (!success) {
+        std::cerr << "Prepare failed: " << PQresultErrorMessage(res) << std::endl;
+    }
+
+    PQclear(res);
+    return success;
+}
+
+QueryResult PostgresConnector::command_result(PGresult* res) const {
+    ExecStatusType status = PQresultStatus(res);
+    if (status != PGRES_TUPLES_OK && status != PGRES_COMMAND_OK) {
         std::string error = PQresultErrorMessage(res);
         PQclear(res);
         throw std::runtime_error("Query failed: " + error);
     }
 
-    const int num_cols = PQnfields(res);
-    const int num_rows = PQntuples(res);
+    PGresultPtr guard(res, &PQclear);
+    if (status == PGRES_COMMAND_OK) {
+        // INSERT / UPDATE / DELETE: колонок нет, count — число затронутых строк
+        QueryResult result;
+        const char* affected = PQcmdTuples(res);
+        result.count = affected[0] ? std::stoull(affected) : 0;
+        return result;
+    }
+    return build_result(res);
+}
 
-    QueryResult result;
-    result.rows.reserve(num_rows);
-    result.columns.reserve(num_cols - 1);
+QueryResult PostgresConnector::execute_prepared(const std::string& name, const QueryParams& params) {
+    ensure_idle();
+
+    std::vector<const char*> values = param_values(params);
+    PGresult* res = PQexecPrepared(connection_, name.c_str(), static_cast<int>(values.size()),
+                                   values.data(), nullptr, nullptr, binary_results_ ? 1 : 0);
+    return command_result(res);
+}
+
+QueryResult PostgresConnector::execute(const std::string& query, const QueryParams& params) {
+    return execute(query, params, count_mode_);
+}
+
+QueryResult PostgresConnector::execute(const std::string& query, const QueryParams& params,
+                                       CountMode count_mode) {
+    ensure_idle();
+    if (use_result_cache(query)) {
+        return *result_cache_->get_or_load(result_cache_key(query, &params, count_mode),
+                                          [&] { return run_query(query, &params, count_mode); },
+                                          result_cache_ttl_);
+    }
+    return run_query(query, &params, count_mode);
+}
+
+// Ключ кэша — текст, отправляемый на сервер: один запрос в разных режимах count —
+// разные операторы
+const std::string& PostgresConnector::cached_statement(const std::string& statement) {
+    auto it = statement_index_.find(statement);
+    if (it != statement_index_.end()) {
+        // Перемещаем в начало списка — самый недавно использованный
+        statement_lru_.splice(statement_lru_.begin(), statement_lru_, it->second);
+        return it->second->second;
+    }
+
+    while (statement_lru_.size() >= statement_cache_size_) {
+        evict_statement();
+    }
+
+    std::string name = "se_stmt_" + std::to_string(++statement_counter_);
+    if (!prepare_statement(name, statement)) {
+        throw std::runtime_error("Failed to prepare query: " + statement);
+    }
+
+    statement_lru_.emplace_front(statement, std::move(name));
+    statement_index_[statement] = statement_lru_.begin();
+    return statement_lru_.front().second;
+}
+
+void PostgresConnector::evict_statement() {
+    if (statement_lru_.empty()) return;
+
+    const auto& [query, name] = statement_lru_.back();
+    if (is_connected()) {
+        // Ошибка DEALLOCATE (например, в прерванной транзакции) не критична:
+        // имена операторов не переиспользуются
+        execute_simple_query("DEALLOCATE \"" + name + "\"");
+    }
+    statement_index_.erase(query);
+    statement_lru_.pop_back();
+}
+
+void PostgresConnector::set_statement_cache_size(size_t size) {
+    statement_cache_size_ = size;
+    while (statement_lru_.size() > statement_cache_size_) {
+        evict_statement();
+    }
+}
+
+size_t PostgresConnector::statement_cache_size() const {
+    return statement_cache_size_;
+}
+
+void PostgresConnector::clear_statement_cache() {
+    while (!statement_lru_.empty()) {
+        evict_statement();
+    }
+}
 
+// План разбора PGresult: источник и декодер каждой колонки результата,
+// определяется один раз по первому PGresult запроса
+struct PgDecodePlan {
     int total_count_col = -1;
+    std::vector<int> source_cols;          // номер колонки PGresult для каждой колонки результата
+    std::vector<CellDecoder> decoders;     // декодер, выбранный один раз на колонку
+    std::vector<CellDecoder> element_decoders;     // для массивов — декодер элемента
+    std::vector<ColumnDecodeFn> column_decoders;   // цикл разбора колонки для декодера
+};
+
+void PostgresConnector::init_result_columns(PGresult* res, QueryResult& result,
+                                            PgDecodePlan& plan) const {
+    const int num_cols = PQnfields(res);
+
+    result.columns.reserve(num_cols);
+    result.data.reserve(num_cols);
+    plan.source_cols.reserve(num_cols);
+    plan.decoders.reserve(num_cols);
+    plan.element_decoders.reserve(num_cols);
+    plan.column_decoders.reserve(num_cols);
+    load_result_types(res);
 
     // Формируем информацию о колонках
     for (int i = 0; i < num_cols; ++i) {
         std::string col_name = PQfname(res, i);
         if (col_name == "__total_count") {
-            total_count_col = i;
-        } else {
-            ColumnInfo col;
-            col.name = std::move(col_name);
-            Oid type_oid = PQftype(res, i);
-            col.type = oid_to_type_name(type_oid);
-            result.columns.push_back(std::move(col));
+            plan.total_count_col = i;
+            continue;
         }
-    }
 
-    // Читаем данные
-    for (int i = 0; i < num_rows; ++i) {
-        std::vector<Value> row;
-        row.reserve(num_cols - 1);
+        Oid type_oid = PQftype(res, i);
+        std::string type = oid_to_type_name(type_oid);
 
-        for (int j = 0; j < num_cols; ++j) {
-            if (j == total_count_col) continue;
+        const bool binary = PQfformat(res, i) == 1;
+        const std::string decode_type = decode_type_name(type_oid, type);
+        CellDecoder decoder = resolve_decoder(decode_type, binary);
+        CellDecoder element = decoder == CellDecoder::BinArray
+            ? resolve_decoder(element_type_name(type_oid, decode_type), binary)
+            : CellDecoder::BinBytes;
+        ColumnData& data = result.add_column(std::move(col_name), std::move(type), decoder_kind(decoder));
+        if (intern_strings_ && data.kind == ValueKind::String) data.intern_strings();
+        plan.source_cols.push_back(i);
+        plan.decoders.push_back(decoder);
+        plan.element_decoders.push_back(element);
+        plan.column_decoders.push_back(column_decoder(decoder));
+    }
+}
 
-            if (PQgetisnull(res, i, j)) {
-                row.push_back(nullptr);
-                continue;
-            }
+// Дописывает строки PGresult в колоночные буферы результата
+static void append_result_rows(PGresult* res, QueryResult& result, const PgDecodePlan& plan) {
+    const int num_rows = PQntuples(res);
 
-            const char* val = PQgetvalue(res, i, j);
-            const std::string& type = result.columns[j < total_count_col ? j : j - 1].type;
+    // Читаем данные колонка за колонкой — в непрерывные типизированные буферы
+    FastStringBuilder scratch;
+    for (size_t c = 0; c < plan.source_cols.size(); ++c) {
+        const int j = plan.source_cols[c];
+        const CellDecoder decoder = plan.decoders[c];
+        ColumnData& data = result.data[c];
 
-            if (type == "bool") {
-                row.push_back(val[0] == 't');
-            } else if (type == "int2" || type == "int4" || type == "int8") {
-                row.push_back(std::stoll(val));
-            } else if (type == "float4" || type == "float8" || type == "numeric") {
-                row.push_back(std::stod(val));
-            } else {
-                row.push_back(std::string(val));
-            }
+        // Байты текстовых колонок известны заранее — буфер строк выделяется один раз
+        // (в потоке пачка собирается из многих PGresult — там буфер растёт с запасом)
+        if (data.kind == ValueKind::String && !data.interned &&
+            (decoder == CellDecoder::TextString || decoder == CellDecoder::BinText)) {
+            size_t bytes = data.chars.size();
+            for (int i = 0; i < num_rows; ++i) bytes += static_cast<size_t>(PQgetlength(res, i, j));
+            if (bytes > data.chars.capacity())
+                data.chars.reserve(std::max(bytes, data.chars.capacity() * 2));
         }
 
-        result.rows.push_back(std::move(row));
+        plan.column_decoders[c](res, j, plan.element_decoders[c], data, scratch);
     }
+}
+
+QueryResult PostgresConnector::build_result(PGresult* res) const {
+    const int num_rows = PQntuples(res);
+
+    QueryResult result;
+    PgDecodePlan plan;
+    init_result_columns(res, result, plan);
+    for (ColumnData& data : result.data) data.reserve(num_rows);
+    append_result_rows(res, result, plan);
 
+    const int total_count_col = plan.total_count_col;
     if (total_count_col >= 0 && num_rows > 0 && !PQgetisnull(res, 0, total_count_col)) {
-        result.count = std::stoll(PQgetvalue(res, 0, total_count_col));
+        const char* val = PQgetvalue(res, 0, total_count_col);
+        result.count = PQfformat(res, total_count_col) == 1
+            ? static_cast<size_t>(read_be64(val))
+            : std::stoll(val);
     } else {
         result.count = num_rows;
     }
 
-    PQclear(res);
     return result;
 }
 
-std::string PostgresConnector::execute_to_json(const std::string& query) {
+QueryResult PostgresConnector::decode_result(PGresult* res) const {
+    return build_result(res);
+}
+
+// -------------------------
+// Потоковое чтение
+// -------------------------
+
+std::unique_ptr<PostgresStream> PostgresConnector::stream(const std::string& query, size_t batch_size) {
+    ensure_idle();
+    if (batch_size == 0) batch_size = 1;
+
+    // Пока поток открыт, каталог pg_type не прочитать: типы колонок узнаём заранее
+    // из описания безымянного оператора, его же и выполняем
+    PGresultPtr prepared(PQprepare(connection_, "", query.c_str(), 0, nullptr), &PQclear);
+    if (PQresultStatus(prepared.get()) != PGRES_COMMAND_OK) {
+        throw std::runtime_error("Query failed: " + std::string(PQresultErrorMessage(prepared.get())));
+    }
+    PGresultPtr description(PQdescribePrepared(connection_, ""), &PQclear);
+    if (PQresultStatus(description.get()) == PGRES_COMMAND_OK) load_result_types(description.get());
+
+    if (!PQsendQueryPrepared(connection_, "", 0, nullptr, nullptr, nullptr, binary_results_ ? 1 : 0)) {
+        throw std::runtime_error("Query failed: " + std::string(PQerrorMessage(connection_)));
+    }
+
+#ifdef LIBPQ_HAS_CHUNK_MODE
+    // libpq 17+: сервер отдаёт строки пачками до batch_size
+    bool mode_set = PQsetChunkedRowsMode(connection_, static_cast<int>(batch_size)) == 1;
+#else
+    bool mode_set = PQsetSingleRowMode(connection_) == 1;
+#endif
+    if (!mode_set) {
+        while (PGresult* res = PQgetResult(connection_)) PQclear(res);
+        throw std::runtime_error("Failed to enable row-by-row mode");
+    }
+
+    std::unique_ptr<PostgresStream> result(new PostgresStream(this, batch_size));
+    active_stream_ = result.get();
+    return result;
+}
+
+void PostgresConnector::stream_arrow(const std::string& query, size_t batch_size, ArrowArrayStream* out) {
+    std::shared_ptr<PostgresStream> rows = stream(query, batch_size);
+    export_arrow_stream([rows](QueryResult& batch) {
+        if (rows->next_batch(batch)) return true;
+        batch.columns = rows->columns();   // схема нужна и для пустого результата
+        return false;
+    }, out);
+}
+
+PostgresStream::PostgresStream(PostgresConnector* connector, size_t batch_size)
+    : connector_(connector),
+      batch_size_(batch_size),
+      finished_(false),
+      pending_(nullptr) {}
+
+PostgresStream::~PostgresStream() {
+    close();
+}
+
+bool PostgresStream::is_open() const {
+    return !finished_;
+}
+
+static bool is_row_result(ExecStatusType status) {
+#ifdef LIBPQ_HAS_CHUNK_MODE
+    if (status == PGRES_TUPLES_CHUNK) return true;
+#endif
+    return status == PGRES_SINGLE_TUPLE || status == PGRES_TUPLES_OK;
+}
+
+// Читает первый результат, чтобы узнать колонки; он сохраняется в pending_
+bool PostgresStream::fetch_header() {
+    if (plan_) return true;
+    if (finished_) return false;
+
+    if (!pending_) pending_ = PQgetResult(connector_->connection_);
+    if (!pending_) {
+        finish();
+        return false;
+    }
+    if (!is_row_result(PQresultStatus(pending_))) return false;  // ошибку выбросит next_batch
+
+    plan_ = std::make_unique<PgDecodePlan>();
+    connector_->init_result_columns(pending_, header_, *plan_);
+    return true;
+}
+
+const std::vector<ColumnInfo>& PostgresStream::columns() {
+    fetch_header();
+    return header_.columns;
+}
+
+bool PostgresStream::next_batch(QueryResult& batch) {
+    if (finished_) return false;
+
+    PGconn* conn = connector_->connection_;
+    fetch_header();
+
+    batch = QueryResult();
+    batch.columns = header_.columns;
+    for (const ColumnData& data : header_.data) {
+        batch.data.emplace_back(data.kind);
+        if (data.interned) batch.data.back().intern_strings();
+    }
+
+    while (!finished_) {
+        PGresult* res = pending_ ? std::exchange(pending_, nullptr) : PQgetResult(conn);
+        if (!res) {
+            finish();
+            break;
+        }
+
+        PGresultPtr guard(res, &PQclear);
+        ExecStatusType status = PQresultStatus(res);
+        if (!is_row_result(status)) {
+            std::string error = PQresultErrorMessage(res);
+            guard.reset();
+            while (PGresult* rest = PQgetResult(conn)) PQclear(rest);
+            finish();
+            throw std::runtime_error("Query failed: " + error);
+        }
+
+        if (!plan_) {
+            plan_ = std::make_unique<PgDecodePlan>();
+            connector_->init_result_columns(res, header_, *plan_);
+        }
+        append_result_rows(res, batch, *plan_);
+
+        if (status == PGRES_TUPLES_OK) {
+            // Завершающий результат запроса: дочитываем до NULL и освобождаем соединение
+            guard.reset();
+            while (PGresult* rest = PQgetResult(conn)) PQclear(rest);
+            finish();
+            break;
+        }
+        if (batch.row_count() >= batch_size_) break;
+    }
+
+    batch.count = batch.row_count();
+    return batch.count > 0;
+}
+
+void PostgresStream::close() {
+    if (finished_) return;
+
+    if (pending_) {
+        PQclear(pending_);
+        pending_ = nullptr;
+    }
+
+    // Отменяем запрос на сервере, чтобы не дочитывать оставшиеся строки.
+    // Внутри транзакции отмена переводит её в состояние ошибки
+    PGconn* conn = connector_->connection_;
+    if (PGcancel* cancel = PQgetCancel(conn)) {
+        char errbuf[256];
+        PQcancel(cancel, errbuf, sizeof(errbuf));
+        PQfreeCancel(cancel);
+    }
+    while (PGresult* res = PQgetResult(conn)) PQclear(res);
+    finish();
+}
+
+void PostgresStream::finish() {
+    finished_ = true;
+    if (pending_) {
+        PQclear(pending_);
+        pending_ = nullptr;
+    }
+    if (connector_->active_stream_ == this) {
+        connector_->active_stream_ = nullptr;
+    }
+}
+
+// -------------------------
+// Неблокирующее выполнение
+// -------------------------
+
+void PostgresConnector::send_async(const std::string& query, const QueryParams* params,
+                                   CountMode count_mode) {
+    ensure_idle();
+
+    std::string statement = statement_text(query, count_mode);
+    std::vector<const char*> values = params ? param_values(*params) : std::vector<const char*>{};
+    int sent = params || binary_results_
+        ? PQsendQueryParams(connection_, statement.c_str(), static_cast<int>(values.size()),
+                            nullptr, values.data(), nullptr, nullptr, binary_results_ ? 1 : 0)
+        : PQsendQuery(connection_, statement.c_str());
+    if (!sent) {
+        throw std::runtime_error("Query failed: " + std::string(PQerrorMessage(connection_)));
+    }
+
+    async_ = std::make_unique<PgAsyncQuery>();
+    async_->query = query;
+    if (params) async_->params = *params;
+    async_->mode = count_mode;
+}
+
+int PostgresConnector::socket() const {
+    return connection_ ? PQsocket(connection_) : -1;
+}
+
+bool PostgresConnector::async_pending() const {
+    return async_ != nullptr;
+}
+
+// Разбирает всё, что уже пришло из сокета. Когда результаты основного запроса
+// получены, при необходимости отправляет запрос count (режимы Separate / Estimate)
+bool PostgresConnector::poll_async() {
+    if (!async_) throw std::runtime_error("No async query in progress");
+    PgAsyncQuery& state = *async_;
+    if (state.done) return true;
+
+    if (!PQconsumeInput(connection_)) {
+        state.error = "Query failed: " + std::string(PQerrorMessage(connection_));
+        state.done = true;
+        return true;
+    }
+
+    while (!PQisBusy(connection_)) {
+        PGresult* res = PQgetResult(connection_);
+        if (!res) {
+            // Все результаты текущей команды получены
+            if (!state.counting && state.error.empty() && state.rows) {
+                const auto rows = static_cast<size_t>(PQntuples(state.rows.get()));
+                size_t total = rows;
+                state.count = count_request(rows, total, state.query, state.mode);
+                if (total != rows) state.total = total;   // неполная страница после OFFSET
+            }
+            if (state.count && !state.counting) {
+                const QueryParams* params = state.params ? &*state.params : nullptr;
+                std::vector<const char*> values = params ? param_values(*params) : std::vector<const char*>{};
+                if (!PQsendQueryParams(connection_, state.count->sql.c_str(), static_cast<int>(values.size()),
+                                       nullptr, values.data(), nullptr, nullptr, 0)) {
+                    state.error = "Count query failed: " + std::string(PQerrorMessage(connection_));
+                    state.done = true;
+                    return true;
+                }
+                state.counting = true;
+                continue;
+            }
+            state.done = true;
+            return true;
+        }
+
+        PGresultPtr guard(res, &PQclear);
+        if (!state.error.empty()) continue;   // после ошибки дочитываем результаты до конца
+
+        ExecStatusType status = PQresultStatus(res);
+        if (state.counting) {
+            if (status == PGRES_TUPLES_OK) {
+                bool empty = PQntuples(res) == 0 || PQgetisnull(res, 0, 0);
+                state.total = count_value(*state.count, empty ? "" : PQgetvalue(res, 0, 0));
+            } else {
+                state.error = "Count query failed: " + std::string(PQresultErrorMessage(res));
+            }
+        } else if (status == PGRES_TUPLES_OK) {
+            state.rows = std::move(guard);
+        } else if (status == PGRES_COMMAND_OK) {
+            state.rows.reset();
+            state.result = command_result(guard.release());
+        } else {
+            state.error = "Query failed: " + std::string(PQresultErrorMessage(res));
+        }
+    }
+    return false;
+}
+
+QueryResult PostgresConnector::take_async_result() {
+    if (!async_ || !async_->done) throw std::runtime_error("Async query is not finished");
+
+    // Соединение уже свободно: разбор строк может дочитать типы колонок из каталога
+    std::unique_ptr<PgAsyncQuery> state = std::move(async_);
+    if (!state->error.empty()) throw std::runtime_error(state->error);
+    if (state->rows) state->result = build_result(state->rows.get());
+    if (state->total) state->result.count = *state->total;
+    return std::move(state->result);
+}
+
+void PostgresConnector::cancel_async() {
+    if (!async_) return;
+
+    if (!async_->done && connection_) {
+        if (PGcancel* cancel = PQgetCancel(connection_)) {
+            char errbuf[256];
+            PQcancel(cancel, errbuf, sizeof(errbuf));
+            PQfreeCancel(cancel);
+        }
+        while (PGresult* res = PQgetResult(connection_)) PQclear(res);
+    }
+    async_.reset();
+}
+
+std::string PostgresConnector::execute_to_json(const std::string& query, const JsonParallelOptions& json_options) {
     QueryResult result = execute(query);
-    return result.to_json();
-}
\ No newline at end of file
+    return to_json_parallel(result, json_options);
+}
+
+void PostgresConnector::execute_arrow(const std::string& query, ArrowArrayStream* out) {
+    export_arrow_stream(execute(query), out);
+}
@@ -0,0 +1,582 @@
+#include "postgres_connector.h"
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+// -------------------------
+// COPY FROM STDIN
+// -------------------------
+
+namespace {
+
+// Эпоха PostgreSQL (2000-01-01) относительно эпохи Unix
+constexpr int64_t PG_EPOCH_DAYS = 10957;
+constexpr int64_t PG_EPOCH_MICROS = PG_EPOCH_DAYS * 86400LL * 1000000LL;
+
+// Пачка отправляется в соединение частями примерно такого размера
+constexpr size_t COPY_CHUNK_BYTES = 1 << 20;
+
+// Заголовок бинарного формата COPY: сигнатура, флаги, длина расширения
+constexpr char BINARY_HEADER[] = "PGCOPY\n\377\r\n\0\0\0\0\0\0\0\0\0";
+constexpr size_t BINARY_HEADER_SIZE = 19;
+
+// Кодирование значения в бинарный формат — выбирается по типу колонки таблицы
+enum class CellEncoder {
+    Bool,
+    Int2,
+    Int4,
+    Int8,
+    Float4,
+    Float8,
+    Text,       // бинарное представление совпадает с текстовым
+    Jsonb,      // байт версии + текст
+    Bytea,
+    Uuid,
+    Timestamp,
+    Date
+};
+
+const std::unordered_map<std::string, CellEncoder>& binary_encoders() {
+    static const std::unordered_map<std::string, CellEncoder> encoders = {
+        {"bool", CellEncoder::Bool}, {"int2", CellEncoder::Int2},
+        {"int4", CellEncoder::Int4}, {"int8", CellEncoder::Int8},
+        {"float4", CellEncoder::Float4}, {"float8", CellEncoder::Float8},
+        {"text", CellEncoder::Text}, {"varchar", CellEncoder::Text},
+        {"bpchar", CellEncoder::Text}, {"name", CellEncoder::Text},
+        {"json", CellEncoder::Text}, {"xml", CellEncoder::Text},
+        {"jsonb", CellEncoder::Jsonb}, {"bytea", CellEncoder::Bytea},
+        {"uuid", CellEncoder::Uuid}, {"timestamp", CellEncoder::Timestamp},
+        {"timestamptz", CellEncoder::Timestamp}, {"date", CellEncoder::Date}
+    };
+    return encoders;
+}
+
+void append_be16(FastStringBuilder& b, uint16_t v) {
+    char buf[2] = {static_cast<char>(v >> 8), static_cast<char>(v)};
+    b.append(buf, 2);
+}
+
+void append_be32(FastStringBuilder& b, uint32_t v) {
+    char buf[4] = {static_cast<char>(v >> 24), static_cast<char>(v >> 16),
+                   static_cast<char>(v >> 8), static_cast<char>(v)};
+    b.append(buf, 4);
+}
+
+void append_be64(FastStringBuilder& b, uint64_t v) {
+    append_be32(b, static_cast<uint32_t>(v >> 32));
+    append_be32(b, static_cast<uint32_t>(v));
+}
+
+// Пишет ли кодировщик значения такого вида без ошибки типа. Иначе нужен текстовый
+// формат, где значение разбирает сервер: строка '2024-01-15' в колонку date, '42' в int4.
+// Колонку только из NULL (ValueKind::Null) принимают лишь текстовые кодировщики: какие
+// значения придут в следующих пачках, неизвестно
+bool binary_accepts(CellEncoder encoder, ValueKind kind) {
+    switch (encoder) {
+        case CellEncoder::Bool:
+            return kind == ValueKind::Bool;
+        case CellEncoder::Int2:
+        case CellEncoder::Int4:
+        case CellEncoder::Int8:
+            return kind == ValueKind::Int64;
+        case CellEncoder::Float4:
+        case CellEncoder::Float8:
+            return kind == ValueKind::Float64 || kind == ValueKind::Int64;
+        case CellEncoder::Text:
+        case CellEncoder::Jsonb:
+            return true;
+        case CellEncoder::Bytea:
+        case CellEncoder::Uuid:
+            return kind == ValueKind::String;
+        case CellEncoder::Timestamp:
+            return kind == ValueKind::Timestamp || kind == ValueKind::TimestampTz;
+        case CellEncoder::Date:
+            return kind == ValueKind::Date;
+    }
+    return false;
+}
+
+// Значение без учёта типа колонки таблицы — для текстового формата и текстовых колонок
+void append_plain_text(FastStringBuilder& b, const ColumnData& data, size_t row) {
+    switch (data.kind) {
+        case ValueKind::Bool:
+            b.push_back(data.bools[row] ? 't' : 'f');
+            break;
+        case ValueKind::Int64:
+            b.append_number(data.ints[row]);
+            break;
+        case ValueKind::Float64: {
+            double v = data.doubles[row];
+            if (std::isnan(v)) b.append_literal("NaN");
+            else if (std::isinf(v)) b.append_literal(v > 0 ? "Infinity" : "-Infinity");
+            else b.append_number(v);
+            break;
+        }
+        case ValueKind::String:
+            b.append(data.string_at(row));
+            break;
+        case ValueKind::Null:
+            break;
+        default:
+            append_temporal_text(b, data.kind, data.ints[row]);
+            break;
+    }
+}
+
+} // namespace
+
+std::unique_ptr<PostgresCopyIn> PostgresConnector::copy_in(const std::string& table,
+                                                           const std::vector<std::string>& columns,
+                                                           std::optional<bool> binary) {
+    ensure_idle();
+
+    // COPY без списка колонок пропускает генерируемые (GENERATED ALWAYS AS ... STORED),
+    // а SELECT * их возвращает — поэтому колонки по умолчанию берутся из каталога
+    // и список всегда передаётся явно
+    std::vector<std::string> names = columns;
+    if (names.empty()) {
+        std::string sql = "SELECT attname FROM pg_attribute WHERE attrelid = $1::regclass "
+                          "AND attnum > 0 AND NOT attisdropped";
+        if (PQserverVersion(connection_) >= 120000) sql += " AND attgenerated = ''";
+        sql += " ORDER BY attnum";
+        const char* values[] = {table.c_str()};
+        PGresult* res = PQexecParams(connection_, sql.c_str(), 1, nullptr, values, nullptr, nullptr, 0);
+        if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+            std::string error = PQresultErrorMessage(res);
+            PQclear(res);
+            throw std::runtime_error("COPY failed: " + error);
+        }
+        for (int i = 0; i < PQntuples(res); ++i) names.push_back(PQgetvalue(res, i, 0));
+        PQclear(res);
+        if (names.empty()) throw std::runtime_error("COPY failed: table " + table + " has no columns to load");
+    }
+
+    std::string column_list;
+    for (const std::string& column : names) {
+        char* quoted = PQescapeIdentifier(connection_, column.c_str(), column.size());
+        if (!quoted) throw std::runtime_error("Invalid column name: " + column);
+        if (!column_list.empty()) column_list += ", ";
+        column_list += quoted;
+        PQfreemem(quoted);
+    }
+
+    // Типы колонок таблицы определяют формат и кодирование значений
+    std::string probe = "SELECT " + column_list + " FROM " + table + " LIMIT 0";
+    PGresult* res = PQexec(connection_, probe.c_str());
+    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+        std::string error = PQresultErrorMessage(res);
+        PQclear(res);
+        throw std::runtime_error("COPY failed: " + error);
+    }
+    std::vector<ColumnInfo> info;
+    for (int j = 0; j < PQnfields(res); ++j) {
+        info.push_back({PQfname(res, j), oid_to_type_name(PQftype(res, j))});
+    }
+    PQclear(res);
+
+    bool use_binary = binary.value_or(true);
+    for (const ColumnInfo& column : info) {
+        if (!binary_encoders().count(column.type)) use_binary = false;
+    }
+
+    // Сама команда COPY отправляется с первой пачкой: формат зависит ещё и от её значений
+    std::string command = "COPY " + table + " (" + column_list + ") FROM STDIN";
+    std::unique_ptr<PostgresCopyIn> copy(
+        new PostgresCopyIn(this, std::move(command), std::move(info), use_binary, binary.value_or(false)));
+    active_copy_ = copy.get();
+    return copy;
+}
+
+uint64_t PostgresConnector::copy_in(const std::string& table, const std::vector<std::string>& columns,
+                                    const QueryResult& rows, std::optional<bool> binary) {
+    auto copy = copy_in(table, columns, binary);
+    copy->write(rows);
+    return copy->finish();
+}
+
+PostgresCopyIn::PostgresCopyIn(PostgresConnector* connector, std::string command, std::vector<ColumnInfo> columns,
+                               bool binary, bool binary_requested)
+    : connector_(connector),
+      command_(std::move(command)),
+      columns_(std::move(columns)),
+      binary_(binary),
+      binary_requested_(binary_requested),
+      started_(false),
+      finished_(false),
+      buffer_(COPY_CHUNK_BYTES + 4096) {}
+
+PostgresCopyIn::~PostgresCopyIn() {
+    abort();
+}
+
+bool PostgresCopyIn::is_open() const {
+    return !finished_;
+}
+
+bool PostgresCopyIn::binary() const {
+    return binary_;
+}
+
+const std::vector<ColumnInfo>& PostgresCopyIn::columns() const {
+    return columns_;
+}
+
+void PostgresCopyIn::write(const QueryResult& batch) {
+    if (finished_) throw std::runtime_error("COPY is already finished");
+    if (batch.data.size() != columns_.size()) {
+        throw std::runtime_error("COPY expects " + std::to_string(columns_.size()) + " columns, got " +
+                                 std::to_string(batch.data.size()));
+    }
+
+    const size_t num_rows = batch.row_count();
+    if (num_rows == 0) return;
+    if (!started_) start(&batch);
+
+    const size_t num_cols = columns_.size();
+    try {
+        for (size_t i = 0; i < num_rows; ++i) {
+            if (binary_) append_be16(buffer_, static_cast<uint16_t>(num_cols));
+            for (size_t j = 0; j < num_cols; ++j) {
+                const ColumnData& data = batch.data[j];
+                if (binary_) {
+                    encode_binary(data, i, j);
+                } else {
+                    if (j > 0) buffer_.push_back('\t');
+                    encode_text(data, i, j);
+                }
+            }
+            if (!binary_) buffer_.push_back('\n');
+            flush(COPY_CHUNK_BYTES);
+        }
+    } catch (const std::exception& e) {
+        // Строка записана наполовину — продолжать этот COPY нельзя
+        abort(e.what());
+        throw;
+    }
+}
+
+// Отправляет команду COPY. Бинарный формат остаётся, только если кодировщик каждой
+// колонки принимает значения первой пачки; без данных (first == nullptr) — текстовый.
+// Колонка только из NULL при явно заданном бинарном формате его не отменяет
+void PostgresCopyIn::start(const QueryResult* first) {
+    if (!first) binary_ = false;
+    for (size_t j = 0; binary_ && j < columns_.size(); ++j) {
+        const ValueKind kind = first->data[j].kind;
+        if (kind == ValueKind::Null && binary_requested_) continue;
+        binary_ = binary_accepts(binary_encoders().at(columns_[j].type), kind);
+    }
+
+    PGconn* conn = connector_->connection_;
+    std::string sql = command_ + (binary_ ? " (FORMAT binary)" : "");
+    PGresult* res = PQexec(conn, sql.c_str());
+    ExecStatusType status = PQresultStatus(res);
+    std::string error = PQresultErrorMessage(res);
+    PQclear(res);
+    if (status != PGRES_COPY_IN) {
+        end(nullptr);
+        throw std::runtime_error("COPY failed: " + error);
+    }
+
+    started_ = true;
+    if (binary_) buffer_.append(BINARY_HEADER, BINARY_HEADER_SIZE);
+}
+
+void PostgresCopyIn::encode_binary(const ColumnData& data, size_t row, size_t col) {
+    if (data.kind == ValueKind::Null || data.is_null(row)) {
+        append_be32(buffer_, 0xFFFFFFFFu);   // длина -1 — NULL
+        return;
+    }
+
+    const ColumnInfo& column = columns_[col];
+    const CellEncoder encoder = binary_encoders().at(column.type);
+    auto mismatch = [&]() {
+        return std::runtime_error("COPY: cannot write " + std::string(value_kind_name(data.kind)) +
+                                  " value to column '" + column.name + "' of type " + column.type);
+    };
+    auto int_value = [&](int64_t min, int64_t max) {
+        if (data.kind != ValueKind::Int64) throw mismatch();
+        int64_t v = data.ints[row];
+        if (v < min || v > max) {
+            throw std::runtime_error("COPY: value " + std::to_string(v) + " is out of range for column '" +
+                                     column.name + "' of type " + column.type);
+        }
+        return v;
+    };
+    auto float_value = [&]() {
+        if (data.kind == ValueKind::Float64) return data.doubles[row];
+        if (data.kind == ValueKind::Int64) return static_cast<double>(data.ints[row]);
+        throw mismatch();
+    };
+
+    switch (encoder) {
+        case CellEncoder::Bool:
+            if (data.kind != ValueKind::Bool) throw mismatch();
+            append_be32(buffer_, 1);
+            buffer_.push_back(data.bools[row] ? 1 : 0);
+            break;
+        case CellEncoder::Int2:
+            append_be32(buffer_, 2);
+            append_be16(buffer_, static_cast<uint16_t>(int_value(INT16_MIN, INT16_MAX)));
+            break;
+        case CellEncoder::Int4:
+            append_be32(buffer_, 4);
+            append_be32(buffer_, static_cast<uint32_t>(int_value(INT32_MIN, INT32_MAX)));
+            break;
+        case CellEncoder::Int8:
+            append_be32(buffer_, 8);
+            append_be64(buffer_, static_cast<uint64_t>(int_value(INT64_MIN, INT64_MAX)));
+            break;
+        case CellEncoder::Float4: {
+            float v = static_cast<float>(float_value());
+            uint32_t bits;
+            std::memcpy(&bits, &v, sizeof(bits));
+            append_be32(buffer_, 4);
+            append_be32(buffer_, bits);
+            break;
+        }
+        case CellEncoder::Float8: {
+            double v = float_value();
+            uint64_t bits;
+            std::memcpy(&bits, &v, sizeof(bits));
+            append_be32(buffer_, 8);
+            append_be64(buffer_, bits);
+            break;
+        }
+        case CellEncoder::Text:
+        case CellEncoder::Jsonb: {
+            // Длина известна только после форматирования — резервируем место под неё
+            std::string& out = buffer_.str();
+            const size_t length_at = out.size();
+            append_be32(buffer_, 0);
+            if (encoder == CellEncoder::Jsonb) buffer_.push_back(1);
+            append_plain_text(buffer_, data, row);
+            const auto length = static_cast<uint32_t>(out.size() - length_at - 4);
+            for (int k = 0; k < 4; ++k) out[length_at + k] = static_cast<char>(length >> (24 - 8 * k));
+            break;
+        }
+        case CellEncoder::Bytea: {
+            if (data.kind != ValueKind::String) throw mismatch();
+            std::string_view bytes = data.string_at(row);
+            append_be32(buffer_, static_cast<uint32_t>(bytes.size()));
+            buffer_.append(bytes);
+            break;
+        }
+        case CellEncoder::Uuid: {
+            uint8_t uuid[16];
+            if (data.kind != ValueKind::String || !parse_uuid(data.string_at(row), uuid)) throw mismatch();
+            append_be32(buffer_, 16);
+            buffer_.append(reinterpret_cast<const char*>(uuid), 16);
+            break;
+        }
+        case CellEncoder::Timestamp: {
+            if (data.kind != ValueKind::Timestamp && data.kind != ValueKind::TimestampTz) throw mismatch();
+            int64_t v = data.ints[row];
+            if (v != TEMPORAL_INFINITY && v != TEMPORAL_NEG_INFINITY) v -= PG_EPOCH_MICROS;
+            append_be32(buffer_, 8);
+            append_be64(buffer_, static_cast<uint64_t>(v));
+            break;
+        }
+        case CellEncoder::Date: {
+            if (data.kind != ValueKind::Date) throw mismatch();
+            int64_t v = data.ints[row];
+            int32_t days = v == TEMPORAL_INFINITY ? INT32_MAX
+                         : v == TEMPORAL_NEG_INFINITY ? INT32_MIN
+                         : static_cast<int32_t>(v - PG_EPOCH_DAYS);
+            append_be32(buffer_, 4);
+            append_be32(buffer_, static_cast<uint32_t>(days));
+            break;
+        }
+    }
+}
+
+void PostgresCopyIn::encode_text(const ColumnData& data, size_t row, size_t col) {
+    if (data.kind == ValueKind::Null || data.is_null(row)) {
+        buffer_.append_literal("\\N");
+        return;
+    }
+    if (data.kind != ValueKind::String) {
+        append_plain_text(buffer_, data, row);   // числа, даты и bool не содержат спецсимволов
+        return;
+    }
+
+    std::string_view text = data.string_at(row);
+    if (columns_[col].type == "bytea") {
+        // Сырые байты — в hex-формате bytea; обратная косая черта удваивается для COPY
+        static const char hex[] = "0123456789abcdef";
+        buffer_.append_literal("\\\\x");
+        for (unsigned char c : text) {
+            buffer_.push_back(hex[c >> 4]);
+            buffer_.push_back(hex[c & 0xF]);
+        }
+        return;
+    }
+
+    const char* p = text.data();
+    const char* end = p + text.size();
+    while (p < end) {
+        const char* q = p;
+        while (q < end && *q != '\\' && *q != '\t' && *q != '\n' && *q != '\r') ++q;
+        if (q > p) buffer_.append(p, static_cast<size_t>(q - p));
+        if (q == end) break;
+        switch (*q) {
+            case '\\': buffer_.append_literal("\\\\"); break;
+            case '\t': buffer_.append_literal("\\t"); break;
+            case '\n': buffer_.append_literal("\\n"); break;
+            default:   buffer_.append_literal("\\r"); break;
+        }
+        p = q + 1;
+    }
+}
+
+// Отправляет накопленные байты, если их не меньше threshold
+void PostgresCopyIn::flush(size_t threshold) {
+    std::string& out = buffer_.str();
+    if (out.empty() || out.size() < threshold) return;
+
+    PGconn* conn = connector_->connection_;
+    if (PQputCopyData(conn, out.data(), static_cast<int>(out.size())) != 1) {
+        std::string error = PQerrorMessage(conn);
+        end("client failed to send COPY data");
+        throw std::runtime_error("COPY failed: " + error);
+    }
+    out.clear();
+}
+
+uint64_t PostgresCopyIn::finish() {
+    if (finished_) throw std::runtime_error("COPY is already finished");
+    if (!started_) start(nullptr);
+
+    if (binary_) append_be16(buffer_, 0xFFFF);   // признак конца данных
+    flush(0);
+
+    PGconn* conn = connector_->connection_;
+    if (PQputCopyEnd(conn, nullptr) != 1) {
+        std::string error = PQerrorMessage(conn);
+        end("client failed to finish COPY");
+        throw std::runtime_error("COPY failed: " + error);
+    }
+
+    uint64_t rows = 0;
+    std::string error;
+    while (PGresult* res = PQgetResult(conn)) {
+        if (PQresultStatus(res) == PGRES_COMMAND_OK) {
+            rows = std::strtoull(PQcmdTuples(res), nullptr, 10);
+        } else if (error.empty()) {
+            error = PQresultErrorMessage(res);
+        }
+        PQclear(res);
+    }
+    end(nullptr);
+    if (!error.empty()) throw std::runtime_error("COPY failed: " + error);
+    return rows;
+}
+
+void PostgresCopyIn::abort(const std::string& reason) {
+    if (finished_) return;
+    PGconn* conn = connector_->connection_;
+    if (started_ && conn && PQputCopyEnd(conn, reason.c_str()) == 1) {
+        while (PGresult* res = PQgetResult(conn)) PQclear(res);
+    }
+    end(nullptr);
+}
+
+// Освобождает соединение; error (если задан) прерывает COPY на сервере
+void PostgresCopyIn::end(const char* error) {
+    if (started_ && !finished_ && error) {
+        PGconn* conn = connector_->connection_;
+        if (PQputCopyEnd(conn, error) == 1) {
+            while (PGresult* res = PQgetResult(conn)) PQclear(res);
+        }
+    }
+    finished_ = true;
+    buffer_.str().clear();
+    if (connector_->active_copy_ == this) {
+        connector_->active_copy_ = nullptr;
+    }
+}
+
+// -------------------------
+// COPY TO STDOUT
+// -------------------------
+
+namespace {
+
+// Запрос без завершающих ';' и пробелов — для подстановки в COPY (...)
+std::string copy_query_body(const std::string& query) {
+    size_t end = query.size();
+    while (end > 0 && (std::isspace(static_cast<unsigned char>(query[end - 1])) || query[end - 1] == ';')) --end;
+    return query.substr(0, end);
+}
+
+// Прерывает выгрузку: отмена на сервере и дочитывание уже отправленных данных
+void discard_copy_out(PGconn* conn) {
+    if (PGcancel* cancel = PQgetCancel(conn)) {
+        char errbuf[256];
+        PQcancel(cancel, errbuf, sizeof(errbuf));
+        PQfreeCancel(cancel);
+    }
+    char* chunk = nullptr;
+    while (PQgetCopyData(conn, &chunk, 0) > 0) PQfreemem(chunk);
+    while (PGresult* res = PQgetResult(conn)) PQclear(res);
+}
+
+} // namespace
+
+uint64_t PostgresConnector::copy_out(const std::string& query, OutputSink& out, ExportFormat format,
+                                     bool header) {
+    // HEADER сервер принимает только в csv (в text — лишь начиная с PostgreSQL 15)
+    if (header && format != ExportFormat::Csv) {
+        throw std::invalid_argument("COPY header is supported only for csv format");
+    }
+    ensure_idle();
+
+    std::string options = format == ExportFormat::Csv ? "FORMAT csv"
+                        : format == ExportFormat::Tsv ? "FORMAT text"
+                        : "FORMAT binary";
+    if (header) options += ", HEADER";
+    std::string sql = "COPY (" + copy_query_body(query) + ") TO STDOUT WITH (" + options + ")";
+
+    PGresult* res = PQexec(connection_, sql.c_str());
+    ExecStatusType status = PQresultStatus(res);
+    std::string error = PQresultErrorMessage(res);
+    PQclear(res);
+    if (status != PGRES_COPY_OUT) {
+        throw std::runtime_error("COPY failed: " + error);
+    }
+
+    // Каждый вызов PQgetCopyData отдаёт одну строку (в binary — кусок данных);
+    // буферизацию записи обеспечивает приёмник
+    char* chunk = nullptr;
+    int length;
+    while ((length = PQgetCopyData(connection_, &chunk, 0)) > 0) {
+        try {
+            out.write(chunk, static_cast<size_t>(length));
+        } catch (...) {
+            PQfreemem(chunk);
+            discard_copy_out(connection_);
+            throw;
+        }
+        PQfreemem(chunk);
+    }
+    if (length == -2) error = PQerrorMessage(connection_);
+
+    uint64_t rows = 0;
+    while (PGresult* result = PQgetResult(connection_)) {
+        if (PQresultStatus(result) == PGRES_COMMAND_OK) {
+            rows = std::strtoull(PQcmdTuples(result), nullptr, 10);
+        } else if (error.empty()) {
+            error = PQresultErrorMessage(result);
+        }
+        PQclear(result);
+    }
+    if (!error.empty()) throw std::runtime_error("COPY failed: " + error);
+
+    out.flush();
+    return rows;
+}
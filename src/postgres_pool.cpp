@@ -0,0 +1,195 @@
+#include "postgres_pool.h"
+#include <stdexcept>
+#include <utility>
+
+// -------------------------
+// Аренда
+// -------------------------
+
+PostgresPool::Lease::Lease(PostgresPool* pool, std::unique_ptr<PostgresConnector> connection)
+    : pool_(pool), connection_(std::move(connection)) {}
+
+PostgresPool::Lease::Lease(Lease&& other) noexcept
+    : pool_(std::exchange(other.pool_, nullptr)),
+      connection_(std::move(other.connection_)) {}
+
+PostgresPool::Lease& PostgresPool::Lease::operator=(Lease&& other) noexcept {
+    if (this != &other) {
+        release();
+        pool_ = std::exchange(other.pool_, nullptr);
+        connection_ = std::move(other.connection_);
+    }
+    return *this;
+}
+
+PostgresPool::Lease::~Lease() {
+    release();
+}
+
+PostgresConnector& PostgresPool::Lease::operator*() const {
+    return *get();
+}
+
+PostgresConnector* PostgresPool::Lease::operator->() const {
+    return get();
+}
+
+PostgresConnector* PostgresPool::Lease::get() const {
+    if (!connection_) throw std::runtime_error("Connection lease has been released");
+    return connection_.get();
+}
+
+PostgresPool::Lease::operator bool() const {
+    return connection_ != nullptr;
+}
+
+void PostgresPool::Lease::release() {
+    if (connection_ && pool_) {
+        pool_->give_back(std::move(connection_));
+    }
+    connection_.reset();
+    pool_ = nullptr;
+}
+
+// -------------------------
+// Пул
+// -------------------------
+
+PostgresPool::PostgresPool(std::string conninfo, PostgresPoolOptions options)
+    : conninfo_(std::move(conninfo)),
+      options_(options),
+      open_(0),
+      leased_(0),
+      closed_(false) {
+    if (options_.size == 0) throw std::invalid_argument("Pool size must be positive");
+
+    // Соединения открываются сразу, чтобы первые запросы не платили за handshake
+    idle_.reserve(options_.size);
+    auto now = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < options_.size; ++i) {
+        idle_.push_back({open_connection(), now});
+        ++open_;
+    }
+}
+
+PostgresPool::~PostgresPool() {
+    close();
+}
+
+std::unique_ptr<PostgresConnector> PostgresPool::open_connection() const {
+    auto connection = std::make_unique<PostgresConnector>();
+    connection->set_preload_types(options_.preload_types);
+    if (!connection->connect(conninfo_)) {
+        throw std::runtime_error("Failed to open pooled PostgreSQL connection");
+    }
+    return connection;
+}
+
+// Проверка перед выдачей; соединение получает настройки пула
+bool PostgresPool::check_out(PostgresConnector& connection,
+                             std::chrono::steady_clock::time_point idle_since) const {
+    bool stale = std::chrono::steady_clock::now() - idle_since >= options_.health_check_after;
+    bool healthy = stale ? connection.ping() : connection.is_connected();
+    if (!healthy && !connection.connect(conninfo_)) return false;
+
+    connection.set_binary_results(options_.binary_results);
+    connection.set_intern_strings(options_.intern_strings);
+    connection.set_count_mode(options_.count_mode);
+    connection.set_result_cache(options_.result_cache, options_.result_cache_ttl);
+    return true;
+}
+
+PostgresPool::Lease PostgresPool::acquire() {
+    return acquire(options_.acquire_timeout);
+}
+
+PostgresPool::Lease PostgresPool::acquire(std::chrono::milliseconds timeout) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (true) {
+        if (closed_) throw std::runtime_error("Pool is closed");
+
+        if (!idle_.empty()) {
+            IdleConnection entry = std::move(idle_.back());
+            idle_.pop_back();
+            ++leased_;
+            lock.unlock();
+
+            // Проверка идёт без блокировки: ping не задерживает другие потоки
+            if (check_out(*entry.connection, entry.since)) {
+                return Lease(this, std::move(entry.connection));
+            }
+
+            entry.connection.reset();
+            lock.lock();
+            --leased_;
+            --open_;
+            continue;   // место освободилось — следующий проход откроет новое соединение
+        }
+
+        if (open_ < options_.size) {
+            // Соединение было выброшено как сломанное — открываем замену
+            ++open_;
+            ++leased_;
+            lock.unlock();
+            try {
+                auto connection = open_connection();
+                check_out(*connection, std::chrono::steady_clock::now());
+                return Lease(this, std::move(connection));
+            } catch (...) {
+                lock.lock();
+                --open_;
+                --leased_;
+                available_.notify_one();
+                throw;
+            }
+        }
+
+        bool ready = available_.wait_until(lock, deadline, [this] {
+            return closed_ || !idle_.empty() || open_ < options_.size;
+        });
+        if (!ready) throw std::runtime_error("Timed out waiting for a pooled PostgreSQL connection");
+    }
+}
+
+void PostgresPool::give_back(std::unique_ptr<PostgresConnector> connection) {
+    // Откат транзакции и закрытие потока — до возврата в пул, без блокировки
+    bool reusable = connection->reset_session();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    --leased_;
+    if (reusable && !closed_) {
+        idle_.push_back({std::move(connection), std::chrono::steady_clock::now()});
+    } else {
+        --open_;
+    }
+    lock.unlock();
+    available_.notify_one();
+    // Непригодное соединение закрывается здесь, вне блокировки
+}
+
+void PostgresPool::close() {
+    std::vector<IdleConnection> idle;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        open_ -= idle_.size();
+        idle.swap(idle_);
+    }
+    available_.notify_all();
+}
+
+size_t PostgresPool::size() const {
+    return options_.size;
+}
+
+size_t PostgresPool::idle() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return idle_.size();
+}
+
+size_t PostgresPool::in_use() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return leased_;
+}
@@ -1,46 +1,1275 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
+#include <pybind11/numpy.h>
 
+#include "arrow_export.h"
 #include "clickhouse_connector.h"
+#include "clickhouse_pool.h"
+#include "json_writer.h"
 #include "postgres_connector.h"
+#include "postgres_pool.h"
+#include "result_cache.h"
+
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <datetime.h>
 
 namespace py = pybind11;
 
-py::object json_string_to_python_dict(const std::string& json_str) {
-    py::module json_module = py::module::import("json");
-    return json_module.attr("loads")(json_str);
+// C++-часть вызова — без GIL: медленный запрос не останавливает другие потоки Python.
+// Коннекторы не потокобезопасны, поэтому вызовы одного коннектора из разных
+// потоков сериализуются его мьютексом (берётся уже после освобождения GIL)
+template <typename Connector, typename F>
+static auto without_gil(Connector& connector, F&& work) {
+    py::gil_scoped_release release;
+    std::lock_guard<std::mutex> lock(connector.call_mutex());
+    return work();
+}
+
+// -----------------------------------------------------------------------------
+// Прямое преобразование QueryResult в объекты Python (без промежуточного JSON)
+// -----------------------------------------------------------------------------
+
+// Форма строк в результате: словари {колонка: значение} или кортежи
+enum class RowFormat {
+    Dict,
+    Tuple
+};
+
+static RowFormat parse_row_format(const std::string& name) {
+    if (name == "dict") return RowFormat::Dict;
+    if (name == "tuple") return RowFormat::Tuple;
+    throw py::value_error("row_format must be 'dict' or 'tuple', got '" + name + "'");
+}
+
+static CountMode parse_count_mode(const std::string& name) {
+    if (name == "none") return CountMode::None;
+    if (name == "exact") return CountMode::Exact;
+    if (name == "separate") return CountMode::Separate;
+    if (name == "estimate") return CountMode::Estimate;
+    throw py::value_error("count_mode must be 'none', 'exact', 'separate' or 'estimate', got '" + name + "'");
+}
+
+static const char* count_mode_name(CountMode mode) {
+    switch (mode) {
+        case CountMode::None: return "none";
+        case CountMode::Exact: return "exact";
+        case CountMode::Separate: return "separate";
+        case CountMode::Estimate: return "estimate";
+    }
+    return "exact";
+}
+
+// Время/дата из бинарного режима — datetime.datetime / datetime.date.
+// Значения вне диапазона datetime (infinity, годы до н. э. и после 9999) — строкой
+static PyObject* temporal_to_python(ValueKind kind, int64_t value) {
+    constexpr int64_t micros_per_day = 86400LL * 1000000LL;
+    int64_t days = value;
+    int64_t rem = 0;
+    if (kind != ValueKind::Date && value != TEMPORAL_INFINITY && value != TEMPORAL_NEG_INFINITY) {
+        days = value / micros_per_day;
+        rem = value % micros_per_day;
+        if (rem < 0) { rem += micros_per_day; --days; }
+    }
+
+    int64_t year = 0;
+    unsigned month = 0, day = 0;
+    if (value != TEMPORAL_INFINITY && value != TEMPORAL_NEG_INFINITY)
+        civil_from_days(days, year, month, day);
+
+    if (year < 1 || year > 9999) {
+        FastStringBuilder b;
+        append_temporal_text(b, kind, value);
+        return PyUnicode_FromStringAndSize(b.str().data(), static_cast<Py_ssize_t>(b.str().size()));
+    }
+
+    if (kind == ValueKind::Date)
+        return PyDate_FromDate(static_cast<int>(year), month, day);
+
+    const int hour = static_cast<int>(rem / 3600000000LL);
+    const int minute = static_cast<int>(rem / 60000000LL % 60);
+    const int second = static_cast<int>(rem / 1000000LL % 60);
+    const int usecond = static_cast<int>(rem % 1000000LL);
+    PyObject* tz = kind == ValueKind::TimestampTz ? PyDateTime_TimeZone_UTC : Py_None;
+    return PyDateTimeAPI->DateTime_FromDateAndTime(static_cast<int>(year), month, day,
+                                                   hour, minute, second, usecond,
+                                                   tz, PyDateTimeAPI->DateTimeType);
+}
+
+// Новая ссылка на Python-объект для ячейки col[i]
+static PyObject* cell_to_python(const ColumnData& col, size_t i) {
+    if (col.is_null(i)) {
+        Py_RETURN_NONE;
+    }
+    switch (col.kind) {
+        case ValueKind::Bool:
+            return PyBool_FromLong(col.bools[i]);
+        case ValueKind::Int64:
+            return PyLong_FromLongLong(col.ints[i]);
+        case ValueKind::Float64:
+            return PyFloat_FromDouble(col.doubles[i]);
+        case ValueKind::String: {
+            std::string_view s = col.string_at(i);
+            return PyUnicode_DecodeUTF8(s.data(), static_cast<Py_ssize_t>(s.size()), "replace");
+        }
+        case ValueKind::Timestamp:
+        case ValueKind::TimestampTz:
+        case ValueKind::Date:
+            return temporal_to_python(col.kind, col.ints[i]);
+        case ValueKind::Null:
+            break;
+    }
+    Py_RETURN_NONE;
+}
+
+// То же для колонок со словарём: по объекту str на значение словаря (cache),
+// строки с одинаковым значением получают ссылки на один объект
+static PyObject* cell_to_python(const ColumnData& col, size_t i, std::vector<py::object>& cache) {
+    if (!col.interned || col.is_null(i)) return cell_to_python(col, i);
+    if (cache.empty()) cache.resize(col.dictionary_size());
+    py::object& value = cache[col.codes[i]];
+    if (!value) {
+        PyObject* created = cell_to_python(col, i);
+        if (!created) return nullptr;
+        value = py::reinterpret_steal<py::object>(created);
+    }
+    return value.inc_ref().ptr();
+}
+
+static py::list rows_to_python(const QueryResult& result, RowFormat format) {
+    const size_t num_rows = result.row_count();
+    const size_t num_cols = std::min(result.columns.size(), result.data.size());
+
+    // Ключи словарей создаются один раз на весь результат
+    std::vector<py::str> keys;
+    if (format == RowFormat::Dict) {
+        keys.reserve(num_cols);
+        for (size_t j = 0; j < num_cols; ++j) {
+            keys.emplace_back(result.columns[j].name);
+        }
+    }
+
+    std::vector<std::vector<py::object>> interned(num_cols);
+
+    py::list rows(num_rows);
+    for (size_t i = 0; i < num_rows; ++i) {
+        PyObject* row = nullptr;
+
+        if (format == RowFormat::Dict) {
+            row = PyDict_New();
+            if (!row) throw py::error_already_set();
+            for (size_t j = 0; j < num_cols; ++j) {
+                PyObject* value = cell_to_python(result.data[j], i, interned[j]);
+                if (!value || PyDict_SetItem(row, keys[j].ptr(), value) < 0) {
+                    Py_XDECREF(value);
+                    Py_DECREF(row);
+                    throw py::error_already_set();
+                }
+                Py_DECREF(value);
+            }
+        } else {
+            row = PyTuple_New(static_cast<Py_ssize_t>(num_cols));
+            if (!row) throw py::error_already_set();
+            for (size_t j = 0; j < num_cols; ++j) {
+                PyObject* value = cell_to_python(result.data[j], i, interned[j]);
+                if (!value) {
+                    Py_DECREF(row);
+                    throw py::error_already_set();
+                }
+                PyTuple_SET_ITEM(row, static_cast<Py_ssize_t>(j), value);  // забирает ссылку
+            }
+        }
+
+        PyList_SET_ITEM(rows.ptr(), static_cast<Py_ssize_t>(i), row);  // забирает ссылку
+    }
+
+    return rows;
+}
+
+static py::list columns_to_python(const std::vector<ColumnInfo>& info) {
+    py::list columns(info.size());
+    for (size_t i = 0; i < info.size(); ++i) {
+        py::dict col;
+        col["name"] = info[i].name;
+        col["type"] = info[i].type;
+        columns[i] = std::move(col);
+    }
+    return columns;
+}
+
+// Тот же формат, что и у to_json(): {"rows": [...], "columns": [...], "count": N}
+py::dict query_result_to_python(const QueryResult& result, RowFormat format) {
+    py::dict out;
+    out["rows"] = rows_to_python(result, format);
+    out["columns"] = columns_to_python(result.columns);
+    out["count"] = result.count;
+    return out;
+}
+
+// -----------------------------------------------------------------------------
+// Потоковое чтение: итератор Python поверх пачек строк
+// -----------------------------------------------------------------------------
+
+template <typename Stream>
+struct PyBatchStream {
+    std::unique_ptr<Stream> stream;
+    RowFormat format;
+    std::mutex* call_mutex;     // мьютекс коннектора, которому принадлежит поток
+
+    // Чтение пачки — без GIL и под мьютексом коннектора
+    template <typename F>
+    auto without_gil(F&& work) {
+        py::gil_scoped_release release;
+        std::lock_guard<std::mutex> lock(*call_mutex);
+        return work();
+    }
+};
+
+using PyPostgresStream = PyBatchStream<PostgresStream>;
+using PyClickHouseStream = PyBatchStream<ClickHouseStream>;
+
+// Итератор по пачкам: каждая итерация отдаёт список строк очередной пачки
+template <typename Stream>
+static void bind_batch_stream(py::module_& m, const char* name) {
+    using Self = PyBatchStream<Stream>;
+    py::class_<Self>(m, name)
+        .def("__iter__", [](Self& self) -> Self& { return self; },
+             py::return_value_policy::reference_internal)
+        .def("__next__", [](Self& self) {
+            QueryResult batch;
+            bool has_rows = self.without_gil([&] { return self.stream->next_batch(batch); });
+            if (!has_rows) throw py::stop_iteration();
+            return rows_to_python(batch, self.format);
+        })
+        .def_property_readonly("columns", [](Self& self) {
+            std::vector<ColumnInfo> columns = self.without_gil([&] { return self.stream->columns(); });
+            return columns_to_python(columns);
+        })
+        .def("is_open", [](Self& self) { return self.stream->is_open(); })
+        .def("close", [](Self& self) { self.without_gil([&] { self.stream->close(); }); })
+        .def("__enter__", [](Self& self) -> Self& { return self; },
+             py::return_value_policy::reference_internal)
+        .def("__exit__", [](Self& self, py::args) { self.without_gil([&] { self.stream->close(); }); });
+}
+
+// Итератор кусков JSON (bytes) поверх потока: пачки читаются по мере выдачи кусков,
+// поэтому ответ HTTP можно отдавать, не собирая документ целиком
+template <typename Stream>
+struct PyJsonChunks {
+    std::unique_ptr<Stream> stream;
+    std::unique_ptr<JsonChunkReader> reader;
+    std::mutex* call_mutex;
+
+    template <typename F>
+    auto without_gil(F&& work) {
+        py::gil_scoped_release release;
+        std::lock_guard<std::mutex> lock(*call_mutex);
+        return work();
+    }
+};
+
+// Вызывается без GIL и под мьютексом коннектора: columns() ждёт ответа сервера
+template <typename Stream>
+static PyJsonChunks<Stream> make_json_chunks(std::unique_ptr<Stream> stream, std::mutex* call_mutex,
+                                             JsonFormat format, size_t chunk_size) {
+    Stream* source = stream.get();
+    auto reader = std::make_unique<JsonChunkReader>(
+        source->columns(), [source](QueryResult& batch) { return source->next_batch(batch); },
+        format, chunk_size);
+    return PyJsonChunks<Stream>{std::move(stream), std::move(reader), call_mutex};
+}
+
+template <typename Stream>
+static void bind_json_chunks(py::module_& m, const char* name) {
+    using Self = PyJsonChunks<Stream>;
+    py::class_<Self>(m, name)
+        .def("__iter__", [](Self& self) -> Self& { return self; },
+             py::return_value_policy::reference_internal)
+        .def("__next__", [](Self& self) {
+            std::string chunk;
+            bool has_chunk = self.without_gil([&] { return self.reader->next_chunk(chunk); });
+            if (!has_chunk) throw py::stop_iteration();
+            return py::bytes(chunk);
+        })
+        .def("close", [](Self& self) { self.without_gil([&] { self.stream->close(); }); })
+        .def("__enter__", [](Self& self) -> Self& { return self; },
+             py::return_value_policy::reference_internal)
+        .def("__exit__", [](Self& self, py::args) { self.without_gil([&] { self.stream->close(); }); });
+}
+
+// -----------------------------------------------------------------------------
+// Параметры запросов
+// -----------------------------------------------------------------------------
+
+// Значение Python -> параметр в текстовом формате PostgreSQL (None -> NULL)
+static std::optional<std::string> python_to_param(py::handle value) {
+    if (value.is_none()) return std::nullopt;
+    if (PyBool_Check(value.ptr())) return std::string(value.ptr() == Py_True ? "true" : "false");
+    if (py::isinstance<py::str>(value)) return value.cast<std::string>();
+    if (py::isinstance<py::bytes>(value)) {
+        // bytea в hex-формате
+        static const char hex[] = "0123456789abcdef";
+        std::string raw = value.cast<std::string>();
+        std::string out = "\\x";
+        out.reserve(2 + raw.size() * 2);
+        for (unsigned char c : raw) {
+            out.push_back(hex[c >> 4]);
+            out.push_back(hex[c & 0xF]);
+        }
+        return out;
+    }
+    if (py::hasattr(value, "isoformat")) return py::str(value.attr("isoformat")()).cast<std::string>();
+    return py::str(value).cast<std::string>();
+}
+
+static QueryParams python_to_params(py::handle params) {
+    QueryParams out;
+    for (py::handle item : params) {
+        out.push_back(python_to_param(item));
+    }
+    return out;
+}
+
+// -----------------------------------------------------------------------------
+// Данные Python → колонки QueryResult (copy_in)
+// -----------------------------------------------------------------------------
+
+// datetime.datetime / datetime.date → значение времени; false — это не дата
+static bool python_to_temporal(py::handle value, ValueKind& kind, int64_t& out) {
+    PyObject* o = value.ptr();
+    if (!PyDate_Check(o)) return false;
+
+    int64_t days = days_from_civil(PyDateTime_GET_YEAR(o), PyDateTime_GET_MONTH(o), PyDateTime_GET_DAY(o));
+    if (!PyDateTime_Check(o)) {
+        kind = ValueKind::Date;
+        out = days;
+        return true;
+    }
+
+    int64_t seconds = days * 86400LL + PyDateTime_DATE_GET_HOUR(o) * 3600LL +
+                      PyDateTime_DATE_GET_MINUTE(o) * 60LL + PyDateTime_DATE_GET_SECOND(o);
+    int64_t micros = seconds * 1000000LL + PyDateTime_DATE_GET_MICROSECOND(o);
+    py::object offset = value.attr("utcoffset")();
+    if (offset.is_none()) {
+        kind = ValueKind::Timestamp;
+    } else {
+        // Время с часовым поясом приводится к UTC
+        PyObject* d = offset.ptr();
+        micros -= (PyDateTime_DELTA_GET_DAYS(d) * 86400LL + PyDateTime_DELTA_GET_SECONDS(d)) * 1000000LL +
+                  PyDateTime_DELTA_GET_MICROSECONDS(d);
+        kind = ValueKind::TimestampTz;
+    }
+    out = micros;
+    return true;
+}
+
+// Целая колонка, в которую пришло дробное значение, становится Float64
+static void promote_to_double(ColumnData& column) {
+    column.doubles.assign(column.ints.begin(), column.ints.end());
+    column.ints.clear();
+    column.kind = ValueKind::Float64;
+}
+
+static void append_python_value(ColumnData& column, py::handle value) {
+    PyObject* o = value.ptr();
+    if (o == Py_None) {
+        column.append_null();
+    } else if (PyBool_Check(o)) {
+        column.append_bool(o == Py_True);
+    } else if (PyLong_Check(o)) {
+        if (column.kind == ValueKind::Float64) column.append_double(PyLong_AsDouble(o));
+        else column.append_int(value.cast<int64_t>());
+    } else if (PyFloat_Check(o)) {
+        if (column.kind == ValueKind::Int64) promote_to_double(column);
+        column.append_double(PyFloat_AS_DOUBLE(o));
+    } else if (PyUnicode_Check(o)) {
+        Py_ssize_t size = 0;
+        const char* data = PyUnicode_AsUTF8AndSize(o, &size);
+        if (!data) throw py::error_already_set();
+        column.append_string(std::string_view(data, static_cast<size_t>(size)));
+    } else if (PyBytes_Check(o)) {
+        column.append_string(std::string_view(PyBytes_AS_STRING(o), static_cast<size_t>(PyBytes_GET_SIZE(o))));
+    } else if (py::hasattr(value, "item") && !py::isinstance<py::array>(value)) {
+        append_python_value(column, value.attr("item")());   // скаляры NumPy
+    } else {
+        ValueKind kind = ValueKind::Null;
+        int64_t temporal = 0;
+        if (python_to_temporal(value, kind, temporal)) column.append_temporal(kind, temporal);
+        else column.append_string(py::str(value).cast<std::string>());
+    }
+}
+
+// Колонка NumPy: числовые массивы добавляются целым буфером, маска MaskedArray — как NULL
+static void append_numpy_column(ColumnData& column, py::handle values) {
+    py::module_ np = py::module_::import("numpy");
+    py::object ma = np.attr("ma");
+    py::object nulls = py::none();
+    py::object data = py::reinterpret_borrow<py::object>(values);
+    if (py::isinstance(values, ma.attr("MaskedArray"))) {
+        nulls = np.attr("ascontiguousarray")(ma.attr("getmaskarray")(values), py::arg("dtype") = "uint8");
+        data = values.attr("data");
+    }
+    auto null_ptr = [&]() -> const uint8_t* {
+        return nulls.is_none() ? nullptr : static_cast<const uint8_t*>(nulls.cast<py::array>().data());
+    };
+
+    py::array array = data.cast<py::array>();
+    const size_t n = static_cast<size_t>(array.size());
+    const char kind = array.dtype().kind();
+    if ((kind == 'i' || kind == 'u') && column.kind != ValueKind::Float64) {
+        py::array_t<int64_t, py::array::c_style | py::array::forcecast> ints(array);
+        column.append_ints(ints.data(), n, null_ptr());
+    } else if (kind == 'f' || kind == 'i' || kind == 'u') {
+        if (column.kind == ValueKind::Int64) promote_to_double(column);
+        py::array_t<double, py::array::c_style | py::array::forcecast> doubles(array);
+        column.append_doubles(doubles.data(), n, null_ptr());
+    } else if (kind == 'M') {
+        // datetime64: дни — date, остальные единицы — timestamp в микросекундах; NaT — NULL
+        bool days = py::str(array.dtype()).cast<std::string>() == "datetime64[D]";
+        py::array_t<int64_t, py::array::c_style> raw(
+            array.attr("astype")(days ? "datetime64[D]" : "datetime64[us]").attr("view")("int64"));
+        const uint8_t* mask = null_ptr();
+        const int64_t* v = raw.data();
+        for (size_t i = 0; i < n; ++i) {
+            if ((mask && mask[i]) || v[i] == INT64_MIN) column.append_null();
+            else column.append_temporal(days ? ValueKind::Date : ValueKind::Timestamp, v[i]);
+        }
+    } else {
+        py::list items = data.attr("tolist")();
+        const uint8_t* mask = null_ptr();
+        for (size_t i = 0; i < n; ++i) {
+            if (mask && mask[i]) column.append_null();
+            else append_python_value(column, items[i]);
+        }
+    }
+}
+
+static QueryResult copy_batch_columns(const std::vector<ColumnInfo>& columns) {
+    QueryResult batch;
+    for (const ColumnInfo& column : columns) batch.add_column(column.name, column.type);
+    return batch;
+}
+
+[[noreturn]] static void batch_failed(const char* method, const std::string& message) {
+    throw py::value_error(std::string(method) + ": " + message);
+}
+
+// Строки Python [begin, end) → колонки пачки
+static QueryResult python_rows_to_batch(const char* method, const py::sequence& rows, size_t begin, size_t end,
+                                        const std::vector<ColumnInfo>& columns) {
+    QueryResult batch = copy_batch_columns(columns);
+    for (ColumnData& data : batch.data) data.reserve(end - begin);
+    for (size_t i = begin; i < end; ++i) {
+        py::sequence row = rows[i];
+        if (static_cast<size_t>(py::len(row)) != columns.size()) {
+            batch_failed(method, "row " + std::to_string(i) + " has " + std::to_string(py::len(row)) +
+                                 " values, expected " + std::to_string(columns.size()));
+        }
+        for (size_t j = 0; j < columns.size(); ++j) append_python_value(batch.data[j], row[j]);
+    }
+    return batch;
+}
+
+// Одна пачка: список строк, dict колонок или двумерный ndarray.
+// Большие пачки передаются в send частями по batch_size строк
+template <typename Send>
+static void convert_python_batch(const char* method, py::handle rows, const std::vector<ColumnInfo>& columns,
+                                 size_t batch_size, Send&& send) {
+    if (py::isinstance<py::dict>(rows)) {
+        py::dict by_name = py::reinterpret_borrow<py::dict>(rows);
+        if (py::len(by_name) != columns.size()) batch_failed(method, "dict batch must have a value for every column");
+        QueryResult batch = copy_batch_columns(columns);
+        size_t length = 0;
+        for (size_t j = 0; j < columns.size(); ++j) {
+            py::str name(columns[j].name);
+            if (!by_name.contains(name)) batch_failed(method, "dict batch has no column '" + columns[j].name + "'");
+            py::object values = by_name[name];
+            if (py::isinstance<py::array>(values)) {
+                append_numpy_column(batch.data[j], values);
+            } else {
+                for (py::handle value : values) append_python_value(batch.data[j], value);
+            }
+            if (j > 0 && batch.data[j].size != length) batch_failed(method, "dict batch columns differ in length");
+            length = batch.data[j].size;
+        }
+        send(batch);
+        return;
+    }
+
+    if (py::isinstance<py::array>(rows)) {
+        py::array array = py::reinterpret_borrow<py::array>(rows);
+        if (array.ndim() != 2 || static_cast<size_t>(array.shape(1)) != columns.size()) {
+            batch_failed(method, "array batch must have shape (rows, " + std::to_string(columns.size()) + ")");
+        }
+        const size_t total = static_cast<size_t>(array.shape(0));
+        for (size_t begin = 0; begin < total; begin += batch_size) {
+            py::slice part(static_cast<py::ssize_t>(begin),
+                           static_cast<py::ssize_t>(std::min(total, begin + batch_size)), 1);
+            QueryResult batch = copy_batch_columns(columns);
+            for (size_t j = 0; j < columns.size(); ++j) {
+                py::object column = rows[py::make_tuple(part, py::int_(j))];
+                append_numpy_column(batch.data[j], column);
+            }
+            send(batch);
+        }
+        return;
+    }
+
+    py::sequence sequence = py::reinterpret_borrow<py::sequence>(rows);
+    const size_t total = static_cast<size_t>(py::len(sequence));
+    for (size_t begin = 0; begin < total; begin += batch_size) {
+        send(python_rows_to_batch(method, sequence, begin, std::min(total, begin + batch_size), columns));
+    }
+}
+
+// rows — одна пачка (список строк, dict колонок, ndarray) либо итератор таких пачек;
+// память ограничена одной частью пачки
+template <typename Send>
+static void for_each_python_batch(const char* method, py::handle rows, const std::vector<ColumnInfo>& columns,
+                                  size_t batch_size, Send&& send) {
+    if (batch_size == 0) batch_size = 1;
+    bool single = py::isinstance<py::list>(rows) || py::isinstance<py::tuple>(rows) ||
+                  py::isinstance<py::dict>(rows) || py::isinstance<py::array>(rows);
+    if (single) {
+        convert_python_batch(method, rows, columns, batch_size, send);
+    } else {
+        for (py::handle batch : rows) convert_python_batch(method, batch, columns, batch_size, send);
+    }
+}
+
+static std::vector<std::string> python_to_names(py::handle columns) {
+    if (columns.is_none()) return {};
+    return columns.cast<std::vector<std::string>>();
+}
+
+static uint64_t postgres_copy_in(PostgresConnector& self, const std::string& table, py::object columns,
+                                 py::object rows, std::optional<bool> binary, size_t batch_size) {
+    std::vector<std::string> names = python_to_names(columns);
+    std::unique_ptr<PostgresCopyIn> copy = without_gil(self, [&] { return self.copy_in(table, names, binary); });
+    try {
+        for_each_python_batch("copy_in", rows, copy->columns(), batch_size, [&](const QueryResult& batch) {
+            without_gil(self, [&] { copy->write(batch); });
+        });
+        return without_gil(self, [&] { return copy->finish(); });
+    } catch (...) {
+        without_gil(self, [&] { copy->abort(); });
+        throw;
+    }
+}
+
+// Открытая вставка ClickHouse; вызовы — без GIL и под мьютексом коннектора
+struct PyClickHouseInserter {
+    std::unique_ptr<ClickHouseInserter> inserter;
+    std::mutex* call_mutex;
+
+    template <typename F>
+    auto without_gil(F&& work) {
+        py::gil_scoped_release release;
+        std::lock_guard<std::mutex> lock(*call_mutex);
+        return work();
+    }
+
+    void write(py::handle rows, size_t batch_size) {
+        for_each_python_batch("write", rows, inserter->columns(), batch_size, [&](const QueryResult& batch) {
+            without_gil([&] { inserter->write(batch); });
+        });
+    }
+};
+
+static ClickHouseInsertOptions make_insert_options(size_t block_rows, size_t block_bytes,
+                                                   bool background, size_t queue_depth) {
+    ClickHouseInsertOptions options;
+    options.block_rows = block_rows;
+    options.block_bytes = block_bytes;
+    options.background = background;
+    options.queue_depth = queue_depth;
+    return options;
+}
+
+// Колонки вставки: явный список либо ключи dict-пачки
+static std::vector<std::string> insert_column_names(py::handle columns, py::handle rows) {
+    if (columns.is_none() && py::isinstance<py::dict>(rows)) {
+        std::vector<std::string> names;
+        for (auto item : py::reinterpret_borrow<py::dict>(rows)) names.push_back(py::str(item.first).cast<std::string>());
+        return names;
+    }
+    return python_to_names(columns);
+}
+
+static uint64_t clickhouse_insert(ClickHouseConnector& self, const std::string& table, py::object rows,
+                                  py::object columns, size_t block_rows, size_t block_bytes, size_t batch_size) {
+    std::vector<std::string> names = insert_column_names(columns, rows);
+    ClickHouseInsertOptions options = make_insert_options(block_rows, block_bytes, false, 1);
+    PyClickHouseInserter writer{without_gil(self, [&] { return self.inserter(table, names, options); }),
+                                &self.call_mutex()};
+    try {
+        writer.write(rows, batch_size);
+        return writer.without_gil([&] { return writer.inserter->close(); });
+    } catch (...) {
+        writer.without_gil([&] { writer.inserter->abort(); });
+        throw;
+    }
+}
+
+// Назначение copy_out: путь (str / os.PathLike), файловый дескриптор или файловый
+// объект с fileno() — его буфер Python сбрасывается перед записью в дескриптор
+static std::unique_ptr<FdSink> python_output_sink(py::handle dest) {
+    if (py::isinstance<py::int_>(dest)) return std::make_unique<FdSink>(dest.cast<int>());
+    if (py::hasattr(dest, "fileno")) {
+        if (py::hasattr(dest, "flush")) dest.attr("flush")();
+        return std::make_unique<FdSink>(dest.attr("fileno")().cast<int>());
+    }
+    std::string path = py::str(py::module_::import("os").attr("fspath")(dest)).cast<std::string>();
+    return FdSink::open(path);
+}
+
+template <typename Connector>
+static uint64_t connector_copy_out(Connector& self, const std::string& query, py::object dest,
+                                   const std::string& format, bool header) {
+    ExportFormat export_format = parse_export_format(format);
+    std::unique_ptr<FdSink> sink = python_output_sink(dest);
+    return without_gil(self, [&] {
+        uint64_t rows = self.copy_out(query, *sink, export_format, header);
+        sink->close();
+        return rows;
+    });
+}
+
+// -----------------------------------------------------------------------------
+// Экспорт колонок в NumPy без копирования
+// -----------------------------------------------------------------------------
+
+// Передаёт владение буфером массиву NumPy: вектор переезжает в capsule,
+// ndarray ссылается на его данные напрямую
+template <typename T>
+static py::array vector_to_numpy(std::vector<T>&& values, const py::dtype& dtype, size_t count) {
+    auto* holder = new std::vector<T>(std::move(values));
+    py::capsule owner(holder, [](void* p) { delete static_cast<std::vector<T>*>(p); });
+    return py::array(dtype, {count}, {sizeof(T)}, holder->data(), owner);
+}
+
+// Маска валидности (True — значение не NULL) из битовой маски колонки.
+// Биты копируются: col.validity ещё нужна cell_to_python для строковых колонок
+static py::array validity_to_numpy(const ColumnData& col) {
+    const size_t n = col.size;
+    py::array_t<uint8_t> packed(static_cast<py::ssize_t>((n + 7) / 8), col.validity.data());
+    py::module_ np = py::module_::import("numpy");
+    py::object bits = np.attr("unpackbits")(packed, py::arg("count") = n,
+                                            py::arg("bitorder") = "little");
+    return bits.attr("astype")(np.attr("bool_"));
+}
+
+// Значения колонки как ndarray. Числа и bool отдаются без копирования,
+// строки — массивом объектов str (None для NULL)
+static py::array column_values_to_numpy(ColumnData& col) {
+    const size_t n = col.size;
+    switch (col.kind) {
+        case ValueKind::Bool:
+            return vector_to_numpy(std::move(col.bools), py::dtype::of<bool>(), n);
+        case ValueKind::Int64:
+            return vector_to_numpy(std::move(col.ints), py::dtype::of<int64_t>(), n);
+        case ValueKind::Float64:
+            return vector_to_numpy(std::move(col.doubles), py::dtype::of<double>(), n);
+        case ValueKind::Timestamp:
+        case ValueKind::TimestampTz:
+            return vector_to_numpy(std::move(col.ints), py::dtype("datetime64[us]"), n);
+        case ValueKind::Date:
+            return vector_to_numpy(std::move(col.ints), py::dtype("datetime64[D]"), n);
+        case ValueKind::String:
+        case ValueKind::Null:
+            break;
+    }
+
+    py::array out(py::dtype("O"), {n});
+    auto** cells = static_cast<PyObject**>(out.mutable_data());
+    std::vector<py::object> interned;
+    for (size_t i = 0; i < n; ++i) {
+        PyObject* value = cell_to_python(col, i, interned);
+        if (!value) throw py::error_already_set();
+        Py_XSETREF(cells[i], value);
+    }
+    return out;
+}
+
+// {колонка: (values, valid)} — valid равен None, если в колонке нет NULL.
+// Маска строится до values: column_values_to_numpy забирает буферы колонки
+py::dict query_result_to_columns(QueryResult&& result) {
+    py::dict out;
+    const size_t num_cols = std::min(result.columns.size(), result.data.size());
+    for (size_t j = 0; j < num_cols; ++j) {
+        ColumnData& col = result.data[j];
+        py::object valid = py::none();
+        if (col.null_count > 0)
+            valid = validity_to_numpy(col);
+        py::array values = column_values_to_numpy(col);
+        out[py::str(result.columns[j].name)] = py::make_tuple(values, valid);
+    }
+    return out;
+}
+
+// {колонка: ndarray}; числовые колонки с NULL оборачиваются в numpy.ma.MaskedArray
+py::dict query_result_to_numpy(QueryResult&& result) {
+    py::dict out;
+    py::object masked_array;
+    const size_t num_cols = std::min(result.columns.size(), result.data.size());
+    for (size_t j = 0; j < num_cols; ++j) {
+        ColumnData& col = result.data[j];
+        py::object values;
+        if (col.null_count > 0 && col.kind != ValueKind::String && col.kind != ValueKind::Null) {
+            py::array valid = validity_to_numpy(col);
+            if (!masked_array)
+                masked_array = py::module_::import("numpy.ma").attr("MaskedArray");
+            values = masked_array(column_values_to_numpy(col),
+                                  py::arg("mask") = valid.attr("__invert__")());
+        } else {
+            values = column_values_to_numpy(col);
+        }
+        out[py::str(result.columns[j].name)] = values;
+    }
+    return out;
+}
+
+// -----------------------------------------------------------------------------
+// Экспорт в Arrow через PyCapsule-протокол (__arrow_c_stream__)
+// -----------------------------------------------------------------------------
+
+static void release_stream_capsule(PyObject* capsule) {
+    auto* stream = static_cast<ArrowArrayStream*>(
+        PyCapsule_GetPointer(capsule, "arrow_array_stream"));
+    if (!stream) {
+        PyErr_Clear();
+        return;
+    }
+    if (stream->release) stream->release(stream);
+    delete stream;
+}
+
+// Владелец ArrowArrayStream до передачи потребителю (pyarrow, polars, DuckDB)
+class PyArrowStream {
+    ArrowArrayStream stream_;
+
+public:
+    PyArrowStream() { std::memset(&stream_, 0, sizeof(stream_)); }
+    ~PyArrowStream() { if (stream_.release) stream_.release(&stream_); }
+    PyArrowStream(const PyArrowStream&) = delete;
+    PyArrowStream& operator=(const PyArrowStream&) = delete;
+
+    ArrowArrayStream* get() { return &stream_; }
+
+    // Переносит поток в out; сам объект после этого пуст
+    void move_to(ArrowArrayStream* out) {
+        if (!stream_.release) throw std::runtime_error("Arrow stream has already been consumed");
+        *out = stream_;
+        stream_.release = nullptr;
+    }
+
+    py::capsule to_capsule() {
+        auto* out = new ArrowArrayStream();
+        try {
+            move_to(out);
+        } catch (...) {
+            delete out;
+            throw;
+        }
+        return py::capsule(out, "arrow_array_stream", &release_stream_capsule);
+    }
+};
+
+// PostgresConnector.execute_pipeline: {"success", "error", "statements": [{"status", "affected_rows", "error"}]}
+static py::dict batch_result_to_python(const BatchResult& batch) {
+    py::list statements;
+    for (const BatchStatementResult& statement : batch.statements) {
+        py::dict item;
+        switch (statement.status) {
+            case BatchStatus::Ok: item["status"] = "ok"; break;
+            case BatchStatus::Failed: item["status"] = "failed"; break;
+            case BatchStatus::Skipped: item["status"] = "skipped"; break;
+        }
+        item["affected_rows"] = statement.affected_rows;
+        item["error"] = statement.error.empty() ? py::object(py::none()) : py::str(statement.error);
+        statements.append(std::move(item));
+    }
+    py::dict out;
+    out["success"] = batch.success;
+    out["error"] = batch.error.empty() ? py::object(py::none()) : py::str(batch.error);
+    out["statements"] = std::move(statements);
+    return out;
+}
+
+// PostgresConnector.execute / PostgresPool.execute
+static py::object postgres_execute(PostgresConnector& self, const std::string& query, py::object params,
+                                   const std::string& row_format, py::object count_mode) {
+    RowFormat format = parse_row_format(row_format);
+    CountMode mode = count_mode.is_none()
+        ? self.count_mode()
+        : parse_count_mode(count_mode.cast<std::string>());
+    std::optional<QueryParams> values;
+    if (!params.is_none()) values = python_to_params(params);
+    QueryResult result = without_gil(self, [&] {
+        return values ? self.execute(query, *values, mode) : self.execute(query, mode);
+    });
+    return query_result_to_python(result, format);
+}
+
+static py::object python_runtime_error(const std::exception& e) {
+    return py::reinterpret_borrow<py::object>(PyExc_RuntimeError)(e.what());
+}
+
+// PostgresConnector.execute_async: запрос отправляется сразу, ответ разбирается
+// колбэком loop.add_reader, когда сокет соединения готов к чтению.
+// Отмена задачи (task.cancel(), asyncio.wait_for) отменяет запрос на сервере
+static py::object postgres_execute_async(PostgresConnector& self, const std::string& query, py::object params,
+                                         const std::string& row_format, py::object count_mode) {
+    RowFormat format = parse_row_format(row_format);
+    CountMode mode = count_mode.is_none()
+        ? self.count_mode()
+        : parse_count_mode(count_mode.cast<std::string>());
+    std::optional<QueryParams> values;
+    if (!params.is_none()) values = python_to_params(params);
+
+    py::object loop = py::module_::import("asyncio").attr("get_running_loop")();
+    py::object future = loop.attr("create_future")();
+
+    without_gil(self, [&] { self.send_async(query, values ? &*values : nullptr, mode); });
+    const int fd = self.socket();
+    // Колбэки держат Python-объект коннектора, пока запрос не завершён
+    py::object owner = py::cast(&self, py::return_value_policy::reference);
+
+    loop.attr("add_reader")(fd, py::cpp_function([owner, loop, future, fd, format]() {
+        if (future.attr("done")().cast<bool>()) {
+            loop.attr("remove_reader")(fd);
+            return;
+        }
+        PostgresConnector& conn = owner.cast<PostgresConnector&>();
+        try {
+            std::optional<QueryResult> result = without_gil(conn, [&]() -> std::optional<QueryResult> {
+                if (!conn.poll_async()) return std::nullopt;
+                return conn.take_async_result();
+            });
+            if (!result) return;
+            loop.attr("remove_reader")(fd);
+            future.attr("set_result")(query_result_to_python(*result, format));
+        } catch (const std::exception& e) {
+            loop.attr("remove_reader")(fd);
+            future.attr("set_exception")(python_runtime_error(e));
+        }
+    }));
+
+    future.attr("add_done_callback")(py::cpp_function([owner, loop, fd](py::object done) {
+        if (!done.attr("cancelled")().cast<bool>()) return;
+        loop.attr("remove_reader")(fd);
+        PostgresConnector& conn = owner.cast<PostgresConnector&>();
+        without_gil(conn, [&] { conn.cancel_async(); });
+    }));
+    return future;
+}
+
+// ClickHouseConnector.execute_async: clickhouse-cpp не имеет неблокирующего API,
+// поэтому запрос выполняется в пуле потоков цикла событий (run_in_executor)
+static py::object clickhouse_execute_async(ClickHouseConnector& self, const std::string& query,
+                                           const std::string& row_format) {
+    RowFormat format = parse_row_format(row_format);
+    py::object loop = py::module_::import("asyncio").attr("get_running_loop")();
+    py::object owner = py::cast(&self, py::return_value_policy::reference);
+
+    py::cpp_function work([owner, query, format]() -> py::object {
+        ClickHouseConnector& conn = owner.cast<ClickHouseConnector&>();
+        QueryResult result = without_gil(conn, [&] { return conn.execute(query); });
+        return query_result_to_python(result, format);
+    });
+    return loop.attr("run_in_executor")(py::none(), work);
+}
+
+static std::chrono::milliseconds seconds_to_ms(double seconds) {
+    return std::chrono::milliseconds(static_cast<int64_t>(seconds * 1000.0));
+}
+
+// TTL кэша результатов в секундах; None — TTL кэша по умолчанию
+static std::chrono::milliseconds cache_ttl(py::object ttl) {
+    return ttl.is_none() ? std::chrono::milliseconds(0) : seconds_to_ms(ttl.cast<double>());
+}
+
+static py::dict cache_stats_to_python(const ResultCacheStats& stats) {
+    py::dict out;
+    out["hits"] = stats.hits;
+    out["misses"] = stats.misses;
+    out["coalesced"] = stats.coalesced;
+    out["evictions"] = stats.evictions;
+    out["expirations"] = stats.expirations;
+    out["entries"] = stats.entries;
+    out["bytes"] = stats.bytes;
+    return out;
+}
+
+// Ожидание соединения — без GIL, иначе поток, держащий аренду, не сможет её вернуть
+template <typename Pool>
+static typename Pool::Lease acquire_lease(Pool& pool, py::object timeout) {
+    std::optional<std::chrono::milliseconds> wait;
+    if (!timeout.is_none()) wait = seconds_to_ms(timeout.cast<double>());
+    py::gil_scoped_release release;
+    return wait ? pool.acquire(*wait) : pool.acquire();
 }
 
 PYBIND11_MODULE(sql_executor, m) {
     m.doc() = "Python bindings for SQL Executor";
 
+    PyDateTime_IMPORT;
+
+    py::class_<PyArrowStream>(m, "ArrowStream")
+        .def("__arrow_c_stream__", [](PyArrowStream& self, py::object /*requested_schema*/) {
+            return self.to_capsule();
+        }, py::arg("requested_schema") = py::none())
+        .def("_export_to_c", [](PyArrowStream& self, uintptr_t out_ptr) {
+            self.move_to(reinterpret_cast<ArrowArrayStream*>(out_ptr));
+        }, py::arg("out_ptr"))
+        .def("to_pyarrow", [](PyArrowStream& self) {
+            ArrowArrayStream tmp;
+            self.move_to(&tmp);
+            try {
+                py::object reader = py::module_::import("pyarrow").attr("RecordBatchReader");
+                return reader.attr("_import_from_c")(reinterpret_cast<uintptr_t>(&tmp));
+            } catch (...) {
+                if (tmp.release) tmp.release(&tmp);
+                throw;
+            }
+        });
+
+    bind_batch_stream<PostgresStream>(m, "PostgresStream");
+    bind_batch_stream<ClickHouseStream>(m, "ClickHouseStream");
+    bind_json_chunks<PostgresStream>(m, "PostgresJsonChunks");
+    bind_json_chunks<ClickHouseStream>(m, "ClickHouseJsonChunks");
+
+    py::class_<ResultCache, std::shared_ptr<ResultCache>>(m, "ResultCache")
+        .def(py::init([](size_t max_bytes, double ttl) {
+            return std::make_shared<ResultCache>(max_bytes, seconds_to_ms(ttl));
+        }), py::arg("max_bytes") = ResultCache::DEFAULT_MAX_BYTES, py::arg("ttl") = 5.0)
+        .def("stats", [](const ResultCache& self) { return cache_stats_to_python(self.stats()); })
+        .def("clear", &ResultCache::clear)
+        .def("max_bytes", &ResultCache::max_bytes);
+
     py::class_<PostgresConnector>(m, "PostgresConnector")
         .def(py::init<>())
-        .def("connect", &PostgresConnector::connect, py::arg("conninfo"))
-        .def("disconnect", &PostgresConnector::disconnect)
+        .def("connect", [](PostgresConnector& self, const std::string& conninfo) {
+            return without_gil(self, [&] { return self.connect(conninfo); });
+        }, py::arg("conninfo"))
+        .def("disconnect", [](PostgresConnector& self) {
+            without_gil(self, [&] { self.disconnect(); });
+        })
         .def("is_connected", &PostgresConnector::is_connected)
-        .def("execute", [](PostgresConnector& self, const std::string& query) {
-            std::string json_result = self.execute_to_json(query);
-            return json_string_to_python_dict(json_result);
-        }, py::arg("query"))
-        .def("begin_transaction", &PostgresConnector::begin_transaction)
-        .def("get_current_transaction_id", &PostgresConnector::get_current_transaction_id)
-        .def("commit_transaction", &PostgresConnector::commit_transaction)
-        .def("rollback_transaction", &PostgresConnector::rollback_transaction)
+        .def("ping", [](PostgresConnector& self) { return without_gil(self, [&] { return self.ping(); }); })
+        .def("set_binary_results", &PostgresConnector::set_binary_results, py::arg("enabled"))
+        .def("binary_results", &PostgresConnector::binary_results)
+        .def("set_intern_strings", &PostgresConnector::set_intern_strings, py::arg("enabled"))
+        .def("intern_strings", &PostgresConnector::intern_strings)
+        .def("set_count_mode", [](PostgresConnector& self, const std::string& mode) {
+            self.set_count_mode(parse_count_mode(mode));
+        }, py::arg("mode"))
+        .def("count_mode", [](PostgresConnector& self) { return count_mode_name(self.count_mode()); })
+        .def("set_result_cache", [](PostgresConnector& self, std::shared_ptr<ResultCache> cache, py::object ttl) {
+            auto ms = cache_ttl(ttl);
+            without_gil(self, [&] { self.set_result_cache(std::move(cache), ms); });
+        }, py::arg("cache"), py::arg("ttl") = py::none())
+        .def("result_cache", &PostgresConnector::result_cache)
+        .def("set_preload_types", &PostgresConnector::set_preload_types, py::arg("enabled"))
+        .def("preload_types", &PostgresConnector::preload_types)
+        .def("refresh_types", [](PostgresConnector& self) {
+            return without_gil(self, [&] { return self.refresh_types(); });
+        })
+        .def("type_info", [](PostgresConnector& self, Oid type_oid) -> py::object {
+            std::optional<PgTypeInfo> info = without_gil(self, [&] { return self.type_info(type_oid); });
+            if (!info) return py::none();
+            py::dict out;
+            out["name"] = info->name;
+            out["element"] = info->element;
+            out["base_type"] = info->base_type;
+            out["category"] = std::string(1, info->category);
+            out["kind"] = std::string(1, info->kind);
+            return std::move(out);
+        }, py::arg("oid"))
+        .def("execute", &postgres_execute, py::arg("query"), py::arg("params") = py::none(),
+             py::arg("row_format") = "dict", py::arg("count_mode") = py::none())
+        .def("execute_async", &postgres_execute_async, py::arg("query"), py::arg("params") = py::none(),
+             py::arg("row_format") = "dict", py::arg("count_mode") = py::none())
+        .def("prepare", [](PostgresConnector& self, const std::string& name, const std::string& query) {
+            return without_gil(self, [&] { return self.prepare(name, query); });
+        }, py::arg("name"), py::arg("query"))
+        .def("execute_prepared", [](PostgresConnector& self, const std::string& name,
+                                    py::object params, const std::string& row_format) {
+            RowFormat format = parse_row_format(row_format);
+            QueryParams values = params.is_none() ? QueryParams{} : python_to_params(params);
+            QueryResult result = without_gil(self, [&] { return self.execute_prepared(name, values); });
+            return query_result_to_python(result, format);
+        }, py::arg("name"), py::arg("params") = py::none(), py::arg("row_format") = "dict")
+        .def("stream", [](PostgresConnector& self, const std::string& query, size_t batch_size,
+                          const std::string& row_format) {
+            RowFormat format = parse_row_format(row_format);
+            auto stream = without_gil(self, [&] { return self.stream(query, batch_size); });
+            return PyPostgresStream{std::move(stream), format, &self.call_mutex()};
+        }, py::arg("query"), py::arg("batch_size") = 1000, py::arg("row_format") = "dict",
+           py::keep_alive<0, 1>())
+        .def("stream_json", [](PostgresConnector& self, const std::string& query, const std::string& format,
+                               size_t chunk_size, size_t batch_size) {
+            JsonFormat json_format = parse_json_format(format);
+            return without_gil(self, [&] {
+                return make_json_chunks(self.stream(query, batch_size), &self.call_mutex(), json_format, chunk_size);
+            });
+        }, py::arg("query"), py::arg("format") = "json", py::arg("chunk_size") = 65536,
+           py::arg("batch_size") = 1000, py::keep_alive<0, 1>())
+        .def("stream_arrow", [](PostgresConnector& self, const std::string& query, size_t batch_size) {
+            auto stream = std::make_unique<PyArrowStream>();
+            without_gil(self, [&] { self.stream_arrow(query, batch_size, stream->get()); });
+            return stream;
+        }, py::arg("query"), py::arg("batch_size") = 65536, py::keep_alive<0, 1>())
+        .def("copy_in", &postgres_copy_in, py::arg("table"), py::arg("columns"), py::arg("rows"),
+             py::arg("binary") = py::none(), py::arg("batch_size") = 65536)
+        .def("copy_out", &connector_copy_out<PostgresConnector>, py::arg("query"), py::arg("dest"),
+             py::arg("format") = "csv", py::arg("header") = false)
+        .def("set_statement_cache_size", [](PostgresConnector& self, size_t size) {
+            without_gil(self, [&] { self.set_statement_cache_size(size); });
+        }, py::arg("size"))
+        .def("statement_cache_size", &PostgresConnector::statement_cache_size)
+        .def("clear_statement_cache", [](PostgresConnector& self) {
+            without_gil(self, [&] { self.clear_statement_cache(); });
+        })
+        .def("begin_transaction", [](PostgresConnector& self) {
+            return without_gil(self, [&] { return self.begin_transaction(); });
+        })
+        .def("get_current_transaction_id", [](PostgresConnector& self) {
+            return without_gil(self, [&] { return self.get_current_transaction_id(); });
+        })
+        .def("commit_transaction", [](PostgresConnector& self) {
+            return without_gil(self, [&] { return self.commit_transaction(); });
+        })
+        .def("rollback_transaction", [](PostgresConnector& self) {
+            return without_gil(self, [&] { return self.rollback_transaction(); });
+        })
         .def("is_in_transaction", &PostgresConnector::is_in_transaction)
-        .def("execute_batch", &PostgresConnector::execute_batch, py::arg("queries"));
+        .def("execute_numpy", [](PostgresConnector& self, const std::string& query) {
+            QueryResult result = without_gil(self, [&] { return self.execute(query); });
+            return query_result_to_numpy(std::move(result));
+        }, py::arg("query"))
+        .def("execute_columns", [](PostgresConnector& self, const std::string& query) {
+            QueryResult result = without_gil(self, [&] { return self.execute(query); });
+            return query_result_to_columns(std::move(result));
+        }, py::arg("query"))
+        .def("execute_json", [](PostgresConnector& self, const std::string& query, size_t parallel_min_rows) {
+            JsonParallelOptions options;
+            options.min_rows = parallel_min_rows;
+            std::string json = without_gil(self, [&] { return self.execute_to_json(query, options); });
+            return py::bytes(json);
+        }, py::arg("query"), py::arg("parallel_min_rows") = JsonParallelOptions().min_rows)
+        .def("execute_arrow", [](PostgresConnector& self, const std::string& query) {
+            auto stream = std::make_unique<PyArrowStream>();
+            without_gil(self, [&] { self.execute_arrow(query, stream->get()); });
+            return stream;
+        }, py::arg("query"))
+        .def("execute_batch", [](PostgresConnector& self, const std::vector<std::string>& queries) {
+            return without_gil(self, [&] { return self.execute_batch(queries); });
+        }, py::arg("queries"))
+        .def("execute_pipeline", [](PostgresConnector& self, const std::vector<std::string>& queries) {
+            BatchResult batch = without_gil(self, [&] { return self.execute_pipeline(queries); });
+            return batch_result_to_python(batch);
+        }, py::arg("queries"));
+
+    py::class_<PostgresPool::Lease>(m, "PostgresLease")
+        .def_property_readonly("connection", [](PostgresPool::Lease& self) -> PostgresConnector& {
+            return *self;
+        }, py::return_value_policy::reference_internal)
+        .def("release", &PostgresPool::Lease::release)
+        .def("__enter__", [](PostgresPool::Lease& self) -> PostgresConnector& { return *self; },
+             py::return_value_policy::reference_internal)
+        .def("__exit__", [](PostgresPool::Lease& self, py::args) { self.release(); });
+
+    py::class_<PostgresPool>(m, "PostgresPool")
+        .def(py::init([](const std::string& conninfo, size_t size, double timeout,
+                         double health_check_after, bool binary_results, const std::string& count_mode,
+                         bool intern_strings, bool preload_types, std::shared_ptr<ResultCache> result_cache,
+                         py::object result_cache_ttl) {
+            PostgresPoolOptions options;
+            options.size = size;
+            options.acquire_timeout = seconds_to_ms(timeout);
+            options.health_check_after = seconds_to_ms(health_check_after);
+            options.binary_results = binary_results;
+            options.count_mode = parse_count_mode(count_mode);
+            options.intern_strings = intern_strings;
+            options.preload_types = preload_types;
+            options.result_cache = std::move(result_cache);
+            options.result_cache_ttl = cache_ttl(result_cache_ttl);
+            py::gil_scoped_release release;
+            return std::make_unique<PostgresPool>(conninfo, options);
+        }), py::arg("conninfo"), py::arg("size") = 4, py::arg("timeout") = 5.0,
+            py::arg("health_check_after") = 30.0, py::arg("binary_results") = false,
+            py::arg("count_mode") = "exact", py::arg("intern_strings") = false,
+            py::arg("preload_types") = false, py::arg("result_cache") = py::none(),
+            py::arg("result_cache_ttl") = py::none())
+        .def("acquire", &acquire_lease<PostgresPool>, py::arg("timeout") = py::none(),
+             py::keep_alive<0, 1>())
+        .def("execute", [](PostgresPool& self, const std::string& query, py::object params,
+                           const std::string& row_format, py::object count_mode) {
+            PostgresPool::Lease lease = acquire_lease(self, py::none());
+            return postgres_execute(*lease, query, params, row_format, count_mode);
+        }, py::arg("query"), py::arg("params") = py::none(), py::arg("row_format") = "dict",
+           py::arg("count_mode") = py::none())
+        .def("size", &PostgresPool::size)
+        .def("idle", &PostgresPool::idle)
+        .def("in_use", &PostgresPool::in_use)
+        .def("close", &PostgresPool::close);
 
     py::class_<ClickHouseConnector>(m, "ClickHouseConnector")
         .def(py::init<>())
-        .def("connect", &ClickHouseConnector::connect,
+        .def("connect", [](ClickHouseConnector& self, const std::string& host, int port,
+                           const std::string& database, const std::string& user, const std::string& password) {
+            return without_gil(self, [&] { return self.connect(host, port, database, user, password); });
+        },
              py::arg("host"), py::arg("port"), 
              py::arg("database") = "default", 
              py::arg("user") = "default", 
              py::arg("password") = "")
-        .def("disconnect", &ClickHouseConnector::disconnect)
+        .def("disconnect", [](ClickHouseConnector& self) {
+            without_gil(self, [&] { self.disconnect(); });
+        })
         .def("is_connected", &ClickHouseConnector::is_connected)
-        .def("execute", [](ClickHouseConnector& self, const std::string& query) {
-            std::string json_result = self.execute_to_json(query);
-            return json_string_to_python_dict(json_result);
-        }, py::arg("query"));
+        .def("ping", [](ClickHouseConnector& self) { return without_gil(self, [&] { return self.ping(); }); })
+        .def("execute", [](ClickHouseConnector& self, const std::string& query,
+                           const std::string& row_format) {
+            RowFormat format = parse_row_format(row_format);
+            QueryResult result = without_gil(self, [&] { return self.execute(query); });
+            return query_result_to_python(result, format);
+        }, py::arg("query"), py::arg("row_format") = "dict")
+        .def("execute_async", &clickhouse_execute_async, py::arg("query"), py::arg("row_format") = "dict")
+        .def("execute_numpy", [](ClickHouseConnector& self, const std::string& query) {
+            QueryResult result = without_gil(self, [&] { return self.execute(query); });
+            return query_result_to_numpy(std::move(result));
+        }, py::arg("query"))
+        .def("execute_columns", [](ClickHouseConnector& self, const std::string& query) {
+            QueryResult result = without_gil(self, [&] { return self.execute(query); });
+            return query_result_to_columns(std::move(result));
+        }, py::arg("query"))
+        .def("execute_json", [](ClickHouseConnector& self, const std::string& query, size_t parallel_min_rows) {
+            JsonParallelOptions options;
+            options.min_rows = parallel_min_rows;
+            std::string json = without_gil(self, [&] { return self.execute_to_json(query, options); });
+            return py::bytes(json);
+        }, py::arg("query"), py::arg("parallel_min_rows") = JsonParallelOptions().min_rows)
+        .def("execute_arrow", [](ClickHouseConnector& self, const std::string& query) {
+            auto stream = std::make_unique<PyArrowStream>();
+            without_gil(self, [&] { self.execute_arrow(query, stream->get()); });
+            return stream;
+        }, py::arg("query"))
+        .def("stream", [](ClickHouseConnector& self, const std::string& query, size_t batch_rows,
+                          size_t queue_depth, const std::string& row_format) {
+            RowFormat format = parse_row_format(row_format);
+            auto stream = without_gil(self, [&] { return self.stream(query, batch_rows, queue_depth); });
+            return PyClickHouseStream{std::move(stream), format, &self.call_mutex()};
+        }, py::arg("query"), py::arg("batch_rows") = 65536, py::arg("queue_depth") = 4,
+           py::arg("row_format") = "dict", py::keep_alive<0, 1>())
+        .def("stream_json", [](ClickHouseConnector& self, const std::string& query, const std::string& format,
+                               size_t chunk_size, size_t batch_rows) {
+            JsonFormat json_format = parse_json_format(format);
+            return without_gil(self, [&] {
+                return make_json_chunks(self.stream(query, batch_rows), &self.call_mutex(), json_format, chunk_size);
+            });
+        }, py::arg("query"), py::arg("format") = "json", py::arg("chunk_size") = 65536,
+           py::arg("batch_rows") = 65536, py::keep_alive<0, 1>())
+        .def("set_result_cache", [](ClickHouseConnector& self, std::shared_ptr<ResultCache> cache, py::object ttl) {
+            auto ms = cache_ttl(ttl);
+            without_gil(self, [&] { self.set_result_cache(std::move(cache), ms); });
+        }, py::arg("cache"), py::arg("ttl") = py::none())
+        .def("result_cache", &ClickHouseConnector::result_cache)
+        .def("stream_arrow", [](ClickHouseConnector& self, const std::string& query, size_t batch_rows) {
+            auto stream = std::make_unique<PyArrowStream>();
+            without_gil(self, [&] { self.stream_arrow(query, batch_rows, stream->get()); });
+            return stream;
+        }, py::arg("query"), py::arg("batch_rows") = 65536, py::keep_alive<0, 1>())
+        .def("insert", &clickhouse_insert, py::arg("table"), py::arg("rows"), py::arg("columns") = py::none(),
+             py::arg("block_rows") = 1048576, py::arg("block_bytes") = 64 << 20, py::arg("batch_size") = 65536)
+        .def("inserter", [](ClickHouseConnector& self, const std::string& table, py::object columns,
+                            size_t block_rows, size_t block_bytes, bool background, size_t queue_depth) {
+            std::vector<std::string> names = python_to_names(columns);
+            ClickHouseInsertOptions options = make_insert_options(block_rows, block_bytes, background, queue_depth);
+            auto writer = without_gil(self, [&] { return self.inserter(table, names, options); });
+            return PyClickHouseInserter{std::move(writer), &self.call_mutex()};
+        }, py::arg("table"), py::arg("columns") = py::none(), py::arg("block_rows") = 1048576,
+           py::arg("block_bytes") = 64 << 20, py::arg("background") = true, py::arg("queue_depth") = 2,
+           py::keep_alive<0, 1>())
+        .def("copy_out", &connector_copy_out<ClickHouseConnector>, py::arg("query"), py::arg("dest"),
+             py::arg("format") = "csv", py::arg("header") = false);
+
+    py::class_<PyClickHouseInserter>(m, "ClickHouseInserter")
+        .def("write", &PyClickHouseInserter::write, py::arg("rows"), py::arg("batch_size") = 65536)
+        .def("flush", [](PyClickHouseInserter& self) { self.without_gil([&] { self.inserter->flush(); }); })
+        .def("close", [](PyClickHouseInserter& self) {
+            return self.without_gil([&] { return self.inserter->close(); });
+        })
+        .def("abort", [](PyClickHouseInserter& self) { self.without_gil([&] { self.inserter->abort(); }); })
+        .def("is_open", [](PyClickHouseInserter& self) { return self.inserter->is_open(); })
+        .def_property_readonly("columns", [](PyClickHouseInserter& self) {
+            return columns_to_python(self.inserter->columns());
+        })
+        .def("__enter__", [](PyClickHouseInserter& self) -> PyClickHouseInserter& { return self; },
+             py::return_value_policy::reference_internal)
+        .def("__exit__", [](PyClickHouseInserter& self, py::object type, py::object, py::object) {
+            // Блок with завершился исключением — недописанные блоки не отправляются
+            if (type.is_none()) self.without_gil([&] { self.inserter->close(); });
+            else self.without_gil([&] { self.inserter->abort(); });
+        });
+
+    py::class_<ClickHousePool::Lease>(m, "ClickHouseLease")
+        .def_property_readonly("connection", [](ClickHousePool::Lease& self) -> ClickHouseConnector& {
+            return *self;
+        }, py::return_value_policy::reference_internal)
+        .def("release", &ClickHousePool::Lease::release)
+        .def("__enter__", [](ClickHousePool::Lease& self) -> ClickHouseConnector& { return *self; },
+             py::return_value_policy::reference_internal)
+        .def("__exit__", [](ClickHousePool::Lease& self, py::args) { self.release(); });
+
+    py::class_<ClickHousePool>(m, "ClickHousePool")
+        .def(py::init([](const std::string& host, int port, const std::string& database,
+                         const std::string& user, const std::string& password, size_t size,
+                         double timeout, double health_check_after, double idle_timeout,
+                         std::shared_ptr<ResultCache> result_cache, py::object result_cache_ttl) {
+            ClickHouseEndpoint endpoint{host, port, database, user, password};
+            ClickHousePoolOptions options;
+            options.size = size;
+            options.acquire_timeout = seconds_to_ms(timeout);
+            options.health_check_after = seconds_to_ms(health_check_after);
+            options.idle_timeout = seconds_to_ms(idle_timeout);
+            options.result_cache = std::move(result_cache);
+            options.result_cache_ttl = cache_ttl(result_cache_ttl);
+            py::gil_scoped_release release;
+            return std::make_unique<ClickHousePool>(endpoint, options);
+        }), py::arg("host"), py::arg("port"), py::arg("database") = "default",
+            py::arg("user") = "default", py::arg("password") = "", py::arg("size") = 4,
+            py::arg("timeout") = 5.0, py::arg("health_check_after") = 30.0,
+            py::arg("idle_timeout") = 300.0, py::arg("result_cache") = py::none(),
+            py::arg("result_cache_ttl") = py::none())
+        .def("acquire", &acquire_lease<ClickHousePool>, py::arg("timeout") = py::none(),
+             py::keep_alive<0, 1>())
+        .def("execute", [](ClickHousePool& self, const std::string& query, const std::string& row_format) {
+            RowFormat format = parse_row_format(row_format);
+            QueryResult result;
+            {
+                py::gil_scoped_release release;
+                result = self.execute(query);
+            }
+            return query_result_to_python(result, format);
+        }, py::arg("query"), py::arg("row_format") = "dict")
+        .def("execute_many", [](ClickHousePool& self, const std::vector<std::string>& queries,
+                                const std::string& row_format) {
+            RowFormat format = parse_row_format(row_format);
+            std::vector<QueryResult> results;
+            {
+                py::gil_scoped_release release;
+                results = self.execute_many(queries);
+            }
+            py::list out;
+            for (const QueryResult& result : results) out.append(query_result_to_python(result, format));
+            return out;
+        }, py::arg("queries"), py::arg("row_format") = "dict")
+        .def("size", &ClickHousePool::size)
+        .def("idle", &ClickHousePool::idle)
+        .def("in_use", &ClickHousePool::in_use)
+        .def("close", &ClickHousePool::close);
 }
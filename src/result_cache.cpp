@@ -0,0 +1,217 @@
+#include "result_cache.h"
+#include <cctype>
+#include <exception>
+#include <utility>
+
+ResultCache::ResultCache(size_t max_bytes, std::chrono::milliseconds default_ttl)
+    : max_bytes_(max_bytes), default_ttl_(default_ttl) {}
+
+std::shared_ptr<const QueryResult> ResultCache::get_or_load(const std::string& key, const Loader& load,
+                                                            std::chrono::milliseconds ttl) {
+    std::promise<ResultPtr> promise;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        auto it = entries_.find(key);
+        if (it != entries_.end()) {
+            if (Clock::now() < it->second.expires) {
+                lru_.splice(lru_.begin(), lru_, it->second.lru);
+                ++stats_.hits;
+                return it->second.result;
+            }
+            erase(it);
+            ++stats_.expirations;
+        }
+
+        auto pending = in_flight_.find(key);
+        if (pending != in_flight_.end()) {
+            std::shared_future<ResultPtr> result = pending->second;
+            ++stats_.coalesced;
+            lock.unlock();
+            return result.get();   // ошибка первого выполнения выбрасывается и здесь
+        }
+
+        in_flight_.emplace(key, promise.get_future().share());
+        ++stats_.misses;
+    }
+
+    ResultPtr result;
+    try {
+        result = std::make_shared<const QueryResult>(load());
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        in_flight_.erase(key);
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    in_flight_.erase(key);
+    store(key, result, ttl.count() > 0 ? ttl : default_ttl_);
+    promise.set_value(result);
+    return result;
+}
+
+void ResultCache::store(const std::string& key, ResultPtr result, std::chrono::milliseconds ttl) {
+    const size_t bytes = result_bytes(*result) + key.size();
+    if (bytes > max_bytes_) return;
+
+    auto it = entries_.find(key);
+    if (it != entries_.end()) erase(it);
+    while (!lru_.empty() && stats_.bytes + bytes > max_bytes_) {
+        erase(entries_.find(lru_.back()));
+        ++stats_.evictions;
+    }
+
+    lru_.push_front(key);
+    Entry& entry = entries_[key];
+    entry.result = std::move(result);
+    entry.bytes = bytes;
+    entry.expires = Clock::now() + ttl;
+    entry.lru = lru_.begin();
+    stats_.bytes += bytes;
+    stats_.entries = entries_.size();
+}
+
+void ResultCache::erase(std::unordered_map<std::string, Entry>::iterator it) {
+    stats_.bytes -= it->second.bytes;
+    lru_.erase(it->second.lru);
+    entries_.erase(it);
+    stats_.entries = entries_.size();
+}
+
+void ResultCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    lru_.clear();
+    stats_.entries = 0;
+    stats_.bytes = 0;
+}
+
+ResultCacheStats ResultCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+size_t ResultCache::max_bytes() const {
+    return max_bytes_;
+}
+
+std::chrono::milliseconds ResultCache::default_ttl() const {
+    return default_ttl_;
+}
+
+// -------------------------
+// Ключи
+// -------------------------
+
+std::string ResultCache::make_key(const std::string& target, const std::string& query,
+                                  const std::string& variant) {
+    std::string normalized = normalize_query(query);
+    std::string key;
+    key.reserve(target.size() + variant.size() + normalized.size() + 2);
+    key += target;
+    key.push_back('\n');
+    key += variant;
+    key.push_back('\n');
+    key += normalized;
+    return key;
+}
+
+std::string ResultCache::normalize_query(const std::string& query) {
+    // Пробелы внутри запроса не трогаем: в комментариях, $$-строках и строках с \'
+    // схлопывание меняет смысл, а разбор этих правил различается между СУБД
+    size_t begin = 0;
+    size_t end = query.size();
+    while (begin < end && std::isspace(static_cast<unsigned char>(query[begin]))) ++begin;
+    while (end > begin && (std::isspace(static_cast<unsigned char>(query[end - 1])) || query[end - 1] == ';')) --end;
+    return query.substr(begin, end - begin);
+}
+
+namespace {
+
+bool is_word_char(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+// Слово word (в верхнем регистре) с позиции i, целиком, без учёта регистра
+bool keyword_at(const std::string& query, size_t i, const char* word) {
+    size_t j = 0;
+    for (; word[j]; ++j) {
+        if (i + j >= query.size() ||
+            std::toupper(static_cast<unsigned char>(query[i + j])) != word[j]) return false;
+    }
+    return i + j == query.size() || !is_word_char(query[i + j]);
+}
+
+// Есть ли вне строк, идентификаторов в кавычках и комментариев изменяющие данные
+// или блокирующие слова: WITH d AS (DELETE ... RETURNING *) SELECT ..., SELECT ... FOR UPDATE
+// Длина открывающего $tag$ строки в долларах PostgreSQL с позиции i; 0 — это не она ($1 и т.п.)
+size_t dollar_quote_at(const std::string& query, size_t i) {
+    if (i > 0 && is_word_char(query[i - 1])) return 0;
+    size_t j = i + 1;
+    if (j < query.size() && std::isdigit(static_cast<unsigned char>(query[j]))) return 0;
+    while (j < query.size() && is_word_char(query[j])) ++j;
+    return j < query.size() && query[j] == '$' ? j - i + 1 : 0;
+}
+
+// Незакрытые кавычка или комментарий считаются записью: такой запрос не кэшируется.
+// Строка закрывается первой такой же кавычкой, даже после \ — тогда остаток строки
+// проверяется как текст запроса, что лишь чаще запрещает кэширование
+bool has_write_keyword(const std::string& query) {
+    static const char* const words[] = {"INSERT", "UPDATE", "DELETE", "MERGE"};
+    const size_t n = query.size();
+    for (size_t i = 0; i < n;) {
+        const char c = query[i];
+        if (c == '\'' || c == '"' || c == '`') {
+            const size_t close = query.find(c, i + 1);
+            if (close == std::string::npos) return true;
+            i = close + 1;   // удвоенная кавычка — закрытие и сразу открытие
+        } else if (c == '$' && dollar_quote_at(query, i)) {
+            const size_t length = dollar_quote_at(query, i);
+            const size_t close = query.find(query.substr(i, length), i + length);
+            if (close == std::string::npos) return true;
+            i = close + length;
+        } else if (c == '-' && i + 1 < n && query[i + 1] == '-') {
+            const size_t eol = query.find('\n', i);
+            if (eol == std::string::npos) break;   // комментарий до конца запроса
+            i = eol + 1;
+        } else if (c == '/' && i + 1 < n && query[i + 1] == '*') {
+            const size_t close = query.find("*/", i + 2);
+            if (close == std::string::npos) return true;
+            i = close + 2;
+        } else if (is_word_char(c)) {
+            for (const char* word : words) {
+                if (keyword_at(query, i, word)) return true;
+            }
+            while (i < n && is_word_char(query[i])) ++i;
+        } else {
+            ++i;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+bool ResultCache::is_cacheable_query(const std::string& query) {
+    size_t i = 0;
+    while (i < query.size() && (std::isspace(static_cast<unsigned char>(query[i])) || query[i] == '(')) ++i;
+
+    if (!keyword_at(query, i, "SELECT") && !keyword_at(query, i, "WITH")) return false;
+    return !has_write_keyword(query);
+}
+
+size_t ResultCache::result_bytes(const QueryResult& result) {
+    size_t bytes = sizeof(QueryResult);
+    for (const ColumnInfo& info : result.columns) {
+        bytes += sizeof(ColumnInfo) + info.name.capacity() + info.type.capacity();
+    }
+    for (const ColumnData& data : result.data) {
+        bytes += sizeof(ColumnData) + data.validity.capacity() + data.bools.capacity() +
+                 data.ints.capacity() * sizeof(int64_t) + data.doubles.capacity() * sizeof(double) +
+                 data.offsets.capacity() * sizeof(int64_t) + data.chars.capacity() +
+                 data.codes.capacity() * sizeof(uint32_t);
+    }
+    return bytes;
+}
@@ -0,0 +1,79 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_all.hpp>
+#include "arrow_export.h"
+#include "common.h"
+#include <cstring>
+
+TEST_CASE("Arrow format mapping", "[Arrow]") {
+    REQUIRE(arrow_format_for({"id", "int4"}, ValueKind::Int64) == "i");
+    REQUIRE(arrow_format_for({"id", "int8"}, ValueKind::Int64) == "l");
+    REQUIRE(arrow_format_for({"price", "numeric"}, ValueKind::Float64) == "g");
+    REQUIRE(arrow_format_for({"name", "varchar"}, ValueKind::String) == "U");
+    REQUIRE(arrow_format_for({"n", "UInt32"}, ValueKind::Int64) == "I");
+    REQUIRE(arrow_format_for({"ts", "DateTime('UTC')"}, ValueKind::Int64) == "tss:UTC");
+    REQUIRE(arrow_format_for({"d", "Date"}, ValueKind::Int64) == "tdD");
+    REQUIRE(arrow_format_for({"ts", "timestamptz"}, ValueKind::TimestampTz) == "tsu:UTC");
+    REQUIRE(arrow_format_for({"d", "date"}, ValueKind::Date) == "tdD");
+    // В текстовом режиме PostgreSQL время приходит строкой
+    REQUIRE(arrow_format_for({"ts", "timestamp"}, ValueKind::String) == "U");
+    // Неизвестный тип или несовпадение с хранением — по физическому типу
+    REQUIRE(arrow_format_for({"x", "interval"}, ValueKind::String) == "U");
+    REQUIRE(arrow_format_for({"x", "Int32"}, ValueKind::String) == "U");
+    REQUIRE(arrow_format_for({"x", "oid_12345"}, ValueKind::Null) == "n");
+}
+
+TEST_CASE("Arrow stream export", "[Arrow]") {
+    QueryResult result;
+    result.add_column("id", "int4", ValueKind::Int64);
+    result.add_column("name", "text", ValueKind::String);
+    result.add_column("active", "bool", ValueKind::Bool);
+    result.append_row({int64_t(1), std::string("Alice"), true});
+    result.append_row({int64_t(2), nullptr, false});
+    result.append_row({nullptr, std::string("Bob"), true});
+    result.count = 3;
+
+    ArrowArrayStream stream;
+    export_arrow_stream(std::move(result), &stream);
+
+    ArrowSchema schema;
+    REQUIRE(stream.get_schema(&stream, &schema) == 0);
+    REQUIRE(std::strcmp(schema.format, "+s") == 0);
+    REQUIRE(schema.n_children == 3);
+    REQUIRE(std::strcmp(schema.children[0]->format, "i") == 0);
+    REQUIRE(std::strcmp(schema.children[0]->name, "id") == 0);
+    REQUIRE(std::strcmp(schema.children[1]->format, "U") == 0);
+    REQUIRE(std::strcmp(schema.children[2]->format, "b") == 0);
+    schema.release(&schema);
+    REQUIRE(schema.release == nullptr);
+
+    ArrowArray batch;
+    REQUIRE(stream.get_next(&stream, &batch) == 0);
+    REQUIRE(batch.release != nullptr);
+    REQUIRE(batch.length == 3);
+    REQUIRE(batch.n_children == 3);
+
+    const ArrowArray* ids = batch.children[0];
+    REQUIRE(ids->null_count == 1);
+    REQUIRE(static_cast<const int32_t*>(ids->buffers[1])[1] == 2);
+    REQUIRE((static_cast<const uint8_t*>(ids->buffers[0])[0] & 0b100) == 0);
+
+    const ArrowArray* names = batch.children[1];
+    REQUIRE(names->n_buffers == 3);
+    const int64_t* offsets = static_cast<const int64_t*>(names->buffers[1]);
+    const char* chars = static_cast<const char*>(names->buffers[2]);
+    REQUIRE(std::string(chars + offsets[2], offsets[3] - offsets[2]) == "Bob");
+
+    const ArrowArray* active = batch.children[2];
+    REQUIRE(active->buffers[0] == nullptr);
+    REQUIRE(static_cast<const uint8_t*>(active->buffers[1])[0] == 0b101);
+
+    batch.release(&batch);
+    REQUIRE(batch.release == nullptr);
+
+    ArrowArray end;
+    REQUIRE(stream.get_next(&stream, &end) == 0);
+    REQUIRE(end.release == nullptr);
+
+    stream.release(&stream);
+    REQUIRE(stream.release == nullptr);
+}
@@ -2,6 +2,11 @@
 #include "common.h"
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/catch_all.hpp>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
 
 TEST_CASE("ClickHouse connection", "[ClickHouseConnector]") {
     ClickHouseConnector conn;
@@ -30,3 +35,252 @@ TEST_CASE("ClickHouse execute basic query", "[ClickHouseConnector]") {
     REQUIRE(result.columns[0].name == "test");
     conn.disconnect();
 }
+
+TEST_CASE("ClickHouse streaming batches", "[ClickHouseConnector]") {
+    ClickHouseConnector conn;
+    if (!conn.connect("127.0.0.1", 19000, "default", "default", "")) {
+        WARN("Cannot connect to ClickHouse, skipping test");
+        return;
+    }
+
+    SECTION("all rows arrive in batches") {
+        auto rows = conn.stream("SELECT number AS n FROM system.numbers LIMIT 100000", 10000, 2);
+        REQUIRE(rows->columns().size() == 1);
+        REQUIRE(rows->columns()[0].name == "n");
+
+        QueryResult batch;
+        size_t total = 0;
+        while (rows->next_batch(batch)) {
+            REQUIRE(batch.count == batch.row_count());
+            total += batch.row_count();
+        }
+        REQUIRE(total == 100000);
+        REQUIRE_FALSE(rows->is_open());
+    }
+
+    SECTION("connection is busy while stream is open") {
+        auto rows = conn.stream("SELECT number FROM system.numbers LIMIT 10");
+        REQUIRE_THROWS(conn.execute("SELECT 1"));
+        rows->close();
+        REQUIRE(conn.execute("SELECT 1 AS x").row_count() == 1);
+    }
+
+    SECTION("early close cancels an unbounded query") {
+        auto rows = conn.stream("SELECT number FROM system.numbers", 1000, 1);
+        QueryResult batch;
+        REQUIRE(rows->next_batch(batch));
+        REQUIRE(batch.row_count() >= 1000);
+        rows->close();
+        REQUIRE_FALSE(rows->is_open());
+        REQUIRE(conn.execute("SELECT 1 AS x").row_count() == 1);
+    }
+
+    SECTION("close does not wait for a block the server has not sent yet") {
+        auto rows = conn.stream("SELECT sleep(3) AS s", 1, 1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        auto started = std::chrono::steady_clock::now();
+        rows->close();
+        REQUIRE(std::chrono::steady_clock::now() - started < std::chrono::seconds(2));
+        REQUIRE_FALSE(rows->is_open());
+        REQUIRE(conn.is_connected());
+        REQUIRE(conn.execute("SELECT 1 AS x").row_count() == 1);
+    }
+
+    conn.disconnect();
+}
+
+TEST_CASE("ClickHouse count before limit", "[ClickHouseConnector]") {
+    ClickHouseConnector conn;
+    if (!conn.connect("127.0.0.1", 19000, "default", "default", "")) {
+        WARN("Cannot connect to ClickHouse, skipping test");
+        return;
+    }
+
+    auto page = conn.execute("SELECT number FROM numbers(1000) ORDER BY number LIMIT 10 OFFSET 20");
+    REQUIRE(page.row_count() == 10);
+    REQUIRE(page.count == 1000);
+
+    // CTE с LIMIT внутри: запрос не переписывается на клиенте
+    auto cte = conn.execute("WITH t AS (SELECT number FROM numbers(100) LIMIT 5) SELECT * FROM t");
+    REQUIRE(cte.row_count() == 5);
+    REQUIRE(cte.count >= 5);
+
+    auto all = conn.execute("SELECT number FROM numbers(42)");
+    REQUIRE(all.count == 42);
+    conn.disconnect();
+}
+
+TEST_CASE("ClickHouse native block insert", "[ClickHouseConnector]") {
+    ClickHouseConnector conn;
+    if (!conn.connect("127.0.0.1", 19000, "default", "default", "")) {
+        WARN("Cannot connect to ClickHouse, skipping test");
+        return;
+    }
+
+    conn.execute("DROP TABLE IF EXISTS sql_executor_insert_test");
+    conn.execute("CREATE TABLE sql_executor_insert_test (id UInt32, score Nullable(Float64), "
+                 "tag LowCardinality(String), created DateTime64(3)) ENGINE = Memory");
+
+    auto make_batch = [](size_t first, size_t count) {
+        QueryResult batch;
+        batch.add_column("id", "");
+        batch.add_column("score", "");
+        batch.add_column("tag", "");
+        for (size_t i = first; i < first + count; ++i) {
+            batch.data[0].append_int(static_cast<int64_t>(i));
+            if (i % 2 == 0) batch.data[1].append_null();
+            else batch.data[1].append_double(i * 0.5);
+            batch.data[2].append_string(i % 3 == 0 ? "a" : "b");
+        }
+        return batch;
+    };
+
+    SECTION("rows are split into blocks") {
+        ClickHouseInsertOptions options;
+        options.block_rows = 1000;
+        REQUIRE(conn.insert("sql_executor_insert_test", {"id", "score", "tag"}, make_batch(0, 2500), options) == 2500);
+
+        auto check = conn.execute("SELECT count() AS n, countIf(score IS NULL) AS nulls, "
+                                  "countIf(tag = 'a') AS a FROM sql_executor_insert_test");
+        REQUIRE(std::get<int64_t>(check.value_at(0, 0)) == 2500);
+        REQUIRE(std::get<int64_t>(check.value_at(0, 1)) == 1250);
+        REQUIRE(std::get<int64_t>(check.value_at(0, 2)) == 834);
+    }
+
+    SECTION("background sender") {
+        ClickHouseInsertOptions options;
+        options.block_rows = 700;
+        options.background = true;
+        auto inserter = conn.inserter("sql_executor_insert_test", {"id", "score", "tag"}, options);
+        REQUIRE_THROWS(conn.execute("SELECT 1"));
+        for (size_t i = 0; i < 10; ++i) inserter->write(make_batch(i * 500, 500));
+        REQUIRE(inserter->close() == 5000);
+        REQUIRE_FALSE(inserter->is_open());
+
+        auto check = conn.execute("SELECT count() AS n, max(id) AS m FROM sql_executor_insert_test");
+        REQUIRE(std::get<int64_t>(check.value_at(0, 0)) == 5000);
+        REQUIRE(std::get<int64_t>(check.value_at(0, 1)) == 4999);
+    }
+
+    SECTION("invalid values are rejected") {
+        QueryResult batch = make_batch(0, 3);
+        batch.data[0].ints[1] = -1;
+        REQUIRE_THROWS(conn.insert("sql_executor_insert_test", {"id", "score", "tag"}, batch));
+
+        QueryResult nulls = make_batch(0, 3);
+        nulls.data[0] = ColumnData();
+        for (int i = 0; i < 3; ++i) nulls.data[0].append_null();
+        REQUIRE_THROWS(conn.insert("sql_executor_insert_test", {"id", "score", "tag"}, nulls));
+
+        REQUIRE(std::get<int64_t>(conn.execute("SELECT count() AS n FROM sql_executor_insert_test").value_at(0, 0)) == 0);
+    }
+
+    SECTION("timestamps keep column precision") {
+        QueryResult batch;
+        batch.add_column("id", "");
+        batch.add_column("created", "");
+        batch.data[0].append_int(1);
+        batch.data[1].append_temporal(ValueKind::Timestamp, 1700000000123456);
+        conn.insert("sql_executor_insert_test", {"id", "created"}, batch);
+
+        auto check = conn.execute("SELECT toUnixTimestamp64Milli(created) AS ms FROM sql_executor_insert_test");
+        REQUIRE(std::get<int64_t>(check.value_at(0, 0)) == 1700000000123);
+    }
+
+    conn.execute("DROP TABLE IF EXISTS sql_executor_insert_test");
+    conn.disconnect();
+}
+
+TEST_CASE("ClickHouse insert continues after a rejected Nullable value", "[ClickHouseConnector]") {
+    ClickHouseConnector conn;
+    if (!conn.connect("127.0.0.1", 19000, "default", "default", "")) {
+        WARN("Cannot connect to ClickHouse, skipping test");
+        return;
+    }
+
+    conn.execute("DROP TABLE IF EXISTS sql_executor_insert_nullable_test");
+    conn.execute("CREATE TABLE sql_executor_insert_nullable_test (v Nullable(UInt32)) ENGINE = Memory");
+
+    {
+        ClickHouseInsertOptions options;
+        options.background = false;
+        auto inserter = conn.inserter("sql_executor_insert_nullable_test", {"v"}, options);
+
+        // Вложенная колонка успевает принять 1 до ошибки на значении вне диапазона UInt32
+        QueryResult bad;
+        bad.add_column("v", "");
+        bad.data[0].append_int(1);
+        bad.data[0].append_null();
+        bad.data[0].append_int(5000000000LL);
+        REQUIRE_THROWS(inserter->write(bad));
+
+        QueryResult good;
+        good.add_column("v", "");
+        good.data[0].append_int(2);
+        good.data[0].append_null();
+        inserter->write(good);
+        REQUIRE(inserter->close() == 2);
+    }
+
+    auto check = conn.execute("SELECT count() AS n, countIf(v IS NULL) AS nulls, sum(v) AS s "
+                              "FROM sql_executor_insert_nullable_test");
+    REQUIRE(std::get<int64_t>(check.value_at(0, 0)) == 2);
+    REQUIRE(std::get<int64_t>(check.value_at(0, 1)) == 1);
+    REQUIRE(std::get<int64_t>(check.value_at(0, 2)) == 2);
+
+    conn.execute("DROP TABLE IF EXISTS sql_executor_insert_nullable_test");
+    conn.disconnect();
+}
+
+TEST_CASE("ClickHouse export to file", "[ClickHouseConnector]") {
+    ClickHouseConnector conn;
+    if (!conn.connect("127.0.0.1", 19000, "default", "default", "")) {
+        WARN("Cannot connect to ClickHouse, skipping test");
+        return;
+    }
+
+    std::string path = "/tmp/sql_executor_ch_export.tsv";
+    {
+        auto sink = FdSink::open(path);
+        uint64_t rows = conn.copy_out("SELECT number AS n, concat('a\\tb', toString(number)) AS s FROM numbers(3)",
+                                      *sink, ExportFormat::Tsv, true);
+        REQUIRE(rows == 3);
+        sink->close();
+    }
+    std::ifstream in(path);
+    std::stringstream content;
+    content << in.rdbuf();
+    REQUIRE(content.str() == "n\ts\n0\ta\\tb0\n1\ta\\tb1\n2\ta\\tb2\n");
+
+    {
+        auto sink = FdSink::open(path);
+        REQUIRE(conn.copy_out("SELECT number FROM numbers(100000)", *sink, ExportFormat::Binary) == 100000);
+        sink->close();
+        REQUIRE(sink->bytes_written() > 100000 * 8);
+    }
+    std::remove(path.c_str());
+    conn.disconnect();
+}
+
+TEST_CASE("ClickHouse export formats values like the server", "[ClickHouseConnector]") {
+    ClickHouseConnector conn;
+    if (!conn.connect("127.0.0.1", 19000, "default", "default", "")) {
+        WARN("Cannot connect to ClickHouse, skipping test");
+        return;
+    }
+
+    const std::string query =
+        "SELECT toDecimal64(12.25, 2) AS d, CAST('b' AS Enum8('a' = 1, 'b' = 2)) AS e, "
+        "toDateTime('2024-01-15 10:30:00', 'UTC') AS t, toDate('2024-01-15') AS day, "
+        "CAST(NULL AS Nullable(Int32)) AS n;";
+    std::string out;
+    CallbackSink sink([&out](const char* data, size_t size) { out.append(data, size); });
+
+    REQUIRE(conn.copy_out(query, sink, ExportFormat::Csv, true) == 1);
+    REQUIRE(out == "\"d\",\"e\",\"t\",\"day\",\"n\"\n12.25,\"b\",\"2024-01-15 10:30:00\",\"2024-01-15\",\\N\n");
+
+    out.clear();
+    REQUIRE(conn.copy_out(query, sink, ExportFormat::Tsv) == 1);
+    REQUIRE(out == "12.25\tb\t2024-01-15 10:30:00\t2024-01-15\t\\N\n");
+    conn.disconnect();
+}
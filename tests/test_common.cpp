@@ -10,8 +10,8 @@ TEST_CASE("QueryResult JSON conversion", "[QueryResult]") {
     result.columns.push_back({"name", "string"});
     result.columns.push_back({"active", "bool"});
 
-    result.rows.push_back({int64_t(1), std::string("Alice"), true});
-    result.rows.push_back({nullptr, std::string("Bob"), false});
+    result.append_row({int64_t(1), std::string("Alice"), true});
+    result.append_row({nullptr, std::string("Bob"), false});
     result.count = 2;
 
     std::string json = result.to_json();
@@ -33,3 +33,230 @@ TEST_CASE("Value variant type checking", "[Value]") {
     REQUIRE(std::holds_alternative<std::nullptr_t>(v3));
     REQUIRE(std::holds_alternative<bool>(v4));
 }
+
+TEST_CASE("ColumnData columnar storage", "[ColumnData]") {
+    ColumnData col;
+
+    // Тип колонки определяется первым не-NULL значением
+    col.append_null();
+    col.append_string("abc");
+    col.append_null();
+    col.append_string("de");
+
+    REQUIRE(col.kind == ValueKind::String);
+    REQUIRE(col.size == 4);
+    REQUIRE(col.null_count == 2);
+    REQUIRE(col.offsets.size() == 5);
+    REQUIRE(col.chars == "abcde");
+    REQUIRE(col.is_null(0));
+    REQUIRE_FALSE(col.is_null(1));
+    REQUIRE(col.string_at(1) == "abc");
+    REQUIRE(col.string_at(3) == "de");
+    REQUIRE(col.validity.size() == 1);
+    REQUIRE(col.validity[0] == 0b1010);
+
+    REQUIRE_THROWS(col.append_int(1));
+}
+
+TEST_CASE("QueryResult columnar access", "[QueryResult]") {
+    QueryResult result;
+    result.add_column("id", "int8", ValueKind::Int64);
+    result.add_column("score", "float8", ValueKind::Float64);
+
+    for (int64_t i = 0; i < 20; ++i) {
+        result.data[0].append_int(i);
+        if (i % 3 == 0) result.data[1].append_null();
+        else result.data[1].append_double(i * 0.5);
+    }
+    result.count = 20;
+
+    REQUIRE(result.row_count() == 20);
+    REQUIRE(result.data[0].ints.size() == 20);
+    REQUIRE(result.data[1].doubles.size() == 20);
+    REQUIRE(std::get<int64_t>(result.value_at(7, 0)) == 7);
+    REQUIRE(std::holds_alternative<std::nullptr_t>(result.value_at(9, 1)));
+    REQUIRE(std::get<double>(result.value_at(10, 1)) == 5.0);
+
+    std::string json = result.to_json();
+    REQUIRE(json.find("{\"id\":3,\"score\":null}") != std::string::npos);
+    REQUIRE(json.find("{\"id\":4,\"score\":2}") != std::string::npos);
+    REQUIRE(json.find("\"count\":20") != std::string::npos);
+}
+
+TEST_CASE("ColumnData bulk append", "[ColumnData]") {
+    ColumnData col;
+    col.append_int(-1);
+
+    std::vector<int64_t> values(21);
+    for (size_t i = 0; i < values.size(); ++i) values[i] = static_cast<int64_t>(i);
+    col.append_ints(values.data(), values.size());
+
+    std::vector<uint8_t> nulls = {0, 1, 0};
+    col.append_ints(values.data(), nulls.size(), nulls.data());
+
+    REQUIRE(col.size == 25);
+    REQUIRE(col.ints.size() == 25);
+    REQUIRE(col.null_count == 1);
+    REQUIRE(col.validity.size() == 4);
+    REQUIRE(col.ints[21] == 20);
+    REQUIRE_FALSE(col.is_null(21));
+    REQUIRE(col.is_null(23));
+    REQUIRE_FALSE(col.is_null(24));
+}
+
+TEST_CASE("ColumnData interned strings", "[ColumnData]") {
+    ColumnData col;
+    col.intern_strings();
+    const std::vector<std::string> statuses = {"new", "paid", "", "shipped"};
+    for (size_t i = 0; i < 1000; ++i) {
+        if (i % 7 == 0) col.append_null();
+        else col.append_string(statuses[i % statuses.size()] + (i % 5 == 0 ? std::to_string(i) : ""));
+    }
+
+    REQUIRE(col.size == 1000);
+    REQUIRE(col.codes.size() == 1000);
+    REQUIRE(col.dictionary_size() < 400);   // повторы хранятся один раз
+
+    QueryResult interned;
+    interned.add_column("status", "text");
+    interned.data[0] = col;
+
+    col.materialize_strings();
+    REQUIRE_FALSE(col.interned);
+    REQUIRE(col.codes.empty());
+    REQUIRE(col.offsets.size() == 1001);
+
+    size_t bytes = 0;
+    for (size_t i = 0; i < 1000; ++i) {
+        REQUIRE(interned.data[0].is_null(i) == (i % 7 == 0));
+        REQUIRE(interned.data[0].string_at(i) == col.string_at(i));
+        if (i % 7 != 0) {
+            REQUIRE(col.string_at(i) == statuses[i % statuses.size()] + (i % 5 == 0 ? std::to_string(i) : ""));
+            bytes += col.string_at(i).size();
+        }
+    }
+    REQUIRE(interned.data[0].string_bytes(0, 1000) == bytes);
+    REQUIRE(col.string_bytes(0, 1000) == bytes);
+
+    QueryResult flat;
+    flat.add_column("status", "text");
+    flat.data[0] = col;
+    REQUIRE(interned.to_json() == flat.to_json());
+
+    ColumnData used;
+    used.append_string("x");
+    REQUIRE_THROWS(used.intern_strings());
+}
+
+TEST_CASE("Temporal values formatting", "[ColumnData]") {
+    auto format = [](ValueKind kind, int64_t value) {
+        FastStringBuilder b;
+        append_temporal_text(b, kind, value);
+        return b.str();
+    };
+
+    REQUIRE(format(ValueKind::Date, 0) == "1970-01-01");
+    REQUIRE(format(ValueKind::Date, 19372) == "2023-01-15");
+    REQUIRE(format(ValueKind::Date, -719163) == "0001-12-31 BC");
+    REQUIRE(format(ValueKind::Timestamp, 1673778600000000LL) == "2023-01-15 10:30:00");
+    REQUIRE(format(ValueKind::Timestamp, 1673778600500000LL) == "2023-01-15 10:30:00.5");
+    REQUIRE(format(ValueKind::Timestamp, -1) == "1969-12-31 23:59:59.999999");
+    REQUIRE(format(ValueKind::TimestampTz, 1673778600000123LL) == "2023-01-15 10:30:00.000123+00");
+    REQUIRE(format(ValueKind::TimestampTz, TEMPORAL_INFINITY) == "infinity");
+    REQUIRE(format(ValueKind::Date, TEMPORAL_NEG_INFINITY) == "-infinity");
+
+    QueryResult result;
+    result.add_column("created_at", "timestamp", ValueKind::Timestamp);
+    result.data[0].append_temporal(ValueKind::Timestamp, 1673778600000000LL);
+    result.data[0].append_null();
+
+    REQUIRE(result.data[0].ints.size() == 2);
+    REQUIRE(std::get<std::string>(result.value_at(0, 0)) == "2023-01-15 10:30:00");
+    REQUIRE(result.to_json().find("{\"created_at\":\"2023-01-15 10:30:00\"},{\"created_at\":null}")
+            != std::string::npos);
+}
+
+TEST_CASE("Civil date conversion", "[ColumnData]") {
+    REQUIRE(days_from_civil(1970, 1, 1) == 0);
+    REQUIRE(days_from_civil(2000, 1, 1) == 10957);
+    REQUIRE(days_from_civil(2023, 1, 15) == 19372);
+    REQUIRE(days_from_civil(0, 12, 31) == -719163);
+
+    for (int64_t days = -800000; days < 800000; days += 997) {
+        int64_t year;
+        unsigned month, day;
+        civil_from_days(days, year, month, day);
+        REQUIRE(days_from_civil(year, month, day) == days);
+    }
+}
+
+// Эталон: побайтовое экранирование по таблице
+static std::string reference_escape(std::string_view s) {
+    std::string out;
+    const char** table = get_escape_table();
+    for (unsigned char c : s) {
+        if (table[c]) {
+            out += table[c];
+        } else if (c < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u00%02X", c);
+            out += buf;
+        } else {
+            out.push_back(static_cast<char>(c));
+        }
+    }
+    return out;
+}
+
+TEST_CASE("JSON escaping matches byte-wise reference", "[Escaping]") {
+    const char specials[] = {'"', '\\', '\n', '\t', '\x01', '\x1f', '\0'};
+    for (size_t length : {0, 1, 15, 16, 17, 31, 32, 33, 64, 100}) {
+        // Без спецсимволов, включая байты UTF-8 (>= 0x80) и 0x7F
+        std::string plain;
+        for (size_t i = 0; i < length; ++i) plain.push_back(static_cast<char>(i % 2 ? 0xD0 + i % 16 : 0x7F - i % 64));
+        FastStringBuilder b;
+        append_escaped_unquoted(b, plain);
+        REQUIRE(b.str() == reference_escape(plain));
+
+        // Спецсимвол в каждой позиции — попадание на границы 16/32-байтовых блоков
+        for (size_t pos = 0; pos < length; ++pos) {
+            for (char special : specials) {
+                std::string text(length, 'a');
+                text[pos] = special;
+                FastStringBuilder e;
+                append_escaped_unquoted(e, text);
+                REQUIRE(e.str() == reference_escape(text));
+            }
+        }
+    }
+}
+
+TEST_CASE("JSON escape scanners agree", "[Escaping]") {
+    std::string text(300, 'x');
+    text[40] = '"';
+    text[77] = '\x02';
+    text[200] = '\\';
+    const char* begin = text.data();
+    const char* end = begin + text.size();
+    for (size_t offset : {0, 41, 78, 201, 280}) {
+        const char* expected = find_json_escape_scalar(begin + offset, end);
+        REQUIRE(find_json_escape(begin + offset, end) == expected);
+        REQUIRE(json_escape_scanner()(begin + offset, end) == expected);
+#if JSON_ESCAPE_X86_SIMD
+        REQUIRE(find_json_escape_sse2(begin + offset, end) == expected);
+        if (__builtin_cpu_supports("avx2")) REQUIRE(find_json_escape_avx2(begin + offset, end) == expected);
+#endif
+    }
+}
+
+TEST_CASE("JSON keys are escaped once per result", "[QueryResult]") {
+    QueryResult result;
+    result.add_column("a\"b", "text");
+    result.add_column("c", "int");
+    result.append_row({std::string("x\ny"), int64_t(1)});
+    result.append_row({nullptr, int64_t(2)});
+    result.count = 2;
+    REQUIRE(result.to_json() ==
+            "{\"rows\":[{\"a\\\"b\":\"x\\ny\",\"c\":1},{\"a\\\"b\":null,\"c\":2}],"
+            "\"columns\":[{\"name\":\"a\\\"b\",\"type\":\"text\"},{\"name\":\"c\",\"type\":\"int\"}],\"count\":2}");
+}
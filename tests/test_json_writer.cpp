@@ -0,0 +1,133 @@
+#include "json_writer.h"
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_all.hpp>
+#include <string>
+#include <vector>
+
+static QueryResult sample_result(size_t rows) {
+    QueryResult result;
+    result.add_column("id", "int8");
+    result.add_column("name \"quoted\"", "text");
+    result.add_column("score", "float8");
+    for (size_t i = 0; i < rows; ++i) {
+        result.data[0].append_int(static_cast<int64_t>(i));
+        if (i % 3 == 0) result.data[1].append_null();
+        else result.data[1].append_string("row\n" + std::to_string(i));
+        result.data[2].append_double(i * 0.25);
+    }
+    result.count = rows;
+    return result;
+}
+
+TEST_CASE("JsonWriter document matches to_json", "[JsonWriter]") {
+    for (size_t rows : {0, 1, 7, 1000}) {
+        QueryResult result = sample_result(rows);
+        std::string out;
+        CallbackSink sink([&out](const char* data, size_t size) { out.append(data, size); });
+
+        // Маленький буфер — документ уходит в sink многими кусками
+        JsonWriter writer(sink, JsonFormat::Document, 100);
+        writer.write_rows(result, 0, rows / 2);
+        writer.write_rows(result, rows / 2);
+        writer.finish(result.columns, result.count);
+
+        REQUIRE(out == result.to_json());
+        REQUIRE(writer.rows_written() == rows);
+        REQUIRE_THROWS(writer.write_rows(result));
+    }
+}
+
+TEST_CASE("JsonWriter NDJSON", "[JsonWriter]") {
+    QueryResult result = sample_result(3);
+    std::string out;
+    CallbackSink sink([&out](const char* data, size_t size) { out.append(data, size); });
+    JsonWriter writer(sink, JsonFormat::Ndjson);
+    writer.write(result);
+
+    REQUIRE(out ==
+            "{\"id\":0,\"name \\\"quoted\\\"\":null,\"score\":0}\n"
+            "{\"id\":1,\"name \\\"quoted\\\"\":\"row\\n1\",\"score\":0.25}\n"
+            "{\"id\":2,\"name \\\"quoted\\\"\":\"row\\n2\",\"score\":0.5}\n");
+}
+
+TEST_CASE("ChunkSink cuts fixed-size chunks", "[OutputSink]") {
+    ChunkSink sink(4);
+    sink.write("abcdefghij", 10);
+    sink.write("k", 1);
+
+    std::string chunk;
+    REQUIRE(sink.take(chunk));
+    REQUIRE(chunk == "abcd");
+    REQUIRE(sink.take(chunk));
+    REQUIRE(chunk == "efgh");
+    REQUIRE_FALSE(sink.take(chunk));   // "ijk" ещё не добран
+
+    sink.flush();
+    REQUIRE(sink.take(chunk));
+    REQUIRE(chunk == "ijk");
+    REQUIRE_FALSE(sink.has_chunk());
+}
+
+TEST_CASE("JsonChunkReader pulls batches on demand", "[JsonWriter]") {
+    QueryResult full = sample_result(250);
+    size_t next_row = 0;
+    size_t batches_read = 0;
+    BatchSource source = [&](QueryResult& batch) {
+        if (next_row >= 250) return false;
+        QueryResult part = sample_result(0);
+        for (size_t i = next_row; i < next_row + 50; ++i) {
+            part.append_row({full.value_at(i, 0), full.value_at(i, 1), full.value_at(i, 2)});
+        }
+        next_row += 50;
+        ++batches_read;
+        batch = std::move(part);
+        return true;
+    };
+
+    JsonChunkReader reader(full.columns, source, JsonFormat::Document, 512);
+    std::string document;
+    std::string chunk;
+    REQUIRE(reader.next_chunk(chunk));
+    REQUIRE(chunk.size() == 512);
+    REQUIRE(batches_read < 5);   // первый кусок не требует всего результата
+    document += chunk;
+    while (reader.next_chunk(chunk)) {
+        REQUIRE(chunk.size() <= 512);
+        document += chunk;
+    }
+    REQUIRE(document == full.to_json());
+    REQUIRE_FALSE(reader.next_chunk(chunk));
+}
+
+TEST_CASE("JSON format names", "[JsonWriter]") {
+    REQUIRE(parse_json_format("json") == JsonFormat::Document);
+    REQUIRE(parse_json_format("ndjson") == JsonFormat::Ndjson);
+    REQUIRE_THROWS_AS(parse_json_format("xml"), std::invalid_argument);
+}
+
+TEST_CASE("Parallel to_json matches serial output", "[JsonWriter]") {
+    ThreadPool pool(4);
+    JsonParallelOptions options;
+    options.min_rows = 0;
+    options.chunk_rows = 7;
+
+    for (size_t rows : {0, 1, 6, 7, 8, 100, 1001}) {
+        QueryResult result = sample_result(rows);
+        ColumnData& status = result.add_column("status", "text");
+        status.intern_strings();
+        for (size_t i = 0; i < rows; ++i) {
+            if (i % 5 == 0) status.append_null();
+            else status.append_string(i % 2 ? "paid" : "new\t");
+        }
+        REQUIRE(to_json_parallel(result, pool, options) == result.to_json());
+    }
+
+    // Ниже порога и на пуле из одного потока — обычный to_json()
+    QueryResult result = sample_result(50);
+    options.min_rows = 1000;
+    REQUIRE(to_json_parallel(result, pool, options) == result.to_json());
+    ThreadPool single(1);
+    options.min_rows = 0;
+    REQUIRE(to_json_parallel(result, single, options) == result.to_json());
+    REQUIRE(to_json_parallel(result, options) == result.to_json());
+}
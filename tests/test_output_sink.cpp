@@ -0,0 +1,66 @@
+#include "output_sink.h"
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_all.hpp>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+static std::string read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream content;
+    content << in.rdbuf();
+    return content.str();
+}
+
+TEST_CASE("FdSink buffers small writes and passes large ones through", "[OutputSink]") {
+    char path[] = "/tmp/sql_executor_sink_XXXXXX";
+    int fd = mkstemp(path);
+    REQUIRE(fd >= 0);
+
+    {
+        FdSink sink(fd, 8);
+        sink.write("abc", 3);
+        sink.write("def", 3);
+        REQUIRE(read_file(path).empty());     // пока в буфере
+        sink.write("0123456789", 10);         // больше буфера — пишется напрямую
+        REQUIRE(read_file(path) == "abcdef0123456789");
+        sink.write("xyz", 3);
+        REQUIRE(sink.bytes_written() == 19);
+        sink.close();
+        REQUIRE_THROWS(sink.write("!", 1));
+    }
+    REQUIRE(read_file(path) == "abcdef0123456789xyz");
+
+    // Чужой дескриптор после close остаётся открытым
+    REQUIRE(write(fd, "+", 1) == 1);
+    ::close(fd);
+    std::remove(path);
+}
+
+TEST_CASE("FdSink opens and truncates files", "[OutputSink]") {
+    std::string path = "/tmp/sql_executor_sink_open.txt";
+    {
+        auto sink = FdSink::open(path);
+        sink->write("first run", 9);
+    }
+    {
+        auto sink = FdSink::open(path);
+        sink->write("second", 6);
+        sink->close();
+    }
+    REQUIRE(read_file(path) == "second");
+    std::remove(path.c_str());
+
+    REQUIRE_THROWS(FdSink::open("/nonexistent-dir/out.csv"));
+}
+
+TEST_CASE("Export format names", "[OutputSink]") {
+    REQUIRE(parse_export_format("csv") == ExportFormat::Csv);
+    REQUIRE(parse_export_format("text") == ExportFormat::Tsv);
+    REQUIRE(parse_export_format("tsv") == ExportFormat::Tsv);
+    REQUIRE(parse_export_format("native") == ExportFormat::Binary);
+    REQUIRE(parse_export_format("binary") == ExportFormat::Binary);
+    REQUIRE_THROWS_AS(parse_export_format("xml"), std::invalid_argument);
+}
@@ -2,6 +2,8 @@
 #include "common.h"
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/catch_all.hpp>
+#include <sys/select.h>
+#include <unistd.h>
 
 TEST_CASE("Postgres connection", "[PostgresConnector]") {
     PostgresConnector conn;
@@ -48,3 +50,552 @@ TEST_CASE("Postgres transaction test") {
     // REQUIRE_FALSE(conn.is_in_transaction());
 
 }
+
+TEST_CASE("Postgres binary results", "[PostgresConnector]") {
+    PostgresConnector conn;
+    std::string conninfo = "host=127.0.0.1 port=15432 dbname=postgres user=postgres password=postgres";
+    if (!conn.connect(conninfo)) {
+        WARN("Cannot connect to Postgres, skipping test");
+        return;
+    }
+
+    conn.set_binary_results(true);
+    QueryResult result = conn.execute(
+        "SELECT 42::int4 AS i, -1.5::numeric AS n, true AS b, "
+        "'2023-01-15 10:30:00.5'::timestamp AS ts, '2023-01-15'::date AS d, "
+        "'00112233-4455-6677-8899-aabbccddeeff'::uuid AS u, 'abc'::text AS t");
+
+    REQUIRE(result.row_count() == 1);
+    REQUIRE(std::get<int64_t>(result.value_at(0, 0)) == 42);
+    REQUIRE(std::get<double>(result.value_at(0, 1)) == -1.5);
+    REQUIRE(std::get<bool>(result.value_at(0, 2)));
+    REQUIRE(result.data[3].kind == ValueKind::Timestamp);
+    REQUIRE(std::get<std::string>(result.value_at(0, 3)) == "2023-01-15 10:30:00.5");
+    REQUIRE(result.data[4].kind == ValueKind::Date);
+    REQUIRE(std::get<std::string>(result.value_at(0, 4)) == "2023-01-15");
+    REQUIRE(std::get<std::string>(result.value_at(0, 5)) == "00112233-4455-6677-8899-aabbccddeeff");
+    REQUIRE(std::get<std::string>(result.value_at(0, 6)) == "abc");
+    conn.disconnect();
+}
+
+TEST_CASE("Postgres binary results match text for other types", "[PostgresConnector]") {
+    PostgresConnector conn;
+    std::string conninfo = "host=127.0.0.1 port=15432 dbname=postgres user=postgres password=postgres";
+    if (!conn.connect(conninfo)) {
+        WARN("Cannot connect to Postgres, skipping test");
+        return;
+    }
+
+    // Массивы, время, интервалы, адреса и деньги в бинарном режиме — та же строка, что в текстовом
+    const std::string query =
+        "SELECT '{1,NULL,3}'::int4[] AS a, '{\"a b\",NULL,\"\",c,\"q\\\"x\"}'::text[] AS t, "
+        "'[0:1]={1,2}'::int4[] AS lb, '{{1,2},{3,4}}'::int2[] AS m, '{1.50,2}'::numeric[] AS n, "
+        "'{true,false}'::bool[] AS b, '{2024-01-15}'::date[] AS d, '{\"2024-01-15 10:30:00\"}'::timestamp[] AS ts, "
+        "'{00112233-4455-6677-8899-aabbccddeeff}'::uuid[] AS u, '{}'::int8[] AS e, "
+        "'04:05:06.789'::time AS tm, '04:05:06+05:30'::timetz AS tz, "
+        "'1 year 2 mons -3 days 04:05:06.5'::interval AS iv, '-1 days -00:00:01'::interval AS niv, "
+        "'0'::interval AS ziv, '192.168.1.5/24'::inet AS ip, '10.0.0.0/8'::cidr AS net, '::1'::inet AS ip6, "
+        "'08:00:2b:01:02:03'::macaddr AS mac, '-1234.56'::money AS cash, 26::oid AS o";
+
+    conn.set_binary_results(false);
+    QueryResult text = conn.execute(query, CountMode::None);
+    conn.set_binary_results(true);
+    QueryResult binary = conn.execute(query, CountMode::None);
+
+    REQUIRE(text.columns.size() == binary.columns.size());
+    for (size_t j = 0; j < text.columns.size(); ++j) {
+        INFO(text.columns[j].name);
+        REQUIRE(text.data[j].kind == binary.data[j].kind);
+        REQUIRE(text.value_at(0, j) == binary.value_at(0, j));
+    }
+    REQUIRE(std::get<std::string>(binary.value_at(0, 0)) == "{1,NULL,3}");
+    REQUIRE(std::get<std::string>(binary.value_at(0, 2)) == "[0:1]={1,2}");
+    REQUIRE(std::get<int64_t>(binary.value_at(0, 20)) == 26);
+    conn.disconnect();
+}
+
+TEST_CASE("Postgres prepared statements", "[PostgresConnector]") {
+    PostgresConnector conn;
+    std::string conninfo = "host=127.0.0.1 port=15432 dbname=postgres user=postgres password=postgres";
+    if (!conn.connect(conninfo)) {
+        WARN("Cannot connect to Postgres, skipping test");
+        return;
+    }
+
+    REQUIRE(conn.prepare("add_one", "SELECT $1::int8 + 1 AS v"));
+    QueryResult result = conn.execute_prepared("add_one", {std::string("41")});
+    REQUIRE(std::get<int64_t>(result.value_at(0, 0)) == 42);
+
+    // Автоматический кэш: при переполнении вытесняется давно использованный оператор
+    conn.set_statement_cache_size(2);
+    for (int i = 0; i < 3; ++i) {
+        result = conn.execute("SELECT $1::text AS v, " + std::to_string(i) + " AS i",
+                              {std::string("x")});
+        REQUIRE(std::get<std::string>(result.value_at(0, 0)) == "x");
+    }
+    result = conn.execute("SELECT $1::text AS v, 0 AS i", {std::nullopt});
+    REQUIRE(std::holds_alternative<std::nullptr_t>(result.value_at(0, 0)));
+    conn.disconnect();
+}
+
+TEST_CASE("Postgres streaming batches", "[PostgresConnector]") {
+    PostgresConnector conn;
+    std::string conninfo = "host=127.0.0.1 port=15432 dbname=postgres user=postgres password=postgres";
+    if (!conn.connect(conninfo)) {
+        WARN("Cannot connect to Postgres, skipping test");
+        return;
+    }
+
+    auto stream = conn.stream("SELECT g AS n FROM generate_series(1, 2500) AS g", 1000);
+    REQUIRE(stream->columns().size() == 1);
+    REQUIRE(stream->columns()[0].name == "n");
+
+    // Пока поток открыт, соединение занято
+    REQUIRE_THROWS(conn.execute("SELECT 1"));
+
+    QueryResult batch;
+    size_t total = 0;
+    size_t batches = 0;
+    while (stream->next_batch(batch)) {
+        REQUIRE(batch.row_count() <= 1000);
+        total += batch.row_count();
+        ++batches;
+    }
+    REQUIRE(total == 2500);
+    REQUIRE(batches == 3);
+    REQUIRE_FALSE(stream->is_open());
+
+    // Досрочное закрытие освобождает соединение
+    stream = conn.stream("SELECT g FROM generate_series(1, 1000000) AS g", 10);
+    REQUIRE(stream->next_batch(batch));
+    stream->close();
+    REQUIRE(conn.execute("SELECT 1 AS test").row_count() == 1);
+    conn.disconnect();
+}
+
+TEST_CASE("Postgres count modes", "[PostgresConnector]") {
+    PostgresConnector conn;
+    std::string conninfo = "host=127.0.0.1 port=15432 dbname=postgres user=postgres password=postgres";
+    if (!conn.connect(conninfo)) {
+        WARN("Cannot connect to Postgres, skipping test");
+        return;
+    }
+
+    const std::string page = "SELECT g AS n FROM generate_series(1, 1000) AS g ORDER BY g LIMIT 20 OFFSET 40";
+
+    QueryResult exact = conn.execute(page, CountMode::Exact);
+    REQUIRE(exact.row_count() == 20);
+    REQUIRE(exact.columns.size() == 1);
+    REQUIRE(exact.count == 1000);
+
+    REQUIRE(conn.execute(page, CountMode::None).count == 20);
+    REQUIRE(conn.execute(page, CountMode::Separate).count == 1000);
+    REQUIRE(conn.execute(page, CountMode::Estimate).count >= 60);
+
+    // Неполная последняя страница: дополнительный запрос не нужен
+    QueryResult last = conn.execute(
+        "SELECT g FROM generate_series(1, 50) AS g ORDER BY g LIMIT 20 OFFSET 40", CountMode::Separate);
+    REQUIRE(last.row_count() == 10);
+    REQUIRE(last.count == 50);
+
+    // Режим по умолчанию и запросы с параметрами
+    conn.set_count_mode(CountMode::Separate);
+    QueryResult params = conn.execute(
+        "SELECT g FROM generate_series(1, $1::int) AS g ORDER BY g LIMIT 5", {std::string("30")});
+    REQUIRE(params.row_count() == 5);
+    REQUIRE(params.count == 30);
+
+    REQUIRE(conn.execute("SELECT COUNT(*) AS c FROM generate_series(1, 10)", CountMode::Exact).row_count() == 1);
+    conn.disconnect();
+}
+
+// Ожидание готовности сокета, как это делает цикл событий
+static QueryResult wait_async(PostgresConnector& conn) {
+    while (!conn.poll_async()) {
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(conn.socket(), &readable);
+        select(conn.socket() + 1, &readable, nullptr, nullptr, nullptr);
+    }
+    return conn.take_async_result();
+}
+
+TEST_CASE("Postgres async queries", "[PostgresConnector]") {
+    PostgresConnector conn;
+    std::string conninfo = "host=127.0.0.1 port=15432 dbname=postgres user=postgres password=postgres";
+    if (!conn.connect(conninfo)) {
+        WARN("Cannot connect to Postgres, skipping test");
+        return;
+    }
+
+    conn.send_async("SELECT g AS n FROM generate_series(1, 100) AS g ORDER BY g LIMIT 10", nullptr,
+                    CountMode::Separate);
+    REQUIRE(conn.async_pending());
+    // Пока запрос не завершён, синхронные вызовы запрещены
+    REQUIRE_THROWS(conn.execute("SELECT 1"));
+
+    QueryResult page = wait_async(conn);
+    REQUIRE_FALSE(conn.async_pending());
+    REQUIRE(page.row_count() == 10);
+    REQUIRE(page.count == 100);
+
+    QueryParams params = {std::string("7")};
+    conn.send_async("SELECT $1::int AS v", &params, CountMode::None);
+    QueryResult param = wait_async(conn);
+    REQUIRE(param.value_at(0, 0) == Value(static_cast<int64_t>(7)));
+
+    // Ошибка запроса выбрасывается при получении результата
+    conn.send_async("SELECT * FROM missing_table_for_async_test", nullptr, CountMode::None);
+    REQUIRE_THROWS(wait_async(conn));
+
+    // Отмена долгого запроса оставляет соединение пригодным
+    conn.send_async("SELECT pg_sleep(10)", nullptr, CountMode::None);
+    conn.cancel_async();
+    REQUIRE_FALSE(conn.async_pending());
+    REQUIRE(conn.execute("SELECT 1 AS x").row_count() == 1);
+
+    // Неполная страница после OFFSET: число строк известно без запроса count
+    conn.send_async("SELECT g FROM generate_series(1, 50) AS g ORDER BY g LIMIT 20 OFFSET 40", nullptr,
+                    CountMode::Separate);
+    QueryResult last = wait_async(conn);
+    REQUIRE(last.row_count() == 10);
+    REQUIRE(last.count == 50);
+
+    // Типы вне встроенной таблицы дочитываются из каталога, как у execute
+    conn.execute("DROP TYPE IF EXISTS async_type_mood", CountMode::None);
+    conn.execute("CREATE TYPE async_type_mood AS ENUM ('sad', 'happy')", CountMode::None);
+    for (bool binary : {false, true}) {
+        PostgresConnector fresh;
+        REQUIRE(fresh.connect(conninfo));
+        fresh.set_binary_results(binary);
+        fresh.send_async("SELECT 'happy'::async_type_mood AS mood", nullptr, CountMode::None);
+        QueryResult mood = wait_async(fresh);
+        REQUIRE(mood.columns[0].type == "async_type_mood");
+        REQUIRE(std::get<std::string>(mood.value_at(0, 0)) == "happy");
+    }
+    conn.execute("DROP TYPE async_type_mood", CountMode::None);
+    conn.disconnect();
+}
+
+TEST_CASE("Postgres pipelined batch", "[PostgresConnector]") {
+    PostgresConnector conn;
+    std::string conninfo = "host=127.0.0.1 port=15432 dbname=postgres user=postgres password=postgres";
+    if (!conn.connect(conninfo)) {
+        WARN("Cannot connect to Postgres, skipping test");
+        return;
+    }
+
+    conn.execute("DROP TABLE IF EXISTS pipeline_test", CountMode::None);
+    conn.execute("CREATE TABLE pipeline_test (id int PRIMARY KEY, v int)", CountMode::None);
+
+    std::vector<std::string> inserts;
+    for (int i = 0; i < 500; ++i) {
+        inserts.push_back("INSERT INTO pipeline_test VALUES (" + std::to_string(i) + ", 0)");
+    }
+    inserts.push_back("UPDATE pipeline_test SET v = 1 WHERE id < 10");
+    BatchResult ok = conn.execute_pipeline(inserts);
+    REQUIRE(ok.success);
+    REQUIRE(ok.statements.size() == 501);
+    REQUIRE(ok.statements.back().status == BatchStatus::Ok);
+    REQUIRE(ok.statements.back().affected_rows == 10);
+    REQUIRE_FALSE(conn.is_in_transaction());
+
+    // Ошибка в середине: пакет откатывается целиком, следующие операторы пропущены
+    BatchResult failed = conn.execute_pipeline({
+        "UPDATE pipeline_test SET v = 2",
+        "INSERT INTO pipeline_test VALUES (0, 0)",
+        "UPDATE pipeline_test SET v = 3",
+    });
+    REQUIRE_FALSE(failed.success);
+    REQUIRE(failed.statements[0].status == BatchStatus::Ok);
+    REQUIRE(failed.statements[1].status == BatchStatus::Failed);
+    REQUIRE_FALSE(failed.statements[1].error.empty());
+    REQUIRE(failed.statements[2].status == BatchStatus::Skipped);
+    REQUIRE_FALSE(conn.is_in_transaction());
+    REQUIRE(conn.execute("SELECT count(*) AS c FROM pipeline_test WHERE v = 2", CountMode::None)
+                .value_at(0, 0) == Value(static_cast<int64_t>(0)));
+
+    // Внутри открытой транзакции COMMIT остаётся за вызывающим
+    REQUIRE(conn.begin_transaction());
+    REQUIRE(conn.execute_pipeline({"UPDATE pipeline_test SET v = 4 WHERE id = 1"}).success);
+    REQUIRE(conn.is_in_transaction());
+    REQUIRE(conn.rollback_transaction());
+
+    conn.execute("DROP TABLE pipeline_test", CountMode::None);
+    conn.disconnect();
+}
+
+TEST_CASE("Postgres COPY FROM STDIN", "[PostgresConnector]") {
+    PostgresConnector conn;
+    std::string conninfo = "host=127.0.0.1 port=15432 dbname=postgres user=postgres password=postgres";
+    if (!conn.connect(conninfo)) {
+        WARN("Cannot connect to Postgres, skipping test");
+        return;
+    }
+
+    conn.execute("DROP TABLE IF EXISTS copy_test", CountMode::None);
+    conn.execute("CREATE TABLE copy_test (id int4, score float8, name text, created date, payload bytea)",
+                 CountMode::None);
+
+    auto make_batch = [](int64_t first, size_t rows) {
+        QueryResult batch;
+        batch.add_column("id", "int4");
+        batch.add_column("score", "float8");
+        batch.add_column("name", "text");
+        batch.add_column("created", "date");
+        batch.add_column("payload", "bytea");
+        for (size_t i = 0; i < rows; ++i) {
+            int64_t id = first + static_cast<int64_t>(i);
+            batch.data[0].append_int(id);
+            batch.data[1].append_double(id * 0.5);
+            if (id % 10 == 0) batch.data[2].append_null();
+            else batch.data[2].append_string("name\t" + std::to_string(id) + "\\n");
+            batch.data[3].append_temporal(ValueKind::Date, 19372);
+            batch.data[4].append_string(std::string("\x00\xff", 2));
+        }
+        return batch;
+    };
+
+    for (bool binary : {true, false}) {
+        conn.execute("TRUNCATE copy_test", CountMode::None);
+
+        auto copy = conn.copy_in("copy_test", {}, binary);
+        REQUIRE_THROWS(conn.execute("SELECT 1"));   // соединение занято загрузкой
+        copy->write(make_batch(0, 1000));
+        REQUIRE(copy->binary() == binary);
+        copy->write(make_batch(1000, 500));
+        REQUIRE(copy->finish() == 1500);
+
+        QueryResult check = conn.execute(
+            "SELECT count(*), count(name), sum(id), max(created)::text, min(encode(payload, 'hex')) "
+            "FROM copy_test", CountMode::None);
+        REQUIRE(check.value_at(0, 0) == Value(static_cast<int64_t>(1500)));
+        REQUIRE(check.value_at(0, 1) == Value(static_cast<int64_t>(1350)));
+        REQUIRE(check.value_at(0, 2) == Value(static_cast<int64_t>(1500 * 1499 / 2)));
+        REQUIRE(check.value_at(0, 3) == Value(std::string("2023-01-15")));
+        REQUIRE(check.value_at(0, 4) == Value(std::string("00ff")));
+        QueryResult name = conn.execute("SELECT name FROM copy_test WHERE id = 7", CountMode::None);
+        REQUIRE(name.value_at(0, 0) == Value(std::string("name\t7\\n")));
+    }
+
+    // Ошибка кодирования отменяет загрузку целиком
+    conn.execute("TRUNCATE copy_test", CountMode::None);
+    auto copy = conn.copy_in("copy_test", {"id", "name"});
+    QueryResult bad;
+    bad.add_column("id", "int4");
+    bad.add_column("name", "text");
+    bad.append_row({Value(int64_t(1)), Value(std::string("ok"))});
+    bad.append_row({Value(int64_t(1) << 40), Value(std::string("too big"))});
+    REQUIRE_THROWS(copy->write(bad));
+    REQUIRE_FALSE(copy->is_open());
+    REQUIRE(conn.execute("SELECT count(*) FROM copy_test", CountMode::None).value_at(0, 0) ==
+            Value(static_cast<int64_t>(0)));
+
+    // Строки в колонки date и int4 — текстовый формат, значения разбирает сервер
+    conn.execute("TRUNCATE copy_test", CountMode::None);
+    auto text_copy = conn.copy_in("copy_test", {"id", "created", "name"});
+    QueryResult strings;
+    strings.add_column("id", "text");
+    strings.add_column("created", "text");
+    strings.add_column("name", "text");
+    strings.append_row({Value(std::string("42")), Value(std::string("2024-01-15")), Value(std::string("a"))});
+    strings.append_row({Value(std::string("43")), Value(nullptr), Value(std::string("b"))});
+    text_copy->write(strings);
+    REQUIRE_FALSE(text_copy->binary());
+    REQUIRE(text_copy->finish() == 2);
+    QueryResult parsed = conn.execute("SELECT sum(id), max(created)::text FROM copy_test", CountMode::None);
+    REQUIRE(parsed.value_at(0, 0) == Value(static_cast<int64_t>(85)));
+    REQUIRE(parsed.value_at(0, 1) == Value(std::string("2024-01-15")));
+
+    // Колонка из одних NULL в первой пачке не фиксирует бинарный формат:
+    // во второй пачке в неё приходят строки
+    conn.execute("TRUNCATE copy_test", CountMode::None);
+    auto null_copy = conn.copy_in("copy_test", {"id", "created"});
+    QueryResult nulls;
+    nulls.add_column("id", "int4");
+    nulls.add_column("created", "date");
+    nulls.append_row({Value(int64_t(1)), Value(nullptr)});
+    nulls.append_row({Value(int64_t(2)), Value(nullptr)});
+    null_copy->write(nulls);
+    REQUIRE_FALSE(null_copy->binary());
+    QueryResult dates;
+    dates.add_column("id", "int4");
+    dates.add_column("created", "date");
+    dates.append_row({Value(int64_t(3)), Value(std::string("2024-01-15"))});
+    null_copy->write(dates);
+    REQUIRE(null_copy->finish() == 3);
+    QueryResult loaded = conn.execute("SELECT count(created), max(created)::text FROM copy_test", CountMode::None);
+    REQUIRE(loaded.value_at(0, 0) == Value(static_cast<int64_t>(1)));
+    REQUIRE(loaded.value_at(0, 1) == Value(std::string("2024-01-15")));
+
+    // Явно заданный бинарный формат колонка из NULL не отменяет
+    conn.execute("TRUNCATE copy_test", CountMode::None);
+    auto binary_copy = conn.copy_in("copy_test", {"id", "created"}, true);
+    binary_copy->write(nulls);
+    REQUIRE(binary_copy->binary());
+    REQUIRE(binary_copy->finish() == 2);
+
+    // Загрузка без пачек ничего не отправляет до finish
+    auto empty_copy = conn.copy_in("copy_test", {"id"});
+    REQUIRE(empty_copy->finish() == 0);
+
+    // Без списка колонок генерируемые колонки не загружаются, их значения считает сервер
+    conn.execute("DROP TABLE IF EXISTS copy_generated_test", CountMode::None);
+    conn.execute("CREATE TABLE copy_generated_test (a int4, doubled int4 GENERATED ALWAYS AS (a * 2) STORED, "
+                 "b text)", CountMode::None);
+    auto generated_copy = conn.copy_in("copy_generated_test", {});
+    REQUIRE(generated_copy->columns().size() == 2);
+    QueryResult plain;
+    plain.add_column("a", "int4");
+    plain.add_column("b", "text");
+    plain.append_row({Value(int64_t(21)), Value(std::string("x"))});
+    generated_copy->write(plain);
+    REQUIRE(generated_copy->finish() == 1);
+    REQUIRE(conn.execute("SELECT doubled FROM copy_generated_test", CountMode::None).value_at(0, 0) ==
+            Value(static_cast<int64_t>(42)));
+    conn.execute("DROP TABLE copy_generated_test", CountMode::None);
+
+    conn.execute("DROP TABLE copy_test", CountMode::None);
+    conn.disconnect();
+}
+
+TEST_CASE("Postgres COPY TO STDOUT", "[PostgresConnector]") {
+    PostgresConnector conn;
+    std::string conninfo = "host=127.0.0.1 port=15432 dbname=postgres user=postgres password=postgres";
+    if (!conn.connect(conninfo)) {
+        WARN("Cannot connect to Postgres, skipping test");
+        return;
+    }
+
+    char path[] = "/tmp/sql_executor_copy_out_XXXXXX";
+    int fd = mkstemp(path);
+    REQUIRE(fd >= 0);
+
+    {
+        FdSink sink(fd, 64);
+        uint64_t rows = conn.copy_out("SELECT g AS id, 'x,' || g AS name FROM generate_series(1, 3) g;", sink,
+                                      ExportFormat::Csv, true);
+        REQUIRE(rows == 3);
+        sink.close();
+    }
+    lseek(fd, 0, SEEK_SET);
+    char buffer[256] = {};
+    ssize_t length = read(fd, buffer, sizeof(buffer) - 1);
+    REQUIRE(std::string(buffer, length > 0 ? static_cast<size_t>(length) : 0) ==
+            "id,name\n1,\"x,1\"\n2,\"x,2\"\n3,\"x,3\"\n");
+
+    // Заголовок — только в csv
+    REQUIRE_THROWS_AS(conn.copy_out("SELECT 1", *FdSink::open("/dev/null"), ExportFormat::Binary, true),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(conn.copy_out("SELECT 1", *FdSink::open("/dev/null"), ExportFormat::Tsv, true),
+                      std::invalid_argument);
+
+    // Ошибка запроса выбрасывается, соединение остаётся пригодным
+    REQUIRE_THROWS(conn.copy_out("SELECT 1 / 0", *FdSink::open("/dev/null")));
+    REQUIRE(conn.execute("SELECT 1", CountMode::None).row_count() == 1);
+
+    close(fd);
+    unlink(path);
+    conn.disconnect();
+}
+
+TEST_CASE("Postgres type catalog cache", "[PostgresConnector]") {
+    PostgresConnector conn;
+    conn.set_preload_types(true);
+    std::string conninfo = "host=127.0.0.1 port=15432 dbname=postgres user=postgres password=postgres";
+    if (!conn.connect(conninfo)) {
+        WARN("Cannot connect to Postgres, skipping test");
+        return;
+    }
+
+    conn.execute("DROP TABLE IF EXISTS type_cache_test", CountMode::None);
+    conn.execute("DROP DOMAIN IF EXISTS type_cache_score", CountMode::None);
+    conn.execute("DROP TYPE IF EXISTS type_cache_mood", CountMode::None);
+    conn.execute("CREATE TYPE type_cache_mood AS ENUM ('sad', 'happy')", CountMode::None);
+    conn.execute("CREATE DOMAIN type_cache_score AS int4", CountMode::None);
+    conn.execute("CREATE TABLE type_cache_test (mood type_cache_mood, moods type_cache_mood[], "
+                 "score type_cache_score)", CountMode::None);
+    conn.execute("INSERT INTO type_cache_test VALUES ('happy', '{sad,happy}', 7)", CountMode::None);
+
+    // Типы созданы после подключения — в предзагруженном кэше их нет, дочитываются
+    for (bool binary : {false, true}) {
+        conn.set_binary_results(binary);
+        QueryResult result = conn.execute("SELECT mood, moods, score FROM type_cache_test", CountMode::None);
+        REQUIRE(result.columns[0].type == "type_cache_mood");
+        REQUIRE(result.columns[1].type == "type_cache_mood[]");
+        REQUIRE(result.columns[2].type == "type_cache_score");
+        REQUIRE(std::get<std::string>(result.value_at(0, 0)) == "happy");   // перечисление — текстом
+        REQUIRE(std::get<int64_t>(result.value_at(0, 2)) == 7);             // домен — как int4
+    }
+
+    REQUIRE(conn.refresh_types() > 100);
+    QueryResult oid = conn.execute("SELECT 'type_cache_mood'::regtype::oid::int8 AS oid", CountMode::None);
+    auto mood = conn.type_info(static_cast<Oid>(std::get<int64_t>(oid.value_at(0, 0))));
+    REQUIRE(mood.has_value());
+    REQUIRE(mood->kind == 'e');
+    REQUIRE(mood->category == 'E');
+    REQUIRE_FALSE(conn.type_info(0).has_value());
+
+    conn.execute("DROP TABLE type_cache_test", CountMode::None);
+    conn.execute("DROP DOMAIN type_cache_score", CountMode::None);
+    conn.execute("DROP TYPE type_cache_mood", CountMode::None);
+    conn.disconnect();
+}
+
+TEST_CASE("Postgres stream resolves custom types without preload", "[PostgresConnector]") {
+    PostgresConnector conn;
+    std::string conninfo = "host=127.0.0.1 port=15432 dbname=postgres user=postgres password=postgres";
+    if (!conn.connect(conninfo)) {
+        WARN("Cannot connect to Postgres, skipping test");
+        return;
+    }
+
+    conn.execute("DROP TABLE IF EXISTS stream_type_test", CountMode::None);
+    conn.execute("DROP TYPE IF EXISTS stream_type_mood", CountMode::None);
+    conn.execute("CREATE TYPE stream_type_mood AS ENUM ('sad', 'happy')", CountMode::None);
+    conn.execute("CREATE TABLE stream_type_test (mood stream_type_mood)", CountMode::None);
+    conn.execute("INSERT INTO stream_type_test VALUES ('happy'), ('sad')", CountMode::None);
+
+    // Новое соединение на каждый режим: в кэше типов перечисления ещё нет
+    for (bool binary : {false, true}) {
+        PostgresConnector fresh;
+        REQUIRE(fresh.connect(conninfo));
+        fresh.set_binary_results(binary);
+        auto stream = fresh.stream("SELECT mood FROM stream_type_test ORDER BY mood", 10);
+        QueryResult batch;
+        REQUIRE(stream->next_batch(batch));
+        REQUIRE(batch.columns[0].type == "stream_type_mood");
+        REQUIRE(batch.row_count() == 2);
+        REQUIRE(std::get<std::string>(batch.value_at(0, 0)) == "sad");   // перечисление — текстом
+        stream->close();
+    }
+
+    conn.execute("DROP TABLE stream_type_test", CountMode::None);
+    conn.execute("DROP TYPE stream_type_mood", CountMode::None);
+    conn.disconnect();
+}
+
+TEST_CASE("Postgres result cache is bypassed inside transactions", "[PostgresConnector]") {
+    PostgresConnector conn;
+    std::string conninfo = "host=127.0.0.1 port=15432 dbname=postgres user=postgres password=postgres";
+    if (!conn.connect(conninfo)) {
+        WARN("Cannot connect to Postgres, skipping test");
+        return;
+    }
+    auto cache = std::make_shared<ResultCache>();
+    conn.set_result_cache(cache);
+
+    // Транзакция, открытая запросом, а не begin_transaction()
+    conn.execute("BEGIN", CountMode::None);
+    conn.execute("SELECT 1 AS one", CountMode::None);
+    conn.execute("SELECT 1 AS one", CountMode::None);
+    conn.execute("ROLLBACK", CountMode::None);
+    REQUIRE(cache->stats().misses == 0);
+    REQUIRE(cache->stats().entries == 0);
+
+    conn.execute("SELECT 1 AS one", CountMode::None);
+    conn.execute("SELECT 1 AS one", CountMode::None);
+    REQUIRE(cache->stats().misses == 1);
+    REQUIRE(cache->stats().hits == 1);
+    conn.disconnect();
+}
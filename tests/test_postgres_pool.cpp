@@ -0,0 +1,102 @@
+#include "postgres_pool.h"
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_all.hpp>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+static const std::string conninfo = "host=127.0.0.1 port=15432 dbname=postgres user=postgres password=postgres";
+
+static std::unique_ptr<PostgresPool> make_pool(PostgresPoolOptions options) {
+    try {
+        return std::make_unique<PostgresPool>(conninfo, options);
+    } catch (const std::exception&) {
+        return nullptr;
+    }
+}
+
+TEST_CASE("PostgresPool rejects empty pool", "[PostgresPool]") {
+    PostgresPoolOptions options;
+    options.size = 0;
+    REQUIRE_THROWS_AS(PostgresPool(conninfo, options), std::invalid_argument);
+}
+
+TEST_CASE("PostgresPool lease and return", "[PostgresPool]") {
+    PostgresPoolOptions options;
+    options.size = 2;
+    options.acquire_timeout = std::chrono::milliseconds(100);
+    auto pool = make_pool(options);
+    if (!pool) {
+        WARN("Cannot connect to Postgres, skipping test");
+        return;
+    }
+
+    REQUIRE(pool->idle() == 2);
+    {
+        auto first = pool->acquire();
+        auto second = pool->acquire();
+        REQUIRE(pool->in_use() == 2);
+        REQUIRE(first->execute("SELECT 1 AS x").row_count() == 1);
+
+        // Все соединения заняты — ожидание ограничено таймаутом
+        REQUIRE_THROWS(pool->acquire(std::chrono::milliseconds(20)));
+
+        second.release();
+        REQUIRE_FALSE(second);
+        REQUIRE(pool->in_use() == 1);
+    }
+    REQUIRE(pool->in_use() == 0);
+    REQUIRE(pool->idle() == 2);
+}
+
+TEST_CASE("PostgresPool resets transaction state", "[PostgresPool]") {
+    PostgresPoolOptions options;
+    options.size = 1;
+    auto pool = make_pool(options);
+    if (!pool) {
+        WARN("Cannot connect to Postgres, skipping test");
+        return;
+    }
+
+    {
+        auto lease = pool->acquire();
+        REQUIRE(lease->begin_transaction());
+        lease->execute("SELECT 1 AS x");
+    }
+    {
+        auto lease = pool->acquire();
+        REQUIRE_FALSE(lease->is_in_transaction());
+        // Транзакция, открытая обычным запросом, тоже откатывается
+        lease->execute("BEGIN");
+    }
+    auto lease = pool->acquire();
+    QueryResult status = lease->execute("SELECT now() = statement_timestamp() AS idle", CountMode::None);
+    REQUIRE(status.value_at(0, 0) == Value(true));
+}
+
+TEST_CASE("PostgresPool concurrent leases", "[PostgresPool]") {
+    PostgresPoolOptions options;
+    options.size = 3;
+    auto pool = make_pool(options);
+    if (!pool) {
+        WARN("Cannot connect to Postgres, skipping test");
+        return;
+    }
+
+    std::atomic<int> ok{0};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 8; ++t) {
+        workers.emplace_back([&pool, &ok, t] {
+            for (int i = 0; i < 20; ++i) {
+                auto lease = pool->acquire();
+                QueryResult result = lease->execute("SELECT " + std::to_string(t * 100 + i) + " AS v");
+                if (result.value_at(0, 0) == Value(static_cast<int64_t>(t * 100 + i))) ++ok;
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+
+    REQUIRE(ok == 160);
+    REQUIRE(pool->in_use() == 0);
+    REQUIRE(pool->idle() <= pool->size());
+}
@@ -0,0 +1,143 @@
+#include "result_cache.h"
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_all.hpp>
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+static QueryResult make_result(int64_t value, size_t rows = 1) {
+    QueryResult result;
+    result.add_column("v", "int8", ValueKind::Int64);
+    for (size_t i = 0; i < rows; ++i) result.data[0].append_int(value);
+    result.count = rows;
+    return result;
+}
+
+TEST_CASE("ResultCache query normalization", "[ResultCache]") {
+    REQUIRE(ResultCache::normalize_query("  SELECT  1,\n\t2 ;  ") == "SELECT  1,\n\t2");
+    REQUIRE(ResultCache::make_key("pg", "SELECT 1") == ResultCache::make_key("pg", " \nSELECT 1;\n"));
+    // Запросы с разным смыслом не должны совпадать по ключу
+    REQUIRE(ResultCache::make_key("pg", "SELECT 1 -- x\n, 2") != ResultCache::make_key("pg", "SELECT 1 -- x , 2"));
+    REQUIRE(ResultCache::make_key("pg", "SELECT $$a  b$$") != ResultCache::make_key("pg", "SELECT $$a b$$"));
+    REQUIRE(ResultCache::make_key("ch", "SELECT 'a\\'  b'") != ResultCache::make_key("ch", "SELECT 'a\\' b'"));
+    REQUIRE(ResultCache::make_key("pg", "SELECT 1") != ResultCache::make_key("ch", "SELECT 1"));
+    REQUIRE(ResultCache::make_key("pg", "SELECT 1", "b") != ResultCache::make_key("pg", "SELECT 1"));
+
+    REQUIRE(ResultCache::is_cacheable_query("select 1"));
+    REQUIRE(ResultCache::is_cacheable_query("  (SELECT 1) UNION (SELECT 2)"));
+    REQUIRE(ResultCache::is_cacheable_query("WITH t AS (SELECT 1) SELECT * FROM t"));
+    REQUIRE_FALSE(ResultCache::is_cacheable_query("INSERT INTO t VALUES (1)"));
+    REQUIRE_FALSE(ResultCache::is_cacheable_query("WITH d AS (DELETE FROM t RETURNING *) SELECT * FROM d"));
+    REQUIRE_FALSE(ResultCache::is_cacheable_query("with u as (update t set x = 1 returning x) select * from u"));
+    REQUIRE_FALSE(ResultCache::is_cacheable_query("SELECT * FROM t FOR UPDATE"));
+    REQUIRE(ResultCache::is_cacheable_query("SELECT last_update, 'DELETE', \"insert\" FROM t -- update\n"));
+    REQUIRE(ResultCache::is_cacheable_query("SELECT 'it''s', x /* merge */ FROM t"));
+    REQUIRE(ResultCache::is_cacheable_query("SELECT $$ delete $$, $tag$ ' $tag$, $1 FROM t"));
+    REQUIRE_FALSE(ResultCache::is_cacheable_query("SELECT $q$ ' $q$ FROM t; DELETE FROM t"));
+    REQUIRE(ResultCache::is_cacheable_query("SELECT 1 -- комментарий до конца"));
+    // Незакрытые строка или комментарий — не кэшируется
+    REQUIRE_FALSE(ResultCache::is_cacheable_query("SELECT 'abc"));
+    REQUIRE_FALSE(ResultCache::is_cacheable_query("SELECT $$abc"));
+    REQUIRE_FALSE(ResultCache::is_cacheable_query("SELECT 1 /* abc"));
+    REQUIRE_FALSE(ResultCache::is_cacheable_query("SELECTED"));
+    REQUIRE_FALSE(ResultCache::is_cacheable_query(""));
+}
+
+TEST_CASE("ResultCache hits, misses and TTL", "[ResultCache]") {
+    ResultCache cache(1 << 20, std::chrono::milliseconds(50));
+    int loads = 0;
+    auto load = [&] { ++loads; return make_result(loads); };
+
+    auto first = cache.get_or_load("k", load);
+    auto second = cache.get_or_load("k", load);
+    REQUIRE(loads == 1);
+    REQUIRE(first == second);
+    REQUIRE(first->data[0].ints[0] == 1);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(80));
+    auto third = cache.get_or_load("k", load);
+    REQUIRE(loads == 2);
+    REQUIRE(third->data[0].ints[0] == 2);
+
+    // Свой TTL записи перекрывает TTL по умолчанию
+    cache.get_or_load("long", load, std::chrono::seconds(60));
+    std::this_thread::sleep_for(std::chrono::milliseconds(80));
+    cache.get_or_load("long", load);
+    REQUIRE(loads == 3);
+
+    ResultCacheStats stats = cache.stats();
+    REQUIRE(stats.hits == 2);
+    REQUIRE(stats.misses == 3);
+    REQUIRE(stats.expirations == 1);
+    REQUIRE(stats.entries == 2);
+
+    cache.clear();
+    REQUIRE(cache.stats().entries == 0);
+    REQUIRE(cache.stats().bytes == 0);
+}
+
+TEST_CASE("ResultCache evicts least recently used within budget", "[ResultCache]") {
+    const size_t entry_bytes = ResultCache::result_bytes(make_result(0, 100)) + 1;
+    ResultCache cache(entry_bytes * 2 + entry_bytes / 2, std::chrono::seconds(60));
+    int loads = 0;
+    auto load = [&] { ++loads; return make_result(loads, 100); };
+
+    cache.get_or_load("a", load);
+    cache.get_or_load("b", load);
+    cache.get_or_load("a", load);   // a становится недавно использованным
+    cache.get_or_load("c", load);   // вытесняет b
+    REQUIRE(loads == 3);
+    REQUIRE(cache.stats().evictions == 1);
+    REQUIRE(cache.stats().bytes <= cache.max_bytes());
+
+    cache.get_or_load("a", load);
+    REQUIRE(loads == 3);
+    cache.get_or_load("b", load);
+    REQUIRE(loads == 4);
+
+    // Результат больше бюджета отдаётся, но не кэшируется
+    ResultCache tiny(16);
+    auto big = tiny.get_or_load("big", load);
+    REQUIRE(big->row_count() == 100);
+    REQUIRE(tiny.stats().entries == 0);
+}
+
+TEST_CASE("ResultCache coalesces concurrent loads", "[ResultCache]") {
+    ResultCache cache;
+    std::atomic<int> loads{0};
+    auto load = [&] {
+        ++loads;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        return make_result(42);
+    };
+
+    std::vector<std::thread> threads;
+    std::atomic<int> correct{0};
+    for (int i = 0; i < 8; ++i) {
+        threads.emplace_back([&] {
+            if (cache.get_or_load("same", load)->data[0].ints[0] == 42) ++correct;
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    REQUIRE(loads == 1);
+    REQUIRE(correct == 8);
+    ResultCacheStats stats = cache.stats();
+    REQUIRE(stats.misses == 1);
+    REQUIRE(stats.hits + stats.coalesced == 7);
+}
+
+TEST_CASE("ResultCache does not cache errors", "[ResultCache]") {
+    ResultCache cache;
+    int loads = 0;
+    auto failing = [&]() -> QueryResult { ++loads; throw std::runtime_error("query failed"); };
+
+    REQUIRE_THROWS_AS(cache.get_or_load("k", failing), std::runtime_error);
+    REQUIRE_THROWS_AS(cache.get_or_load("k", failing), std::runtime_error);
+    REQUIRE(loads == 2);
+    REQUIRE(cache.stats().entries == 0);
+
+    auto ok = cache.get_or_load("k", [] { return make_result(7); });
+    REQUIRE(ok->data[0].ints[0] == 7);
+}
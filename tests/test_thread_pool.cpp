@@ -0,0 +1,37 @@
+#include "thread_pool.h"
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_all.hpp>
+#include <atomic>
+#include <vector>
+
+TEST_CASE("ThreadPool runs tasks and returns results", "[ThreadPool]") {
+    ThreadPool pool(4);
+    REQUIRE(pool.size() == 4);
+
+    std::vector<std::future<int>> results;
+    for (int i = 0; i < 100; ++i) {
+        results.push_back(pool.submit([i] { return i * i; }));
+    }
+    for (int i = 0; i < 100; ++i) {
+        REQUIRE(results[i].get() == i * i);
+    }
+}
+
+TEST_CASE("ThreadPool passes exceptions through futures", "[ThreadPool]") {
+    ThreadPool pool(2);
+    auto failed = pool.submit([]() -> int { throw std::runtime_error("boom"); });
+    auto ok = pool.submit([] { return 1; });
+    REQUIRE_THROWS_AS(failed.get(), std::runtime_error);
+    REQUIRE(ok.get() == 1);
+}
+
+TEST_CASE("ThreadPool drains queue on destruction", "[ThreadPool]") {
+    std::atomic<int> done{0};
+    {
+        ThreadPool pool(2);
+        for (int i = 0; i < 50; ++i) {
+            pool.submit([&done] { ++done; });
+        }
+    }
+    REQUIRE(done == 50);
+}